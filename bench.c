@@ -0,0 +1,247 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+
+// Renders a fixed set of Mandelbrot scenes through every engine at several sizes and iteration limits and prints
+// the results as JSON, to catch regressions and compare machines. The checksum identifies the iteration buffer,
+// so engines that compute the same image print the same checksum.
+
+#define MAX_LIST 16
+
+typedef struct {
+    const char* name;
+    double center[2];
+    double width;
+} scene;
+
+static const scene SCENES[] = {
+    {"default", {CAMERA_CORNER_X + CAMERA_WIDTH / 2.0, CAMERA_CORNER_Y + CAMERA_WIDTH / 2.0}, CAMERA_WIDTH},
+    {"seahorse_valley", {-0.7436438870, 0.1318259040}, 0.05},
+    // mostly inside the main cardioid, nearly every pixel runs to max_iter
+    {"interior", {-0.15, 0.0}, 0.6},
+    // period 7 minibrot in the antenna, far beyond single precision
+    {"deep_minibrot", {-1.9990956823270185, 0.0}, 1e-6},
+    // dendrite around a Misiurewicz point, nearly all boundary
+    {"filaments", {-0.1010963638456222, 0.9562865108091415}, 2e-3},
+};
+
+typedef enum { ENGINE_GPU_FRAGMENT, ENGINE_GPU_COMPUTE, ENGINE_CPU_SCALAR, ENGINE_CPU_SIMD, ENGINE_COUNT } engine_id;
+
+static const char* ENGINE_NAMES[ENGINE_COUNT] = {
+    [ENGINE_GPU_FRAGMENT] = "gpu_fragment",
+    [ENGINE_GPU_COMPUTE] = "gpu_compute",
+    [ENGINE_CPU_SCALAR] = "cpu_scalar",
+    [ENGINE_CPU_SIMD] = "cpu_simd",
+};
+
+typedef struct {
+    int values[MAX_LIST];
+    int count;
+} int_list;
+
+void printUsage(const char* program) {
+    printf("usage: %s [options]\n"
+           "  --output FILE           write the JSON there instead of stdout\n"
+           "  --sizes N,N,...         square image sizes (default 256,512)\n"
+           "  --max-iters N,N,...     iteration limits (default 1000,10000)\n"
+           "  --engines NAME,...      gpu_fragment, gpu_compute, cpu_scalar, cpu_simd (default all)\n"
+           "  --threads N             cpu engine threads (default: all cores)\n"
+           "  --repeat N              keep the fastest of N runs (default 1)\n"
+           "  --headless              run gpu_fragment on a surfaceless EGL context (Mesa llvmpipe without a GPU)\n"
+           "                          even where a window could be opened\n",
+           program);
+}
+
+int parseIntList(char* text, int_list* list) {
+    list->count = 0;
+    for (char* item = strtok(text, ","); item; item = strtok(NULL, ",")) {
+        if (list->count == MAX_LIST || atoi(item) <= 0) {
+            return 0;
+        }
+        list->values[list->count++] = atoi(item);
+    }
+    return list->count > 0;
+}
+
+int parseEngineList(char* text, char* enabled) {
+    memset(enabled, 0, ENGINE_COUNT);
+    for (char* item = strtok(text, ","); item; item = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; i < ENGINE_COUNT; ++i) {
+            if (strcmp(item, ENGINE_NAMES[i]) == 0) {
+                enabled[i] = found = 1;
+            }
+        }
+        if (!found) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// FNV-1a over the iteration buffer
+uint64_t checksum(const int* iterations, int count) {
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = (const unsigned char*)iterations;
+    for (size_t i = 0; i < (size_t)count * sizeof(int); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Iterations actually executed, from the engines' counts of every pixel.
+uint64_t totalIterations(const int* executed, int count) {
+    uint64_t total = 0;
+    for (int i = 0; i < count; ++i) {
+        total += executed[i];
+    }
+    return total;
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = NULL;
+    int_list sizes = {{256, 512}, 2};
+    int_list maxIters = {{1000, 10000}, 2};
+    char enabled[ENGINE_COUNT] = {1, 1, 1, 1};
+    int threads = cpu_thread_count();
+    int repeat = 1;
+    char headless = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--output") == 0 && rest >= 1) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--sizes") == 0 && rest >= 1 && parseIntList(argv[i + 1], &sizes)) {
+            ++i;
+        } else if (strcmp(argv[i], "--max-iters") == 0 && rest >= 1 && parseIntList(argv[i + 1], &maxIters)) {
+            ++i;
+        } else if (strcmp(argv[i], "--engines") == 0 && rest >= 1 && parseEngineList(argv[i + 1], enabled)) {
+            ++i;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && rest >= 1) {
+            repeat = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = 1;
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    FILE* output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!output) {
+        printf("Couldn't open %s\n", outputPath);
+        return -1;
+    }
+
+    int maxSize = 0;
+    for (int i = 0; i < sizes.count; ++i) {
+        maxSize = sizes.values[i] > maxSize ? sizes.values[i] : maxSize;
+    }
+    int* iterations = malloc((size_t)maxSize * maxSize * sizeof(int));
+    int* executed = malloc((size_t)maxSize * maxSize * sizeof(int));
+
+    const char* skipped[ENGINE_COUNT] = {0};
+    // OpenGL 3.3, the version the viewer targets and the newest macOS has in core profile, has no compute shaders
+    skipped[ENGINE_GPU_COMPUTE] = "compute shaders need OpenGL 4.3";
+    int haveContext = enabled[ENGINE_GPU_FRAGMENT] &&
+                      (headless ? gl_context_create_headless() : gl_context_create_offscreen());
+    if (enabled[ENGINE_GPU_FRAGMENT] && !haveContext) {
+        skipped[ENGINE_GPU_FRAGMENT] = "no OpenGL context";
+    }
+
+    fprintf(output, "{\n  \"machine\": {\"cpu_threads\": %d, \"gl_renderer\": \"%s\"},\n  \"results\": [", threads,
+            haveContext ? (const char*)glGetString(GL_RENDERER) : "");
+    int first = 1;
+    for (int e = 0; e < ENGINE_COUNT; ++e) {
+        if (!enabled[e] || skipped[e]) {
+            continue;
+        }
+        for (int m = 0; m < maxIters.count; ++m) {
+            fractal_params params;
+            fractal_params_default(&params, FORMULA_MANDELBROT);
+            params.max_iter = maxIters.values[m];
+            gpu_engine gpu;
+            if (e == ENGINE_GPU_FRAGMENT && !gpu_engine_init(&gpu, &params, maxSize)) {
+                return -1;
+            }
+
+            for (size_t s = 0; s < sizeof(SCENES) / sizeof(SCENES[0]); ++s) {
+                for (int r = 0; r < sizes.count; ++r) {
+                    int size = sizes.values[r];
+                    fractal_view view = {{SCENES[s].center[0] - SCENES[s].width / 2,
+                                          SCENES[s].center[1] - SCENES[s].width / 2},
+                                         SCENES[s].width};
+                    double best = 0;
+                    for (int k = 0; k < repeat || k == 0; ++k) {
+                        double start = now();
+                        if (e == ENGINE_GPU_FRAGMENT) {
+                            gpu_engine_render_iterations(&gpu, &view, size, size, iterations);
+                        } else {
+                            cpu_render_iterations_parallel(&params, &view, size, size, iterations, threads,
+                                                           e == ENGINE_CPU_SIMD);
+                        }
+                        double time = now() - start;
+                        best = k == 0 || time < best ? time : best;
+                    }
+
+                    int pixels = size * size;
+                    uint64_t hash = checksum(iterations, pixels);
+                    // counted in one more untimed render, reading the counts back would slow down the timed ones;
+                    // cpu_simd iterates like cpu_scalar, lane by lane
+                    if (e == ENGINE_GPU_FRAGMENT) {
+                        gpu_engine_render_executed(&gpu, &view, size, size, iterations, executed);
+                    } else {
+                        cpu_render_executed(&params, &view, size, size, iterations, executed);
+                    }
+                    fprintf(output,
+                            "%s\n    {\"scene\": \"%s\", \"engine\": \"%s\", \"width\": %d, \"height\": %d, "
+                            "\"max_iter\": %d, \"wall_ms\": %.3f, \"mpix_per_s\": %.3f, \"total_iterations\": %llu, "
+                            "\"checksum\": \"%016llx\"}",
+                            first ? "" : ",", SCENES[s].name, ENGINE_NAMES[e], size, size, params.max_iter,
+                            best * 1000, pixels / best / 1e6,
+                            (unsigned long long)totalIterations(executed, pixels), (unsigned long long)hash);
+                    fflush(output);
+                    first = 0;
+                }
+            }
+            if (e == ENGINE_GPU_FRAGMENT) {
+                gpu_engine_destroy(&gpu);
+            }
+        }
+    }
+    fprintf(output, "\n  ],\n  \"skipped\": [");
+    first = 1;
+    for (int e = 0; e < ENGINE_COUNT; ++e) {
+        if (enabled[e] && skipped[e]) {
+            fprintf(output, "%s\n    {\"engine\": \"%s\", \"reason\": \"%s\"}", first ? "" : ",", ENGINE_NAMES[e],
+                    skipped[e]);
+            first = 0;
+        }
+    }
+    fprintf(output, "\n  ]\n}\n");
+
+    free(executed);
+    free(iterations);
+    if (haveContext) {
+        gl_context_destroy();
+    }
+    if (output != stdout) {
+        fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buddhabrot_engine.h"
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "png.h"
+
+// Renders a Buddhabrot, or with different iteration limits per channel a Nebulabrot (see buddhabrot_engine.h), to a
+// PNG. Samples run into the billions for a clean picture, so progress goes to stderr while they do. For a view
+// zoomed into a detail, --metropolis spends them on the orbits that pass through it.
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT.png [options]\n"
+           "  --size WIDTH HEIGHT     image size in pixels (default 1024 1024)\n"
+           "  --view X Y WIDTH        bottom left corner and width of the image in the plane\n"
+           "  --formula NAME          mandelbrot, multibrot, burning_ship, tricorn or newton\n"
+           "  --power N               power of multibrot and newton\n"
+           "  --max-iter N            iteration limit of all channels (default 1000)\n"
+           "  --nebula R G B          iteration limits of the red, green and blue channels\n"
+           "  --samples N             orbits to sample (default 10000000)\n"
+           "  --metropolis            Metropolis-Hastings sampling, for zoomed in views\n"
+           "  --seed N                (default 1)\n"
+           "  --threads N             (default: all cores)\n",
+           program);
+}
+
+void printProgress(double done, void* context) {
+    fprintf(stderr, "\r%5.1f%%", done * 100);
+    if (done >= 1) {
+        fprintf(stderr, "\n");
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    int width = 1024, height = 1024;
+    int threads = cpu_thread_count();
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+    // the whole of the set, which orbits leave on all sides
+    fractal_view view = {{-2, -1.5}, 3};
+    buddhabrot_options options;
+    buddhabrot_options_default(&options);
+    options.progress = printProgress;
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--view") == 0 && rest >= 3) {
+            view.corner[0] = atof(argv[++i]);
+            view.corner[1] = atof(argv[++i]);
+            view.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--formula") == 0 && rest >= 1) {
+            formula_id formula = formula_by_name(argv[++i]);
+            if (formula == FORMULA_COUNT) {
+                printf("Unknown formula %s\n", argv[i]);
+                return -1;
+            }
+            fractal_params_default(&params, formula);
+        } else if (strcmp(argv[i], "--power") == 0 && rest >= 1) {
+            params.power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            int maxIter = atoi(argv[++i]);
+            for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+                options.max_iter[k] = maxIter;
+            }
+        } else if (strcmp(argv[i], "--nebula") == 0 && rest >= BUDDHABROT_CHANNELS) {
+            for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+                options.max_iter[k] = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--samples") == 0 && rest >= 1) {
+            options.samples = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--metropolis") == 0) {
+            options.metropolis = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && rest >= 1) {
+            options.seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    int limitsValid = 1;
+    for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+        limitsValid &= options.max_iter[k] > 0;
+    }
+    if (width <= 0 || height <= 0 || view.width <= 0 || options.samples <= 0 || !limitsValid ||
+        params.power < MIN_POWER || params.power > MAX_POWER) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    size_t pixels = (size_t)width * height;
+    double* histograms = malloc(pixels * BUDDHABROT_CHANNELS * sizeof(double));
+    buddhabrot_stats stats;
+    if (!histograms || !buddhabrot_render(&params, &view, width, height, &options, threads, histograms, &stats)) {
+        printf("No memory for %dx%d histograms\n", width, height);
+        return -1;
+    }
+    printf("%lld samples in %.1f ms, %lld orbits counted", stats.samples, stats.milliseconds, stats.orbits);
+    if (options.metropolis) {
+        printf(", %.1f%% of the steps accepted", stats.samples ? 100.0 * stats.accepted / stats.samples : 0);
+    }
+    printf("\n");
+
+    unsigned char* rgb = malloc(pixels * 3);
+    unsigned char* flipped = malloc(pixels * 3);
+    buddhabrot_colorize(histograms, pixels, rgb);
+    for (int j = 0; j < height; ++j) {
+        memcpy(flipped + (size_t)j * width * 3, rgb + (size_t)(height - 1 - j) * width * 3, (size_t)width * 3);
+    }
+    size_t size;
+    unsigned char* png = png_encode_rgb(flipped, width, height, &size);
+    FILE* output = fopen(outputPath, "wb");
+    int result = output && fwrite(png, 1, size, output) == size ? 0 : -1;
+    if (output) {
+        fclose(output);
+    }
+    if (result != 0) {
+        printf("Couldn't write %s\n", outputPath);
+    }
+    free(png);
+    free(flipped);
+    free(rgb);
+    free(histograms);
+    return result;
+}
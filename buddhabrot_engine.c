@@ -0,0 +1,268 @@
+#include "buddhabrot_engine.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cpu_engine.h"
+
+// samples between updates of the shared progress counter
+#define PROGRESS_BATCH 1024
+
+static double milliseconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec * 1e-6;
+}
+
+// splitmix64, a separate stream per thread
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// [0, 1)
+static double uniform(uint64_t* state) {
+    return (next_random(state) >> 11) * 0x1p-53;
+}
+
+typedef struct {
+    const fractal_params* params;
+    const fractal_view* view;
+    int width;
+    int height;
+    const buddhabrot_options* options;
+    long long samples;
+    int thread;
+    long long* done;
+    int* finished;
+    // this thread's own
+    double* histograms;
+    double* orbit;
+    double* proposed;
+    long long orbits;
+    long long accepted;
+} buddhabrot_job;
+
+static int never_escapes(const fractal_params* params, double x, double y) {
+    if (params->formula != FORMULA_MANDELBROT) {
+        return 0;
+    }
+    double q = (x - 0.25) * (x - 0.25) + y * y;
+    return q * (q + x - 0.25) <= 0.25 * y * y || (x + 1) * (x + 1) + y * y <= 0.0625;
+}
+
+static int sample_limit(const buddhabrot_options* options) {
+    int limit = 0;
+    for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+        limit = options->max_iter[k] > limit ? options->max_iter[k] : limit;
+    }
+    return limit;
+}
+
+// Iterates c into orbit, returns the number of its points that land in the view: z_1 .. z_n for an orbit that
+// escaped at n, none for one that didn't. escaped is set to n, -1.
+static long count_points(const buddhabrot_job* job, double cx, double cy, double* orbit, int* escaped) {
+    *escaped = never_escapes(job->params, cx, cy) ? -1 : cpu_formula_orbit(job->params, cx, cy, orbit);
+    double pixel = job->view->width / job->width;
+    long count = 0;
+    for (int i = 0; i < *escaped; ++i) {
+        double x = (orbit[2 * i] - job->view->corner[0]) / pixel;
+        double y = (orbit[2 * i + 1] - job->view->corner[1]) / pixel;
+        count += x >= 0 && x < job->width && y >= 0 && y < job->height;
+    }
+    return count;
+}
+
+static void add_orbit(buddhabrot_job* job, const double* orbit, int escaped, double weight) {
+    double pixel = job->view->width / job->width;
+    size_t size = (size_t)job->width * job->height;
+    for (int i = 0; i < escaped; ++i) {
+        double x = (orbit[2 * i] - job->view->corner[0]) / pixel;
+        double y = (orbit[2 * i + 1] - job->view->corner[1]) / pixel;
+        if (!(x >= 0 && x < job->width && y >= 0 && y < job->height)) {
+            continue;
+        }
+        size_t index = (size_t)y * job->width + (size_t)x;
+        for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+            if (escaped < job->options->max_iter[k]) {
+                job->histograms[k * size + index] += weight;
+            }
+        }
+    }
+}
+
+// Adds the samples since the last report to the shared counter, every PROGRESS_BATCH samples or when forced.
+static void report(buddhabrot_job* job, long long sample, long long* reported, int force) {
+    if (force || sample - *reported >= PROGRESS_BATCH) {
+        __atomic_add_fetch(job->done, sample - *reported, __ATOMIC_RELAXED);
+        *reported = sample;
+    }
+}
+
+static void sample_uniform(buddhabrot_job* job, uint64_t* random) {
+    long long reported = 0;
+    for (long long s = 0; s < job->samples; ++s) {
+        double cx = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+        double cy = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+        int escaped;
+        if (count_points(job, cx, cy, job->orbit, &escaped) > 0) {
+            add_orbit(job, job->orbit, escaped, 1);
+            ++job->orbits;
+        }
+        report(job, s + 1, &reported, 0);
+    }
+    report(job, job->samples, &reported, 1);
+}
+
+static void sample_metropolis(buddhabrot_job* job, uint64_t* random) {
+    double cx = 0, cy = 0;
+    int escaped = -1;
+    long points = 0;
+    long long reported = 0;
+    for (int i = 0; i < BUDDHABROT_MAX_STARTS && points == 0; ++i) {
+        cx = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+        cy = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+        points = count_points(job, cx, cy, job->orbit, &escaped);
+    }
+    for (long long s = 0; s < job->samples && points > 0; ++s) {
+        double px, py;
+        if (uniform(random) < BUDDHABROT_JUMP_PROBABILITY) {
+            px = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+            py = (2 * uniform(random) - 1) * BUDDHABROT_SAMPLE_RADIUS;
+        } else {
+            double radius = job->view->width * BUDDHABROT_MUTATION_MAX *
+                            pow(BUDDHABROT_MUTATION_MIN / BUDDHABROT_MUTATION_MAX, uniform(random));
+            double angle = 2 * M_PI * uniform(random);
+            px = cx + radius * cos(angle);
+            py = cy + radius * sin(angle);
+        }
+        // both proposals are symmetric, so the acceptance is the ratio of the contributions alone
+        int proposedEscaped = -1;
+        long proposedPoints = fabs(px) <= BUDDHABROT_SAMPLE_RADIUS && fabs(py) <= BUDDHABROT_SAMPLE_RADIUS
+                                  ? count_points(job, px, py, job->proposed, &proposedEscaped)
+                                  : 0;
+        if (proposedPoints >= points || uniform(random) * points < proposedPoints) {
+            double* swap = job->orbit;
+            job->orbit = job->proposed;
+            job->proposed = swap;
+            cx = px;
+            cy = py;
+            escaped = proposedEscaped;
+            points = proposedPoints;
+            ++job->accepted;
+        }
+        add_orbit(job, job->orbit, escaped, 1.0 / points);
+        ++job->orbits;
+        report(job, s + 1, &reported, 0);
+    }
+    // a walk that found no start has nothing to add, its samples count as done anyway
+    report(job, job->samples, &reported, 1);
+}
+
+static void* render_samples(void* arg) {
+    buddhabrot_job* job = arg;
+    uint64_t random = job->options->seed + 0x632be59bd9b4e019ULL * (uint64_t)(job->thread + 1);
+    if (job->options->metropolis) {
+        sample_metropolis(job, &random);
+    } else {
+        sample_uniform(job, &random);
+    }
+    __atomic_add_fetch(job->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+void buddhabrot_options_default(buddhabrot_options* options) {
+    for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+        options->max_iter[k] = 1000;
+    }
+    options->samples = 10000000;
+    options->metropolis = 0;
+    options->seed = 1;
+    options->progress = NULL;
+    options->context = NULL;
+}
+
+int buddhabrot_render(const fractal_params* params, const fractal_view* view, int width, int height,
+                      const buddhabrot_options* options, int threads, double* histograms, buddhabrot_stats* stats) {
+    double start = milliseconds();
+    threads = threads > 0 ? threads : 1;
+    size_t size = (size_t)width * height * BUDDHABROT_CHANNELS;
+    fractal_params sampled = *params;
+    sampled.max_iter = sample_limit(options);
+
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    buddhabrot_job* jobs = calloc(threads, sizeof(buddhabrot_job));
+    long long done = 0;
+    int finished = 0, started = 0, result = 1;
+    for (int t = 0; t < threads; ++t) {
+        buddhabrot_job* job = &jobs[t];
+        *job = (buddhabrot_job){&sampled, view, width, height, options, options->samples / threads, t, &done,
+                                &finished};
+        job->samples += t < options->samples % threads;
+        job->histograms = calloc(size, sizeof(double));
+        job->orbit = malloc((size_t)sampled.max_iter * 2 * sizeof(double));
+        job->proposed = malloc((size_t)sampled.max_iter * 2 * sizeof(double));
+        if (!job->histograms || !job->orbit || !job->proposed) {
+            fprintf(stderr, "No memory for the histograms of %d threads\n", threads);
+            result = 0;
+            break;
+        }
+        pthread_create(&workers[t], NULL, render_samples, job);
+        ++started;
+    }
+    // the workers that did start finish their share, the result is thrown away then
+    while (__atomic_load_n(&finished, __ATOMIC_ACQUIRE) < started) {
+        if (options->progress && result) {
+            options->progress((double)__atomic_load_n(&done, __ATOMIC_RELAXED) / options->samples, options->context);
+        }
+        struct timespec pause = {0, BUDDHABROT_PROGRESS_MILLISECONDS * 1000000L};
+        nanosleep(&pause, NULL);
+    }
+
+    memset(histograms, 0, size * sizeof(double));
+    buddhabrot_stats total = {0};
+    for (int t = 0; t < started; ++t) {
+        pthread_join(workers[t], NULL);
+        for (size_t i = 0; i < size; ++i) {
+            histograms[i] += jobs[t].histograms[i];
+        }
+        total.samples += jobs[t].samples;
+        total.orbits += jobs[t].orbits;
+        total.accepted += jobs[t].accepted;
+    }
+    for (int t = 0; t < threads; ++t) {
+        free(jobs[t].histograms);
+        free(jobs[t].orbit);
+        free(jobs[t].proposed);
+    }
+    free(jobs);
+    free(workers);
+    if (options->progress && result) {
+        options->progress(1, options->context);
+    }
+    total.milliseconds = milliseconds() - start;
+    if (stats) {
+        *stats = total;
+    }
+    return result;
+}
+
+void buddhabrot_colorize(const double* histograms, int count, unsigned char* rgb) {
+    for (int k = 0; k < BUDDHABROT_CHANNELS; ++k) {
+        const double* channel = histograms + (size_t)k * count;
+        double highest = 0;
+        for (int i = 0; i < count; ++i) {
+            highest = channel[i] > highest ? channel[i] : highest;
+        }
+        for (int i = 0; i < count; ++i) {
+            double value = highest > 0 ? sqrt(channel[i] / highest) : 0;
+            rgb[3 * i + k] = (unsigned char)(value * 255.0 + 0.5);
+        }
+    }
+}
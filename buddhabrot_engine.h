@@ -0,0 +1,65 @@
+#ifndef BUDDHABROT_ENGINE_H
+#define BUDDHABROT_ENGINE_H
+
+#include <stdint.h>
+
+#include "fractal.h"
+
+// Buddhabrot renderer: rather than coloring each c by when its orbit escapes, random c are sampled and every point
+// their escaping orbits visit is counted in a density histogram over the view. A Nebulabrot has three histograms,
+// red, green and blue, each counting only the orbits that escape within its own iteration limit.
+//
+// Each thread samples into its own histograms, which are only summed at the end, so no counter is ever shared. The
+// samples are spread uniformly over the square |x|, |y| <= BUDDHABROT_SAMPLE_RADIUS, except for the Mandelbrot set's
+// main cardioid and period 2 bulb, which never escape. In a zoomed in view almost none of those orbits pass through
+// it, so there Metropolis-Hastings sampling pays off: each thread walks from c to c' with small steps relative to
+// the view (and now and then a uniform jump), accepting with the ratio of the points the orbits put into the view.
+// That visits c in proportion to what they contribute, so each orbit is counted with weight 1 over it.
+//
+// Histograms are laid out like cpu_render_iterations' images, channel after channel. Their scale differs between
+// the samplers, only the ratios between pixels mean anything.
+
+#define BUDDHABROT_CHANNELS 3
+#define BUDDHABROT_SAMPLE_RADIUS 2.0
+// steps of the walk are log uniform between these fractions of the view's width
+#define BUDDHABROT_MUTATION_MIN 1e-4
+#define BUDDHABROT_MUTATION_MAX 1e-1
+#define BUDDHABROT_JUMP_PROBABILITY 0.2
+// uniform samples a walk may take to find its first c that reaches the view
+#define BUDDHABROT_MAX_STARTS 1000000
+#define BUDDHABROT_PROGRESS_MILLISECONDS 250
+
+// Called on the calling thread every BUDDHABROT_PROGRESS_MILLISECONDS with the fraction of samples done.
+typedef void (*buddhabrot_progress)(double done, void* context);
+
+typedef struct {
+    // iteration limit of each channel, the formula's is ignored
+    int max_iter[BUDDHABROT_CHANNELS];
+    long long samples;
+    int metropolis;
+    uint64_t seed;
+    // may be NULL
+    buddhabrot_progress progress;
+    void* context;
+} buddhabrot_options;
+
+typedef struct {
+    double milliseconds;
+    long long samples;
+    // samples whose orbits escaped within an iteration limit, and put points into the view
+    long long orbits;
+    // Metropolis-Hastings steps that moved to the proposed c
+    long long accepted;
+} buddhabrot_stats;
+
+// Uniform sampling of 10 million orbits, all channels up to 1000 iterations.
+void buddhabrot_options_default(buddhabrot_options* options);
+
+// Fills histograms, BUDDHABROT_CHANNELS x width x height of them. Returns 0 if out of memory. stats may be NULL.
+int buddhabrot_render(const fractal_params* params, const fractal_view* view, int width, int height,
+                      const buddhabrot_options* options, int threads, double* histograms, buddhabrot_stats* stats);
+
+// Maps each channel to 3 bytes per pixel, the square root of the density over the channel's highest.
+void buddhabrot_colorize(const double* histograms, int count, unsigned char* rgb);
+
+#endif
@@ -0,0 +1,16 @@
+#version 330 core
+
+// Colors the iterations rendered by the OUTPUT_ITERATIONS variant of fragment_shader.glsl.
+// The formula defines and fractal_kernel.glsl are spliced in after the #version line for its palettes.
+
+in vec2 coords;
+out vec4 color;
+
+uniform sampler2D iterations;
+// turns of the palette per unit of the orbit statistic in blue, for colorings that have one
+uniform float statistic_density;
+
+void main() {
+    vec4 texel = texture(iterations, coords * 0.5 + vec2(0.5, 0.5));
+    color = vec4(color_by_result(COLORING, int(texel.r), texel.b, statistic_density), 1);
+}
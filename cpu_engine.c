@@ -0,0 +1,491 @@
+#include "cpu_engine.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef double real;
+typedef struct {
+    real x, y;
+} vec2;
+typedef struct {
+    real x, y, z;
+} vec3;
+
+#define real(a) ((real)(a))
+#define vec2(x, y) ((vec2){(x), (y)})
+#define vec3(x, y, z) ((vec3){(x), (y), (z)})
+
+#define FRACTAL_KERNEL_HOST
+#include "fractal_kernel.glsl"
+
+// The kernel's functions are too big for the compiler to inline on its own, and only once inlined do they see the
+// constant formula. Flattening pulls them into the row loops, which are inlined into each instantiation below.
+#if defined(__GNUC__)
+#define KERNEL_ROWS __attribute__((flatten))
+#else
+#define KERNEL_ROWS
+#endif
+
+// formula and power are constants in each instantiation below, so the compiler folds away the dispatch in
+// formula_step and formula_done the same way the shader compiler does for FORMULA and POWER, and the executed
+// count where it is NULL.
+static inline KERNEL_ROWS void render_rows(int formula, int power, int maxIter, const fractal_view* view,
+                                           int width, int height, int* iterations, int* executed) {
+    real pixel = view->width / width;
+    for (int j = 0; j < height; ++j) {
+        real y = view->corner[1] + (j + 0.5) * pixel;
+        for (int i = 0; i < width; ++i) {
+            real x = view->corner[0] + (i + 0.5) * pixel;
+            vec2 result = formula_iterate_executed(formula, power, vec2(x, y), maxIter);
+            iterations[j * width + i] = (int)result.x;
+            if (executed) {
+                executed[j * width + i] = (int)result.y;
+            }
+        }
+    }
+}
+
+#define DEFINE_CPU_KERNEL(name, formula)                                                                     \
+    static void render_##name(int power, int maxIter, const fractal_view* view, int width, int height,     \
+                              int* iterations) {                                                           \
+        render_rows(formula, power, maxIter, view, width, height, iterations, NULL);                       \
+    }                                                                                                      \
+    static void render_##name##_executed(int power, int maxIter, const fractal_view* view, int width,      \
+                                         int height, int* iterations, int* executed) {                     \
+        render_rows(formula, power, maxIter, view, width, height, iterations, executed);                   \
+    }
+
+DEFINE_CPU_KERNEL(mandelbrot, FORMULA_MANDELBROT)
+DEFINE_CPU_KERNEL(multibrot, FORMULA_MULTIBROT)
+DEFINE_CPU_KERNEL(burning_ship, FORMULA_BURNING_SHIP)
+DEFINE_CPU_KERNEL(tricorn, FORMULA_TRICORN)
+DEFINE_CPU_KERNEL(newton, FORMULA_NEWTON)
+
+typedef void (*cpu_kernel)(int power, int maxIter, const fractal_view* view, int width, int height,
+                           int* iterations);
+
+static const cpu_kernel KERNELS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = render_mandelbrot,     [FORMULA_MULTIBROT] = render_multibrot,
+    [FORMULA_BURNING_SHIP] = render_burning_ship, [FORMULA_TRICORN] = render_tricorn,
+    [FORMULA_NEWTON] = render_newton,
+};
+
+typedef void (*cpu_executed_kernel)(int power, int maxIter, const fractal_view* view, int width, int height,
+                                    int* iterations, int* executed);
+
+static const cpu_executed_kernel EXECUTED_KERNELS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = render_mandelbrot_executed,     [FORMULA_MULTIBROT] = render_multibrot_executed,
+    [FORMULA_BURNING_SHIP] = render_burning_ship_executed, [FORMULA_TRICORN] = render_tricorn_executed,
+    [FORMULA_NEWTON] = render_newton_executed,
+};
+
+static inline KERNEL_ROWS void render_rows_statistic(int formula, int coloring, int power, int maxIter,
+                                                     const fractal_view* view, int width, int height,
+                                                     int* iterations, float* statistics) {
+    real pixel = view->width / width;
+    for (int j = 0; j < height; ++j) {
+        real y = view->corner[1] + (j + 0.5) * pixel;
+        for (int i = 0; i < width; ++i) {
+            real x = view->corner[0] + (i + 0.5) * pixel;
+            vec3 result = formula_iterate_statistic(formula, power, coloring, vec2(x, y), maxIter, pixel);
+            iterations[j * width + i] = (int)result.x;
+            statistics[j * width + i] = (float)result.y;
+        }
+    }
+}
+
+// One kernel per formula and statistic, like the plain ones above.
+#define DEFINE_CPU_STATISTIC_KERNEL(name, formula, coloring)                                                 \
+    static void render_##name##_##coloring(int power, int maxIter, const fractal_view* view, int width,      \
+                                           int height, int* iterations, float* statistics) {                 \
+        render_rows_statistic(formula, coloring, power, maxIter, view, width, height, iterations,            \
+                              statistics);                                                                   \
+    }
+
+#define DEFINE_CPU_STATISTIC_KERNELS(name, formula)                                                          \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_TRAP_POINT)                                          \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_TRAP_LINE)                                           \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_TRAP_CROSS)                                          \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_STRIPE)                                              \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_TRIANGLE)                                            \
+    DEFINE_CPU_STATISTIC_KERNEL(name, formula, COLORING_INTERIOR_DISTANCE)
+
+DEFINE_CPU_STATISTIC_KERNELS(mandelbrot, FORMULA_MANDELBROT)
+DEFINE_CPU_STATISTIC_KERNELS(multibrot, FORMULA_MULTIBROT)
+DEFINE_CPU_STATISTIC_KERNELS(burning_ship, FORMULA_BURNING_SHIP)
+DEFINE_CPU_STATISTIC_KERNELS(tricorn, FORMULA_TRICORN)
+DEFINE_CPU_STATISTIC_KERNELS(newton, FORMULA_NEWTON)
+
+typedef void (*cpu_statistic_kernel)(int power, int maxIter, const fractal_view* view, int width, int height,
+                                     int* iterations, float* statistics);
+
+#define CPU_STATISTIC_KERNELS(name)                                                                          \
+    {                                                                                                        \
+        [COLORING_TRAP_POINT] = render_##name##_COLORING_TRAP_POINT,                                         \
+        [COLORING_TRAP_LINE] = render_##name##_COLORING_TRAP_LINE,                                           \
+        [COLORING_TRAP_CROSS] = render_##name##_COLORING_TRAP_CROSS,                                         \
+        [COLORING_STRIPE] = render_##name##_COLORING_STRIPE,                                                 \
+        [COLORING_TRIANGLE] = render_##name##_COLORING_TRIANGLE,                                             \
+        [COLORING_INTERIOR_DISTANCE] = render_##name##_COLORING_INTERIOR_DISTANCE,                           \
+    }
+
+static const cpu_statistic_kernel STATISTIC_KERNELS[FORMULA_COUNT][COLORING_COUNT] = {
+    [FORMULA_MANDELBROT] = CPU_STATISTIC_KERNELS(mandelbrot),
+    [FORMULA_MULTIBROT] = CPU_STATISTIC_KERNELS(multibrot),
+    [FORMULA_BURNING_SHIP] = CPU_STATISTIC_KERNELS(burning_ship),
+    [FORMULA_TRICORN] = CPU_STATISTIC_KERNELS(tricorn),
+    [FORMULA_NEWTON] = CPU_STATISTIC_KERNELS(newton),
+};
+
+// formula_run, keeping what a raw dump holds besides the iteration (see raw_dump.h): the fraction of the smooth
+// iteration count, the distance estimate |z| log |z| / |dz/dc| and the last z.
+static inline KERNEL_ROWS void render_rows_raw(int formula, int power, int maxIter, const fractal_view* view,
+                                               int width, int height, int* iterations, float* smooth,
+                                               float* distance, float* lastZ) {
+    // z depends on c holomorphically, so dz/dc is a complex number
+    bool holomorphic = formula == FORMULA_MANDELBROT || formula == FORMULA_MULTIBROT;
+    real pixel = view->width / width;
+    for (int j = 0; j < height; ++j) {
+        real y = view->corner[1] + (j + 0.5) * pixel;
+        for (int i = 0; i < width; ++i) {
+            real x = view->corner[0] + (i + 0.5) * pixel;
+            vec2 c = vec2(x, y);
+            formula_orbit orbit = formula_run(formula, power, c, maxIter, holomorphic);
+            vec2 z = orbit.z;
+            int escaped = orbit.escaped;
+
+            int index = j * width + i;
+            iterations[index] = escaped;
+            smooth[index] = NAN;
+            distance[index] = NAN;
+            if (escaped >= 0 && formula != FORMULA_NEWTON) {
+                real logZ = 0.5 * log(complex_squared_abs(z));
+                // the shader's fraction for power 2
+                real fraction = 1.0 - log(logZ / log(2.0)) / log(real(power));
+                smooth[index] = fraction < 0.0 ? 0.0 : fraction > 1.0 ? 1.0 : fraction;
+                if (holomorphic) {
+                    distance[index] = sqrt(complex_squared_abs(z) / complex_squared_abs(orbit.dc)) * logZ;
+                }
+            }
+            lastZ[2 * index] = z.x;
+            lastZ[2 * index + 1] = z.y;
+        }
+    }
+}
+
+#define DEFINE_CPU_RAW_KERNEL(name, formula)                                                                 \
+    static void raw_##name(int power, int maxIter, const fractal_view* view, int width, int height,        \
+                           int* iterations, float* smooth, float* distance, float* z) {                    \
+        render_rows_raw(formula, power, maxIter, view, width, height, iterations, smooth, distance, z);    \
+    }
+
+DEFINE_CPU_RAW_KERNEL(mandelbrot, FORMULA_MANDELBROT)
+DEFINE_CPU_RAW_KERNEL(multibrot, FORMULA_MULTIBROT)
+DEFINE_CPU_RAW_KERNEL(burning_ship, FORMULA_BURNING_SHIP)
+DEFINE_CPU_RAW_KERNEL(tricorn, FORMULA_TRICORN)
+DEFINE_CPU_RAW_KERNEL(newton, FORMULA_NEWTON)
+
+typedef void (*cpu_raw_kernel)(int power, int maxIter, const fractal_view* view, int width, int height,
+                               int* iterations, float* smooth, float* distance, float* z);
+
+static const cpu_raw_kernel RAW_KERNELS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = raw_mandelbrot,     [FORMULA_MULTIBROT] = raw_multibrot,
+    [FORMULA_BURNING_SHIP] = raw_burning_ship, [FORMULA_TRICORN] = raw_tricorn,
+    [FORMULA_NEWTON] = raw_newton,
+};
+
+// formula_iterate, keeping z_1 .. z_{n+1}
+static inline int iterate_orbit(int formula, int power, int maxIter, vec2 c, real* z) {
+    vec2 point = formula_start(formula, c);
+    for (int i = 0; i < maxIter; ++i) {
+        vec2 previous = point;
+        point = formula_step(formula, power, point, c);
+        z[2 * i] = point.x;
+        z[2 * i + 1] = point.y;
+        if (formula_done(formula, point, previous)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#define DEFINE_CPU_ORBIT(name, formula)                                                                      \
+    static int orbit_##name(int power, int maxIter, double cx, double cy, double* z) {                       \
+        return iterate_orbit(formula, power, maxIter, vec2(cx, cy), z);                                      \
+    }
+
+DEFINE_CPU_ORBIT(mandelbrot, FORMULA_MANDELBROT)
+DEFINE_CPU_ORBIT(multibrot, FORMULA_MULTIBROT)
+DEFINE_CPU_ORBIT(burning_ship, FORMULA_BURNING_SHIP)
+DEFINE_CPU_ORBIT(tricorn, FORMULA_TRICORN)
+DEFINE_CPU_ORBIT(newton, FORMULA_NEWTON)
+
+typedef int (*cpu_orbit)(int power, int maxIter, double cx, double cy, double* z);
+
+static const cpu_orbit ORBITS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = orbit_mandelbrot,     [FORMULA_MULTIBROT] = orbit_multibrot,
+    [FORMULA_BURNING_SHIP] = orbit_burning_ship, [FORMULA_TRICORN] = orbit_tricorn,
+    [FORMULA_NEWTON] = orbit_newton,
+};
+
+#if defined(__GNUC__)
+
+// SIMD_LANES orbits side by side in GCC/Clang vector types, which compile to whatever vector instructions the
+// target has. Only the escape time formulas have a vector version, Newton's divisions stay scalar.
+#if defined(__AVX__)
+#define SIMD_LANES 4
+#else
+#define SIMD_LANES 2
+#endif
+#define SIMD_CHECK_INTERVAL 8
+typedef double lanes __attribute__((vector_size(SIMD_LANES * sizeof(double))));
+typedef long long lane_mask __attribute__((vector_size(SIMD_LANES * sizeof(long long))));
+
+static inline lanes select_lanes(lane_mask mask, lanes a, lanes b) {
+    return (lanes)((mask & (lane_mask)a) | (~mask & (lane_mask)b));
+}
+
+// Same arithmetic as formula_step in fractal_kernel.glsl, in the same order, so both paths give equal results.
+static inline void step_lanes(int formula, int power, lanes* x, lanes* y, lanes cx, lanes cy) {
+    lanes zx = *x, zy = *y;
+    lanes zero = {0};
+    if (formula == FORMULA_BURNING_SHIP) {
+        zx = select_lanes(zx < zero, -zx, zx);
+        zy = select_lanes(zy < zero, -zy, zy);
+    } else if (formula == FORMULA_TRICORN) {
+        zy = -zy;
+    }
+    if (formula == FORMULA_MULTIBROT) {
+        // complex_pow
+        lanes resultX = zx, resultY = zy;
+        int rest = power - 1;
+        while (rest > 0) {
+            if (rest % 2 == 1) {
+                lanes t = resultX * zx - resultY * zy;
+                resultY = resultX * zy + resultY * zx;
+                resultX = t;
+            }
+            rest /= 2;
+            if (rest > 0) {
+                lanes t = zx * zx - zy * zy;
+                zy = 2.0 * zx * zy;
+                zx = t;
+            }
+        }
+        *x = resultX + cx;
+        *y = resultY + cy;
+    } else {
+        *x = zx * zx - zy * zy + cx;
+        *y = 2.0 * zx * zy + cy;
+    }
+}
+
+static inline void render_rows_simd(int formula, int power, int maxIter, const fractal_view* view, int width,
+                                    int height, int* iterations) {
+    real pixel = view->width / width;
+    for (int j = 0; j < height; ++j) {
+        real y = view->corner[1] + (j + 0.5) * pixel;
+        for (int i = 0; i < width; i += SIMD_LANES) {
+            lanes cx = {0}, cy = {0};
+            for (int l = 0; l < SIMD_LANES; ++l) {
+                // the last group of a row repeats its last pixel
+                int column = i + l < width ? i + l : width - 1;
+                cx[l] = view->corner[0] + (column + 0.5) * pixel;
+                cy[l] = y;
+            }
+            lanes zx = {0}, zy = {0};
+            lanes dzx = {0}, dzy = {0};
+            dzx += 1.0;
+            lane_mask active = {0};
+            lane_mask count = {0};
+            lane_mask interior = {0};
+            active = ~active;
+            for (int k = 0; k < maxIter;) {
+                // checking whether any lane is still running costs more than a few extra steps
+                int end = k + SIMD_CHECK_INTERVAL < maxIter ? k + SIMD_CHECK_INTERVAL : maxIter;
+                for (; k < end; ++k) {
+                    // finished lanes keep iterating into infinities and NaNs, which can't set active again
+                    step_lanes(formula, power, &zx, &zy, cx, cy);
+                    active &= ~(zx * zx + zy * zy >= 4.0);
+                    count -= active;
+                    if (formula_checks_interior(formula)) {
+                        // formula_derivative_step
+                        lanes x = (2.0 * zx) * dzx - (2.0 * zy) * dzy;
+                        dzy = (2.0 * zx) * dzy + (2.0 * zy) * dzx;
+                        dzx = x;
+                        lane_mask caught = active & (dzx * dzx + dzy * dzy < INTERIOR_THRESHOLD);
+                        interior |= caught;
+                        active &= ~caught;
+                    }
+                }
+                long long any = 0;
+                for (int l = 0; l < SIMD_LANES; ++l) {
+                    any |= active[l];
+                }
+                if (!any) {
+                    break;
+                }
+            }
+            for (int l = 0; l < SIMD_LANES && i + l < width; ++l) {
+                iterations[j * width + i + l] = active[l] || interior[l] ? -1 : count[l];
+            }
+        }
+    }
+}
+
+#define DEFINE_CPU_SIMD_KERNEL(name, formula)                                                                \
+    static void render_##name##_simd(int power, int maxIter, const fractal_view* view, int width, int height, \
+                                     int* iterations) {                                                    \
+        render_rows_simd(formula, power, maxIter, view, width, height, iterations);                        \
+    }
+
+DEFINE_CPU_SIMD_KERNEL(mandelbrot, FORMULA_MANDELBROT)
+DEFINE_CPU_SIMD_KERNEL(multibrot, FORMULA_MULTIBROT)
+DEFINE_CPU_SIMD_KERNEL(burning_ship, FORMULA_BURNING_SHIP)
+DEFINE_CPU_SIMD_KERNEL(tricorn, FORMULA_TRICORN)
+
+static const cpu_kernel SIMD_KERNELS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = render_mandelbrot_simd,     [FORMULA_MULTIBROT] = render_multibrot_simd,
+    [FORMULA_BURNING_SHIP] = render_burning_ship_simd, [FORMULA_TRICORN] = render_tricorn_simd,
+    [FORMULA_NEWTON] = render_newton,
+};
+
+#else
+
+#define SIMD_KERNELS KERNELS
+
+#endif
+
+void cpu_render_iterations(const fractal_params* params, const fractal_view* view, int width, int height,
+                           int* iterations) {
+    KERNELS[params->formula](params->power, params->max_iter, view, width, height, iterations);
+}
+
+void cpu_render_iterations_simd(const fractal_params* params, const fractal_view* view, int width, int height,
+                                int* iterations) {
+    SIMD_KERNELS[params->formula](params->power, params->max_iter, view, width, height, iterations);
+}
+
+void cpu_render_executed(const fractal_params* params, const fractal_view* view, int width, int height,
+                         int* iterations, int* executed) {
+    EXECUTED_KERNELS[params->formula](params->power, params->max_iter, view, width, height, iterations, executed);
+}
+
+void cpu_render_statistics(const fractal_params* params, const fractal_view* view, int width, int height,
+                           int* iterations, float* statistics) {
+    if (params->coloring == COLORING_ITERATIONS) {
+        cpu_render_iterations(params, view, width, height, iterations);
+        for (int i = 0; i < width * height; ++i) {
+            statistics[i] = 0;
+        }
+        return;
+    }
+    STATISTIC_KERNELS[params->formula][params->coloring](params->power, params->max_iter, view, width, height,
+                                                         iterations, statistics);
+}
+
+void cpu_render_raw(const fractal_params* params, const fractal_view* view, int width, int height, int* iterations,
+                    float* smooth, float* distance, float* z) {
+    RAW_KERNELS[params->formula](params->power, params->max_iter, view, width, height, iterations, smooth, distance,
+                                 z);
+}
+
+int cpu_formula_orbit(const fractal_params* params, double cx, double cy, double* z) {
+    return ORBITS[params->formula](params->power, params->max_iter, cx, cy, z);
+}
+
+typedef struct {
+    const fractal_params* params;
+    const fractal_view* view;
+    int width;
+    int height;
+    int* iterations;
+    // cpu_render_statistics instead of the plain kernels when set
+    float* statistics;
+    int simd;
+    int first;
+    int step;
+} render_job;
+
+static void* render_interleaved_rows(void* arg) {
+    render_job* job = arg;
+    real pixel = job->view->width / job->width;
+    for (int j = job->first; j < job->height; j += job->step) {
+        fractal_view row = {{job->view->corner[0], job->view->corner[1] + j * pixel}, job->view->width};
+        if (job->statistics) {
+            cpu_render_statistics(job->params, &row, job->width, 1, job->iterations + j * job->width,
+                                  job->statistics + j * job->width);
+        } else if (job->simd) {
+            cpu_render_iterations_simd(job->params, &row, job->width, 1, job->iterations + j * job->width);
+        } else {
+            cpu_render_iterations(job->params, &row, job->width, 1, job->iterations + j * job->width);
+        }
+    }
+    return NULL;
+}
+
+// Runs job on threads threads, each taking every threads-th row from its own first one.
+static void render_interleaved(render_job job, int threads) {
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    render_job* jobs = malloc(threads * sizeof(render_job));
+    for (int t = 0; t < threads; ++t) {
+        jobs[t] = job;
+        jobs[t].first = t;
+        jobs[t].step = threads;
+        pthread_create(&workers[t], NULL, render_interleaved_rows, &jobs[t]);
+    }
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(workers[t], NULL);
+    }
+    free(jobs);
+    free(workers);
+}
+
+void cpu_render_iterations_parallel(const fractal_params* params, const fractal_view* view, int width, int height,
+                                    int* iterations, int threads, int simd) {
+    if (threads <= 1) {
+        if (simd) {
+            cpu_render_iterations_simd(params, view, width, height, iterations);
+        } else {
+            cpu_render_iterations(params, view, width, height, iterations);
+        }
+        return;
+    }
+    render_interleaved((render_job){params, view, width, height, iterations, NULL, simd, 0, 1}, threads);
+}
+
+void cpu_render_statistics_parallel(const fractal_params* params, const fractal_view* view, int width, int height,
+                                    int* iterations, float* statistics, int threads) {
+    if (threads <= 1) {
+        cpu_render_statistics(params, view, width, height, iterations, statistics);
+        return;
+    }
+    render_interleaved((render_job){params, view, width, height, iterations, statistics, 0, 0, 1}, threads);
+}
+
+int cpu_thread_count(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? count : 1;
+}
+
+void colorize_statistics(coloring_id coloring, const int* iterations, const float* statistics, int count,
+                         double density, unsigned char* rgb) {
+    for (int i = 0; i < count; ++i) {
+        vec3 color = color_by_result(coloring, iterations[i], statistics[i], density);
+        rgb[3 * i + 0] = (unsigned char)(color.x * 255.0 + 0.5);
+        rgb[3 * i + 1] = (unsigned char)(color.y * 255.0 + 0.5);
+        rgb[3 * i + 2] = (unsigned char)(color.z * 255.0 + 0.5);
+    }
+}
+
+void colorize_iterations(const int* iterations, int count, unsigned char* rgb) {
+    for (int i = 0; i < count; ++i) {
+        vec3 color = iterations[i] >= 0 ? color_by_iter_rainbow(iterations[i]) : vec3(0.0, 0.0, 0.0);
+        rgb[3 * i + 0] = (unsigned char)(color.x * 255.0 + 0.5);
+        rgb[3 * i + 1] = (unsigned char)(color.y * 255.0 + 0.5);
+        rgb[3 * i + 2] = (unsigned char)(color.z * 255.0 + 0.5);
+    }
+}
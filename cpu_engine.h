@@ -0,0 +1,55 @@
+#ifndef CPU_ENGINE_H
+#define CPU_ENGINE_H
+
+#include "fractal.h"
+
+// CPU counterpart of fragment_shader.glsl, built from the same fractal_kernel.glsl but in double precision.
+// Images are stored the way glReadPixels returns them: row by row from the bottom, pixel centers at
+// corner + (i + 0.5) * width / imageWidth.
+
+// Iteration at which every pixel escaped (or converged), -1 for pixels that did neither.
+void cpu_render_iterations(const fractal_params* params, const fractal_view* view, int width, int height,
+                           int* iterations);
+
+// Same as cpu_render_iterations, several neighbouring pixels at once in vector registers.
+void cpu_render_iterations_simd(const fractal_params* params, const fractal_view* view, int width, int height,
+                                int* iterations);
+
+// Either of the above with the rows interleaved between threads.
+void cpu_render_iterations_parallel(const fractal_params* params, const fractal_view* view, int width, int height,
+                                    int* iterations, int threads, int simd);
+
+// cpu_render_iterations with how many iterations each pixel executed in executed: one more than the iteration where
+// it escaped, max_iter where it didn't, unless the interior check stopped it earlier.
+void cpu_render_executed(const fractal_params* params, const fractal_view* view, int width, int height,
+                         int* iterations, int* executed);
+
+// cpu_render_iterations with the orbit statistic of params->coloring (see formula_iterate_statistic) of every
+// pixel in statistics, 0 for COLORING_ITERATIONS. Each statistic is a kernel of its own, like the formulas.
+void cpu_render_statistics(const fractal_params* params, const fractal_view* view, int width, int height,
+                           int* iterations, float* statistics);
+// The same with the rows interleaved between threads.
+void cpu_render_statistics_parallel(const fractal_params* params, const fractal_view* view, int width, int height,
+                                    int* iterations, float* statistics, int threads);
+
+// cpu_render_iterations with the other planes of a raw dump (see raw_dump.h): the fraction of the smooth iteration
+// count, the exterior distance estimate in the plane, NaN where they aren't defined, and z at the last iteration,
+// x and y interleaved.
+void cpu_render_raw(const fractal_params* params, const fractal_view* view, int width, int height, int* iterations,
+                    float* smooth, float* distance, float* z);
+
+// The orbit of c = (cx, cy) behind cpu_render_iterations' result n: z_1 .. z_{n+1} when it escaped (or converged)
+// at n, z_1 .. z_max_iter otherwise, x and y interleaved. Returns n, -1 if it did neither.
+int cpu_formula_orbit(const fractal_params* params, double cx, double cy, double* z);
+
+// Number of threads worth using on this machine.
+int cpu_thread_count(void);
+
+// Colors iterations with the same palette as the shader, 3 bytes per pixel.
+void colorize_iterations(const int* iterations, int count, unsigned char* rgb);
+// The same for statistics, with the shader's palettes for the coloring turning density times per unit. Only needs
+// cpu_render_statistics again when the statistic itself changes.
+void colorize_statistics(coloring_id coloring, const int* iterations, const float* statistics, int count,
+                         double density, unsigned char* rgb);
+
+#endif
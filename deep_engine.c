@@ -0,0 +1,462 @@
+#include "deep_engine.h"
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "nucleus.h"
+#include "orbit_cache.h"
+
+// bits of a double-double, and the bits beyond those that address a pixel kept like precision_tier_for_view does
+#define DOUBLE_DOUBLE_BITS 106
+#define DEEP_GUARD_BITS 4
+
+static double milliseconds(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec * 1e-6;
+}
+
+int reference_orbit_continue(double* z, double_double state[2], const double_double center[2], int from, int maxIter) {
+    double_double x = state[0], y = state[1];
+    int n = from;
+    for (;; ++n) {
+        z[2 * n] = dd_to_double(x);
+        z[2 * n + 1] = dd_to_double(y);
+        if (z[2 * n] * z[2 * n] + z[2 * n + 1] * z[2 * n + 1] >= 4.0 || n == maxIter) {
+            break;
+        }
+        double_double nextX = dd_add(dd_sub(dd_square(x), dd_square(y)), center[0]);
+        y = dd_add(dd_mul_double(dd_mul(x, y), 2), center[1]);
+        x = nextX;
+    }
+    state[0] = x;
+    state[1] = y;
+    return n;
+}
+
+int reference_orbit_continue_mp(double* z, mp_number state[2], const mp_number center[2], int from, int maxIter) {
+    mp_number* x = &state[0];
+    mp_number* y = &state[1];
+    mp_number xx, yy, sum;
+    int n = from;
+    for (;; ++n) {
+        z[2 * n] = mp_to_double(x);
+        z[2 * n + 1] = mp_to_double(y);
+        if (z[2 * n] * z[2 * n] + z[2 * n + 1] * z[2 * n + 1] >= 4.0 || n == maxIter) {
+            break;
+        }
+        // three squares instead of two and a product: 2 x y = (x + y)^2 - x^2 - y^2
+        mp_square(&xx, x);
+        mp_square(&yy, y);
+        mp_add(&sum, x, y);
+        mp_square(&sum, &sum);
+        mp_sub(&sum, &sum, &xx);
+        mp_sub(&sum, &sum, &yy);
+        mp_add(y, &sum, &center[1]);
+        mp_sub(x, &xx, &yy);
+        mp_add(x, x, &center[0]);
+    }
+    return n;
+}
+
+int reference_orbit_compute(reference_orbit* orbit, const double_double center[2], int maxIter) {
+    orbit->center[0] = center[0];
+    orbit->center[1] = center[1];
+    orbit->max_iter = maxIter;
+    orbit->cached = 0;
+    orbit->z = malloc(((size_t)maxIter + 1) * 2 * sizeof(double));
+    if (!orbit->z) {
+        return 0;
+    }
+    double_double state[2] = {{0, 0}, {0, 0}};
+    orbit->length = reference_orbit_continue(orbit->z, state, center, 0, maxIter);
+    return 1;
+}
+
+double_double mp_to_double_double(const mp_number* a) {
+    mp_number high, rest;
+    mp_from_double(&high, mp_to_double(a), a->limbs);
+    mp_sub(&rest, a, &high);
+    return dd_quick_two_sum(mp_to_double(&high), mp_to_double(&rest));
+}
+
+void mp_from_double_double(mp_number* result, double_double value, int limbs) {
+    mp_number low;
+    mp_from_double(result, value.hi, limbs);
+    mp_from_double(&low, value.lo, limbs);
+    mp_add(result, result, &low);
+}
+
+int reference_orbit_compute_mp(reference_orbit* orbit, const mp_number center[2], int maxIter) {
+    orbit->center[0] = mp_to_double_double(&center[0]);
+    orbit->center[1] = mp_to_double_double(&center[1]);
+    orbit->max_iter = maxIter;
+    orbit->cached = 0;
+    orbit->z = malloc(((size_t)maxIter + 1) * 2 * sizeof(double));
+    if (!orbit->z) {
+        return 0;
+    }
+    mp_number state[2];
+    mp_from_double(&state[0], 0, center[0].limbs);
+    state[1] = state[0];
+    orbit->length = reference_orbit_continue_mp(orbit->z, state, center, 0, maxIter);
+    return 1;
+}
+
+void reference_orbit_free(reference_orbit* orbit) {
+    if (!orbit->cached) {
+        free(orbit->z);
+    }
+    orbit->z = NULL;
+}
+
+void bla_table_build(bla_table* table, const reference_orbit* orbit, double maxDc) {
+    memset(table, 0, sizeof(*table));
+    // Z_0 = 0 makes the first step dz_1 = dc, which needs no table, so the runs start at m = 1 and level 0 holds
+    // the single steps m -> m + 1 for m = 1 .. length - 1
+    int count = orbit->length - 1;
+    if (count <= 0) {
+        return;
+    }
+    bla_step* steps = malloc(count * sizeof(bla_step));
+    for (int i = 0; i < count; ++i) {
+        const double* z = &orbit->z[2 * (i + 1)];
+        // dz^2 stays below BLA_EPSILON times 2 Z dz + dc
+        double size = hypot(z[0], z[1]);
+        steps[i] = (bla_step){{2 * z[0], 2 * z[1]}, {1, 0}, BLA_EPSILON * fmax(0, (size - maxDc) / (2 * size + 1))};
+    }
+    table->levels[0] = steps;
+    table->counts[0] = count;
+    table->levelCount = 1;
+
+    // a run of 2^(k + 1) is two runs of 2^k: x first, then y
+    while (table->levelCount < BLA_MAX_LEVELS && table->counts[table->levelCount - 1] >= 2) {
+        const bla_step* finer = table->levels[table->levelCount - 1];
+        int merged = table->counts[table->levelCount - 1] / 2;
+        bla_step* coarser = malloc(merged * sizeof(bla_step));
+        for (int i = 0; i < merged; ++i) {
+            const bla_step* x = &finer[2 * i];
+            const bla_step* y = &finer[2 * i + 1];
+            bla_step* step = &coarser[i];
+            step->a[0] = y->a[0] * x->a[0] - y->a[1] * x->a[1];
+            step->a[1] = y->a[0] * x->a[1] + y->a[1] * x->a[0];
+            step->b[0] = y->a[0] * x->b[0] - y->a[1] * x->b[1] + y->b[0];
+            step->b[1] = y->a[0] * x->b[1] + y->a[1] * x->b[0] + y->b[1];
+            // y needs |a_x dz + b_x dc| < radius_y
+            double throughX = (y->radius - hypot(x->b[0], x->b[1]) * maxDc) / hypot(x->a[0], x->a[1]);
+            step->radius = fmin(x->radius, fmax(0, throughX));
+        }
+        table->levels[table->levelCount] = coarser;
+        table->counts[table->levelCount] = merged;
+        ++table->levelCount;
+    }
+}
+
+void bla_table_free(bla_table* table) {
+    for (int k = 0; k < table->levelCount; ++k) {
+        free(table->levels[k]);
+    }
+    memset(table, 0, sizeof(*table));
+}
+
+// Longest run of at least two iterations starting at iteration n that admits dz, NULL if none does.
+// Runs of level k start where n - 1 is a multiple of 2^k, and a run's radius is at most that of its first half, so
+// the search climbs from level 1 until a run doesn't admit dz.
+static const bla_step* find_step(const bla_table* table, int n, double dzSquared, int* length) {
+    int top = n == 1 ? table->levelCount - 1 : __builtin_ctz(n - 1);
+    top = top < table->levelCount - 1 ? top : table->levelCount - 1;
+    const bla_step* found = NULL;
+    for (int k = 1; k <= top; ++k) {
+        int index = (n - 1) >> k;
+        if (index >= table->counts[k] || dzSquared >= table->levels[k][index].radius * table->levels[k][index].radius) {
+            break;
+        }
+        found = &table->levels[k][index];
+        *length = 1 << k;
+    }
+    return found;
+}
+
+typedef struct {
+    long long iterations;
+    long long skipped;
+    long long rebases;
+} pixel_counts;
+
+// Iteration of the pixel at dc from the reference. Without rebasing, *glitch is set to how close the pixel came to
+// 0 relative to the reference when the Pauldelbrot test caught it (1 if the reference escaped first), or 0.
+static int iterate_pixel(const reference_orbit* orbit, const bla_table* table, double dcX, double dcY, int rebase,
+                         pixel_counts* counts, float* glitch) {
+    const double* Z = orbit->z;
+    int maxIter = orbit->max_iter;
+    double dzX = 0, dzY = 0;
+    // n counts the pixel's iterations, m is where it is on the reference orbit
+    int n = 0, m = 0;
+    *glitch = 0;
+    while (n < maxIter) {
+        int length;
+        const bla_step* step = table && m > 0 ? find_step(table, m, dzX * dzX + dzY * dzY, &length) : NULL;
+        if (step && n + length <= maxIter) {
+            double x = step->a[0] * dzX - step->a[1] * dzY + step->b[0] * dcX - step->b[1] * dcY;
+            dzY = step->a[0] * dzY + step->a[1] * dzX + step->b[0] * dcY + step->b[1] * dcX;
+            dzX = x;
+            counts->skipped += length;
+        } else {
+            // dz' = (2 Z + dz) dz + dc
+            double sumX = 2 * Z[2 * m] + dzX, sumY = 2 * Z[2 * m + 1] + dzY;
+            double x = sumX * dzX - sumY * dzY + dcX;
+            dzY = sumX * dzY + sumY * dzX + dcY;
+            dzX = x;
+            length = 1;
+        }
+        n += length;
+        m += length;
+
+        double zX = Z[2 * m] + dzX, zY = Z[2 * m + 1] + dzY;
+        double zSquared = zX * zX + zY * zY;
+        if (zSquared >= 4.0) {
+            counts->iterations += n;
+            return n - 1;
+        }
+        if (rebase) {
+            // Rebasing: once the pixel comes closer to 0 than to the reference, or the reference escaped, carry on
+            // from the start of the reference with dz = z. Its delta stays small that way, so the perturbed steps
+            // stay accurate and the tables apply again.
+            if (zSquared < dzX * dzX + dzY * dzY || m == orbit->length) {
+                dzX = zX;
+                dzY = zY;
+                m = 0;
+                ++counts->rebases;
+            }
+            continue;
+        }
+        // Pauldelbrot's test: z much closer to 0 than Z means dz cancelled most of Z, and with it its precision
+        double referenceSquared = Z[2 * m] * Z[2 * m] + Z[2 * m + 1] * Z[2 * m + 1];
+        int referenceEscaped = m == orbit->length && n < maxIter;
+        if (zSquared < GLITCH_TOLERANCE * referenceSquared || referenceEscaped) {
+            *glitch = referenceEscaped ? 1 : (float)fmax(zSquared / referenceSquared, FLT_MIN);
+            counts->iterations += n;
+            return n - 1;
+        }
+    }
+    counts->iterations += maxIter;
+    return -1;
+}
+
+typedef struct {
+    const reference_orbit* orbit;
+    const bla_table* table;
+    int rebase;
+    // of the reference from the center of the view
+    double offset[2];
+    double pixel;
+    int width;
+    int height;
+    int* iterations;
+    float* glitches;
+    // pixels to render, all of them if NULL
+    const int* pixels;
+    int count;
+    int first;
+    int step;
+    pixel_counts counts;
+} deep_job;
+
+static void* render_deep_pixels(void* arg) {
+    deep_job* job = arg;
+    for (int k = job->first; k < job->count; k += job->step) {
+        int index = job->pixels ? job->pixels[k] : k;
+        double dcX = (index % job->width + 0.5 - job->width / 2.0) * job->pixel - job->offset[0];
+        double dcY = (index / job->width + 0.5 - job->height / 2.0) * job->pixel - job->offset[1];
+        job->iterations[index] = iterate_pixel(job->orbit, job->table, dcX, dcY, job->rebase, &job->counts,
+                                               &job->glitches[index]);
+    }
+    return NULL;
+}
+
+// Points of the plane to the precision the references are iterated with: orbit_keys, double-double when limbs is 0.
+
+static int compute_reference(reference_orbit* orbit, const orbit_key* point, int maxIter,
+                             const deep_options* options) {
+    if (point->limbs == 0) {
+        return options->cache ? orbit_cache_get(options->cache, orbit, point->center.dd, maxIter)
+                              : reference_orbit_compute(orbit, point->center.dd, maxIter);
+    }
+    return options->cache ? orbit_cache_get_mp(options->cache, orbit, point->center.mp, maxIter)
+                          : reference_orbit_compute_mp(orbit, point->center.mp, maxIter);
+}
+
+// point - center, rounded to double
+static double point_offset(const orbit_key* point, const orbit_key* center, int axis) {
+    if (point->limbs == 0) {
+        return dd_to_double(dd_sub(point->center.dd[axis], center->center.dd[axis]));
+    }
+    mp_number difference;
+    mp_sub(&difference, &point->center.mp[axis], &center->center.mp[axis]);
+    return mp_to_double(&difference);
+}
+
+// center + (x, y)
+static void offset_point(orbit_key* point, const orbit_key* center, double x, double y) {
+    *point = *center;
+    if (center->limbs == 0) {
+        point->center.dd[0] = dd_add_double(center->center.dd[0], x);
+        point->center.dd[1] = dd_add_double(center->center.dd[1], y);
+        return;
+    }
+    mp_number offset;
+    mp_from_double(&offset, x, center->limbs);
+    mp_add(&point->center.mp[0], &center->center.mp[0], &offset);
+    mp_from_double(&offset, y, center->limbs);
+    mp_add(&point->center.mp[1], &center->center.mp[1], &offset);
+}
+
+// Renders the given pixels (all if NULL) against a reference at offset from the center of the view.
+static int render_with_reference(const fractal_params* params, const deep_view* view, const orbit_key* center,
+                                 const orbit_key* reference, int width, int height, const int* pixels, int count,
+                                 int* iterations, float* glitches, int threads, const deep_options* options,
+                                 deep_stats* stats) {
+    double start = milliseconds();
+    double offset[2] = {point_offset(reference, center, 0), point_offset(reference, center, 1)};
+    reference_orbit orbit;
+    int computed = compute_reference(&orbit, reference, params->max_iter, options);
+    if (!computed) {
+        fprintf(stderr, "No memory for a reference orbit of %d iterations\n", params->max_iter);
+        return 0;
+    }
+    double referenced = milliseconds();
+    stats->referenceMilliseconds += referenced - start;
+
+    double pixel = view->width / width;
+    bla_table table;
+    if (options->use_bla) {
+        // the reference may be anywhere in the image
+        double maxDc = hypot(width, height) / 2 * pixel + hypot(offset[0], offset[1]);
+        bla_table_build(&table, &orbit, maxDc);
+    }
+    double built = milliseconds();
+    stats->blaMilliseconds += built - referenced;
+
+    threads = threads > 0 ? threads : 1;
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    deep_job* jobs = malloc(threads * sizeof(deep_job));
+    for (int t = 0; t < threads; ++t) {
+        jobs[t] = (deep_job){&orbit,   options->use_bla ? &table : NULL, options->rebase, {offset[0], offset[1]},
+                             pixel,    width, height, iterations, glitches, pixels, count, t, threads, {0}};
+        pthread_create(&workers[t], NULL, render_deep_pixels, &jobs[t]);
+    }
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(workers[t], NULL);
+        stats->iterations += jobs[t].counts.iterations;
+        stats->skippedIterations += jobs[t].counts.skipped;
+        stats->rebases += jobs[t].counts.rebases;
+    }
+    stats->pixelMilliseconds += milliseconds() - built;
+    ++stats->references;
+
+    free(jobs);
+    free(workers);
+    if (options->use_bla) {
+        bla_table_free(&table);
+    }
+    reference_orbit_free(&orbit);
+    return 1;
+}
+
+void deep_options_default(deep_options* options) {
+    options->use_bla = 1;
+    options->rebase = 1;
+    options->max_references = DEEP_DEFAULT_MAX_REFERENCES;
+    options->cache = NULL;
+    options->find_reference = 1;
+}
+
+int deep_view_parse_center(deep_view* view, const char* x, const char* y) {
+    return mp_parse(x, &view->center[0], MP_MAX_LIMBS) == (int)strlen(x) &&
+           mp_parse(y, &view->center[1], MP_MAX_LIMBS) == (int)strlen(y);
+}
+
+int deep_view_limbs(const deep_view* view, int width) {
+    double magnitude = fmax(fmax(fabs(mp_to_double(&view->center[0])), fabs(mp_to_double(&view->center[1]))), 1);
+    // bits to address a single pixel, with the guard bits of precision_tier_for_view
+    int bits = (int)ceil(log2(magnitude / (view->width / width))) + DEEP_GUARD_BITS;
+    return bits <= DOUBLE_DOUBLE_BITS ? 0 : mp_limbs_for_bits(bits);
+}
+
+int deep_render_iterations(const fractal_params* params, const deep_view* view, int width, int height,
+                           int* iterations, int threads, const deep_options* options, deep_stats* stats) {
+    if (params->formula != FORMULA_MANDELBROT) {
+        fprintf(stderr, "Deep zoom only supports %s\n", formula_get(FORMULA_MANDELBROT)->name);
+        return 0;
+    }
+    double pixel = view->width / width;
+    if (pixel < DEEP_MIN_PIXEL) {
+        fprintf(stderr, "Pixels of %g are beyond the deep engine, the smallest it renders are %g\n", pixel,
+                DEEP_MIN_PIXEL);
+        return 0;
+    }
+    deep_stats local;
+    stats = stats ? stats : &local;
+    memset(stats, 0, sizeof(*stats));
+
+    // the center to the precision the pixels need, double-double as long as that does
+    orbit_key center, reference;
+    memset(&center, 0, sizeof(center));
+    center.limbs = deep_view_limbs(view, width);
+    for (int i = 0; i < 2; ++i) {
+        if (center.limbs == 0) {
+            center.center.dd[i] = mp_to_double_double(&view->center[i]);
+        } else {
+            mp_set_limbs(&center.center.mp[i], &view->center[i], center.limbs);
+        }
+    }
+    stats->referenceLimbs = center.limbs;
+
+    int count = width * height;
+    float* glitches = malloc(count * sizeof(float));
+    int* glitched = malloc(count * sizeof(int));
+    reference = center;
+    if (options->find_reference && center.limbs == 0) {
+        double start = milliseconds();
+        periodic_point point;
+        if (periodic_point_find(center.center.dd, view->width, height * pixel, params->max_iter, &point)) {
+            reference.center.dd[0] = point.c[0];
+            reference.center.dd[1] = point.c[1];
+            stats->referencePreperiod = point.preperiod;
+            stats->referencePeriod = point.period;
+        }
+        stats->referenceMilliseconds += milliseconds() - start;
+    }
+    int result = render_with_reference(params, view, &center, &reference, width, height, NULL, count, iterations,
+                                       glitches, threads, options, stats);
+    // Each further reference goes where the glitched pixels came closest to 0, which is where a glitched region
+    // has its center, and only renders the pixels still glitched.
+    while (result) {
+        int glitchedCount = 0, worst = -1;
+        for (int i = 0; i < count; ++i) {
+            if (glitches[i] > 0) {
+                glitched[glitchedCount++] = i;
+                worst = worst < 0 || glitches[i] < glitches[worst] ? i : worst;
+            }
+        }
+        if (stats->references == 1) {
+            stats->glitchedPixels = glitchedCount;
+        }
+        stats->remainingGlitches = glitchedCount;
+        if (glitchedCount == 0 || stats->references >= options->max_references) {
+            break;
+        }
+        offset_point(&reference, &center, (worst % width + 0.5 - width / 2.0) * pixel,
+                     (worst / width + 0.5 - height / 2.0) * pixel);
+        result = render_with_reference(params, view, &center, &reference, width, height, glitched, glitchedCount,
+                                       iterations, glitches, threads, options, stats);
+    }
+    free(glitched);
+    free(glitches);
+    return result;
+}
@@ -0,0 +1,138 @@
+#ifndef DEEP_ENGINE_H
+#define DEEP_ENGINE_H
+
+#include "double_double.h"
+#include "fractal.h"
+#include "multiprecision.h"
+
+// Deep zoom renderer for the Mandelbrot set, for views far beyond double precision.
+//
+// One reference orbit Z_n is computed at the center of the view, in double-double, or with as many limbs of
+// multiprecision (see multiprecision.h) as the pixels need where double-double can't tell them apart. Every pixel
+// only iterates its
+// difference dz_n to it in double (perturbation): with c = C + dc,
+//   dz_{n+1} = 2 Z_n dz_n + dz_n^2 + dc
+// which stays accurate because dz and dc are small, not because the arithmetic is wide.
+//
+// While dz is small enough that dz^2 vanishes next to 2 Z dz, steps are linear in dz and dc, and so is any run of
+// them: dz_{m+l} = A dz_m + B dc. Bilinear approximation (BLA) tables hold A, B and the radius of dz within which
+// that holds for runs of 2^k iterations, so a pixel can skip thousands of iterations in one step. A pixel takes the
+// longest run whose radius admits its dz and falls back to single perturbed steps where none does.
+//
+// The first reference goes to the nucleus of the lowest period in the view, or to a Misiurewicz point (see
+// nucleus.h), whose orbit never escapes, rather than to the center, whose orbit may escape long before the pixels do.
+// Those are found in double-double, views beyond it start at the center.
+//
+// Pixels are rebased (Zhuoran's method): whenever z gets closer to 0 than to the reference, and when the reference
+// escapes, the pixel carries on from Z_0 = 0 with dz = z. That keeps dz small, so the tables apply again and a
+// single reference serves every pixel, including those that outlive it.
+//
+// Without rebasing, pixels whose delta cancels most of the reference lose their precision. Those glitches are caught
+// with Pauldelbrot's test, |z|^2 < GLITCH_TOLERANCE |Z|^2, and rendered again against a secondary reference placed
+// in the glitched region, until none are left or max_references is reached.
+//
+// Images are laid out like cpu_render_iterations, with the same iteration counts.
+
+// Relative size of the neglected dz^2 term, the radii scale with it. Smaller values skip fewer iterations, this one
+// (the one Fraktaler 3 uses) keeps the error well below what tells pixels apart.
+#define BLA_EPSILON 0x1p-24
+#define BLA_MAX_LEVELS 32
+#define GLITCH_TOLERANCE 1e-6
+#define DEEP_DEFAULT_MAX_REFERENCES 32
+// Pixels iterate their deltas in double, which runs out of exponent (and then of precision) below this pixel size.
+// Narrower views are refused rather than rendered as noise.
+#define DEEP_MIN_PIXEL 1e-290
+
+// Rectangle of the plane around a center given to the full precision, MP_MAX_LIMBS limbs of it. width is the extent
+// of the image's width, pixels are square.
+typedef struct {
+    mp_number center[2];
+    double width;
+} deep_view;
+
+typedef struct {
+    double_double center[2];
+    int max_iter;
+    // Z_0 .. Z_length, rounded to double, x and y interleaved
+    double* z;
+    // the iteration at which the reference escaped, max_iter if it didn't
+    int length;
+    // z belongs to an orbit_cache
+    int cached;
+} reference_orbit;
+
+// dz_{m + 2^level} = a dz_m + b dc for |dz_m| < radius, m = 1 + index * 2^level
+typedef struct {
+    double a[2];
+    double b[2];
+    double radius;
+} bla_step;
+
+typedef struct {
+    bla_step* levels[BLA_MAX_LEVELS];
+    int counts[BLA_MAX_LEVELS];
+    int levelCount;
+} bla_table;
+
+typedef struct {
+    int use_bla;
+    // rebase pixels onto the start of the reference, otherwise detect glitches and fix them with more references
+    int rebase;
+    int max_references;
+    // reference orbits come from there if not NULL, see orbit_cache.h
+    struct orbit_cache* cache;
+    // place the first reference at a nucleus or Misiurewicz point in the view, at its center otherwise
+    int find_reference;
+} deep_options;
+
+typedef struct {
+    double referenceMilliseconds;
+    double blaMilliseconds;
+    double pixelMilliseconds;
+    // iterations of all pixels, and how many of them were skipped by the BLA tables
+    long long iterations;
+    long long skippedIterations;
+    // times a pixel restarted at the beginning of the reference orbit
+    long long rebases;
+    int references;
+    // glitched pixels found with the first reference, and those still glitched with the last one
+    long long glitchedPixels;
+    long long remainingGlitches;
+    // of the point the first reference was placed at, 0 for the center of the view
+    int referencePreperiod;
+    int referencePeriod;
+    // limbs the references were iterated with, 0 for double-double
+    int referenceLimbs;
+} deep_stats;
+
+// Returns 0 if out of memory.
+int reference_orbit_compute(reference_orbit* orbit, const double_double center[2], int maxIter);
+// The same for centers beyond double-double, to their precision. Z_n are still rounded to double, the center to
+// double-double.
+int reference_orbit_compute_mp(reference_orbit* orbit, const mp_number center[2], int maxIter);
+// Carry on an orbit from Z_from, which state holds, writing Z_from .. Z_n to z until Z_n escapes or n is maxIter.
+// Returns n, state holds Z_n then.
+int reference_orbit_continue(double* z, double_double state[2], const double_double center[2], int from, int maxIter);
+int reference_orbit_continue_mp(double* z, mp_number state[2], const mp_number center[2], int from, int maxIter);
+double_double mp_to_double_double(const mp_number* a);
+void mp_from_double_double(mp_number* result, double_double value, int limbs);
+void reference_orbit_free(reference_orbit* orbit);
+
+// maxDc bounds |dc| over the image, the radii shrink with it.
+void bla_table_build(bla_table* table, const reference_orbit* orbit, double maxDc);
+void bla_table_free(bla_table* table);
+
+// Rebasing with BLA tables, up to DEEP_DEFAULT_MAX_REFERENCES references, the first one at a nucleus.
+void deep_options_default(deep_options* options);
+
+// Parses the decimal coordinates of the center, to the full precision. Returns 0 if either isn't a number.
+int deep_view_parse_center(deep_view* view, const char* x, const char* y);
+// Limbs the reference orbits of the view need at width pixels across, 0 if double-double tells its pixels apart.
+int deep_view_limbs(const deep_view* view, int width);
+
+// Only the Mandelbrot formula has a deep version, returns 0 (after printing so) for the others, and for pixels
+// smaller than DEEP_MIN_PIXEL. stats may be NULL.
+int deep_render_iterations(const fractal_params* params, const deep_view* view, int width, int height,
+                           int* iterations, int threads, const deep_options* options, deep_stats* stats);
+
+#endif
@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "deep_engine.h"
+#include "fractal.h"
+#include "nucleus.h"
+#include "orbit_cache.h"
+#include "png.h"
+
+// Renders one deep zoom view (see deep_engine.h) to a PNG and prints where the time went. The center takes as many
+// digits as the zoom needs, --no-bla shows what the approximation tables save and --no-rebase how many glitches a
+// single reference leaves. With --frames it renders a zoom into the center, frame by frame, which all share the
+// reference orbit at the center: with --orbit-cache it is computed once, and not at all on later runs. --auto-zoom
+// moves the center to the nucleus of the lowest period in the first view (see nucleus.h) and zooms into its minibrot.
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT.png --center X Y --width W [options]\n"
+           "  OUTPUT.png              with --frames a pattern like frame_%%04d.png\n"
+           "  --center X Y            center of the image, to as many digits as needed\n"
+           "  --width W               extent of the image's width in the plane\n"
+           "  --size WIDTH HEIGHT     image size in pixels (default 1024 768)\n"
+           "  --max-iter N            iteration limit (default 1000)\n"
+           "  --threads N             (default: all cores)\n"
+           "  --no-bla                iterate every pixel step by step\n"
+           "  --no-rebase             fix glitches with more references instead of rebasing\n"
+           "  --max-references N      references to fix glitches with, the first included (default %d)\n"
+           "  --frames N              zoom in over N frames, the first one W wide (default 1)\n"
+           "  --zoom F                width of each frame over that of the one before (default 0.5)\n"
+           "  --orbit-cache DIR       keep reference orbits there\n"
+           "  --no-nucleus            place the first reference at the center, not at a nucleus in the view\n"
+           "  --auto-zoom             center on the lowest period nucleus in the first view\n",
+           program, DEEP_DEFAULT_MAX_REFERENCES);
+}
+
+int writeImage(const char* path, const int* iterations, int width, int height) {
+    size_t pixels = (size_t)width * height;
+    unsigned char* rgb = malloc(pixels * 3);
+    unsigned char* flipped = malloc(pixels * 3);
+    colorize_iterations(iterations, pixels, rgb);
+    for (int j = 0; j < height; ++j) {
+        memcpy(flipped + (size_t)j * width * 3, rgb + (size_t)(height - 1 - j) * width * 3, (size_t)width * 3);
+    }
+    size_t size;
+    unsigned char* png = png_encode_rgb(flipped, width, height, &size);
+    FILE* output = fopen(path, "wb");
+    int result = output && fwrite(png, 1, size, output) == size ? 0 : -1;
+    if (output) {
+        fclose(output);
+    }
+    if (result != 0) {
+        printf("Couldn't write %s\n", path);
+    }
+    free(png);
+    free(flipped);
+    free(rgb);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    int width = 1024, height = 768;
+    int threads = cpu_thread_count();
+    deep_options options;
+    deep_options_default(&options);
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+    deep_view view;
+    deep_view_parse_center(&view, "0", "0");
+    view.width = 0;
+    int frames = 1;
+    double zoom = 0.5;
+    const char* cacheDirectory = NULL;
+    int autoZoom = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--center") == 0 && rest >= 2) {
+            if (!deep_view_parse_center(&view, argv[i + 1], argv[i + 2])) {
+                printUsage(argv[0]);
+                return -1;
+            }
+            i += 2;
+        } else if (strcmp(argv[i], "--width") == 0 && rest >= 1) {
+            view.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--no-bla") == 0) {
+            options.use_bla = 0;
+        } else if (strcmp(argv[i], "--no-rebase") == 0) {
+            options.rebase = 0;
+        } else if (strcmp(argv[i], "--max-references") == 0 && rest >= 1) {
+            options.max_references = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && rest >= 1) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--zoom") == 0 && rest >= 1) {
+            zoom = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--orbit-cache") == 0 && rest >= 1) {
+            cacheDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--no-nucleus") == 0) {
+            options.find_reference = 0;
+        } else if (strcmp(argv[i], "--auto-zoom") == 0) {
+            autoZoom = 1;
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (width <= 0 || height <= 0 || view.width <= 0 || params.max_iter <= 0 || options.max_references <= 0 ||
+        frames <= 0 || zoom <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    if (autoZoom) {
+        if (deep_view_limbs(&view, width) > 0) {
+            printf("Nuclei are found in double-double, which can't tell the pixels of this view apart\n");
+            return -1;
+        }
+        double_double center[2] = {mp_to_double_double(&view.center[0]), mp_to_double_double(&view.center[1])};
+        periodic_point point;
+        if (!periodic_point_find(center, view.width, view.width * height / width, params.max_iter, &point)) {
+            printf("No nucleus or Misiurewicz point up to period %d in the view\n", params.max_iter);
+            return -1;
+        }
+        mp_from_double_double(&view.center[0], point.c[0], MP_MAX_LIMBS);
+        mp_from_double_double(&view.center[1], point.c[1], MP_MAX_LIMBS);
+        char x[64], y[64];
+        dd_format(point.c[0], x, sizeof(x));
+        dd_format(point.c[1], y, sizeof(y));
+        if (point.preperiod == 0) {
+            printf("zooming into the period %d nucleus at %s %s, minibrot size %.3g\n", point.period, x, y,
+                   point.size);
+        } else {
+            printf("zooming into the Misiurewicz point of preperiod %d, period %d at %s %s\n", point.preperiod,
+                   point.period, x, y);
+        }
+    }
+
+    if (cacheDirectory && !(options.cache = orbit_cache_open(cacheDirectory))) {
+        return -1;
+    }
+
+    size_t pixels = (size_t)width * height;
+    int* iterations = malloc(pixels * sizeof(int));
+    int result = 0;
+    for (int frame = 0; frame < frames && result == 0; ++frame, view.width *= zoom) {
+        deep_stats stats;
+        if (!deep_render_iterations(&params, &view, width, height, iterations, threads, &options, &stats)) {
+            result = -1;
+            break;
+        }
+        char path[4096];
+        snprintf(path, sizeof(path), "%s", outputPath);
+        if (frames > 1) {
+            snprintf(path, sizeof(path), outputPath, frame);
+            printf("%s, width %g\n", path, view.width);
+        }
+        printf("reference %.1f ms, bla %.1f ms, pixels %.1f ms\n", stats.referenceMilliseconds, stats.blaMilliseconds,
+               stats.pixelMilliseconds);
+        printf("%lld iterations, %.1f%% skipped, %lld rebases\n", stats.iterations,
+               stats.iterations ? 100.0 * stats.skippedIterations / stats.iterations : 0, stats.rebases);
+        printf("%d references, %lld glitched pixels, %lld left glitched\n", stats.references, stats.glitchedPixels,
+               stats.remainingGlitches);
+        if (stats.referenceLimbs > 0) {
+            printf("references iterated with %d limbs\n", stats.referenceLimbs);
+        }
+        if (stats.referencePeriod > 0) {
+            printf("first reference at a point of preperiod %d, period %d\n", stats.referencePreperiod,
+                   stats.referencePeriod);
+        }
+        result = writeImage(path, iterations, width, height);
+    }
+    if (options.cache) {
+        orbit_cache_stats cacheStats = orbit_cache_get_stats(options.cache);
+        printf("orbit cache: %ld hits, %ld extended, %ld computed\n", cacheStats.hits, cacheStats.extended,
+               cacheStats.computed);
+        orbit_cache_close(options.cache);
+    }
+    free(iterations);
+    return result;
+}
@@ -0,0 +1,168 @@
+#ifndef DOUBLE_DOUBLE_H
+#define DOUBLE_DOUBLE_H
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Double-double arithmetic: a number is the unevaluated sum hi + lo of two doubles with |lo| <= ulp(hi) / 2, which
+// gives 106 bits of mantissa with the exponent range of a double. Enough to address the pixels of views down to a
+// width of about 1e-28, for reference orbits and the coordinates of deep views.
+// The error free transformations are Knuth's two-sum and the fma based two-product.
+
+typedef struct {
+    double hi;
+    double lo;
+} double_double;
+
+static inline double_double dd_from_double(double a) {
+    return (double_double){a, 0};
+}
+
+static inline double dd_to_double(double_double a) {
+    return a.hi + a.lo;
+}
+
+// a + b exactly, for |a| >= |b|
+static inline double_double dd_quick_two_sum(double a, double b) {
+    double sum = a + b;
+    return (double_double){sum, b - (sum - a)};
+}
+
+static inline double_double dd_two_sum(double a, double b) {
+    double sum = a + b;
+    double bPart = sum - a;
+    return (double_double){sum, (a - (sum - bPart)) + (b - bPart)};
+}
+
+static inline double_double dd_two_product(double a, double b) {
+    double product = a * b;
+    return (double_double){product, fma(a, b, -product)};
+}
+
+static inline double_double dd_negate(double_double a) {
+    return (double_double){-a.hi, -a.lo};
+}
+
+static inline double_double dd_add(double_double a, double_double b) {
+    double_double high = dd_two_sum(a.hi, b.hi);
+    double_double low = dd_two_sum(a.lo, b.lo);
+    high.lo += low.hi;
+    high = dd_quick_two_sum(high.hi, high.lo);
+    high.lo += low.lo;
+    return dd_quick_two_sum(high.hi, high.lo);
+}
+
+static inline double_double dd_sub(double_double a, double_double b) {
+    return dd_add(a, dd_negate(b));
+}
+
+static inline double_double dd_add_double(double_double a, double b) {
+    double_double sum = dd_two_sum(a.hi, b);
+    sum.lo += a.lo;
+    return dd_quick_two_sum(sum.hi, sum.lo);
+}
+
+static inline double_double dd_mul(double_double a, double_double b) {
+    double_double product = dd_two_product(a.hi, b.hi);
+    product.lo += a.hi * b.lo + a.lo * b.hi;
+    return dd_quick_two_sum(product.hi, product.lo);
+}
+
+static inline double_double dd_mul_double(double_double a, double b) {
+    double_double product = dd_two_product(a.hi, b);
+    product.lo += a.lo * b;
+    return dd_quick_two_sum(product.hi, product.lo);
+}
+
+// one product less than dd_mul(a, a)
+static inline double_double dd_square(double_double a) {
+    double_double product = dd_two_product(a.hi, a.hi);
+    product.lo += 2 * a.hi * a.lo;
+    return dd_quick_two_sum(product.hi, product.lo);
+}
+
+// long division, one double digit at a time
+static inline double_double dd_div(double_double a, double_double b) {
+    double first = a.hi / b.hi;
+    double_double rest = dd_sub(a, dd_mul_double(b, first));
+    double second = rest.hi / b.hi;
+    rest = dd_sub(rest, dd_mul_double(b, second));
+    double third = rest.hi / b.hi;
+    return dd_add_double(dd_quick_two_sum(first, second), third);
+}
+
+// Parses a decimal number like -1.7499999999999999999999999997e-1 to the full precision. Returns the number of
+// characters read, 0 if text doesn't start with a number.
+static inline int dd_parse(const char* text, double_double* value) {
+    const char* at = text;
+    int negative = *at == '-';
+    if (*at == '-' || *at == '+') {
+        ++at;
+    }
+    double_double result = {0, 0};
+    int digits = 0, exponent = 0, seenPoint = 0;
+    for (; isdigit((unsigned char)*at) || (*at == '.' && !seenPoint); ++at) {
+        if (*at == '.') {
+            seenPoint = 1;
+            continue;
+        }
+        result = dd_add_double(dd_mul_double(result, 10), *at - '0');
+        exponent -= seenPoint;
+        ++digits;
+    }
+    if (digits == 0) {
+        return 0;
+    }
+    if (*at == 'e' || *at == 'E') {
+        int read = 0, written = 0;
+        if (sscanf(at + 1, "%d%n", &written, &read) == 1) {
+            exponent += written;
+            at += 1 + read;
+        }
+    }
+    double_double scale = {1, 0};
+    for (int i = 0; i < abs(exponent); ++i) {
+        scale = dd_mul_double(scale, 10);
+    }
+    result = exponent < 0 ? dd_div(result, scale) : dd_mul(result, scale);
+    *value = negative ? dd_negate(result) : result;
+    return (int)(at - text);
+}
+
+// Formats a to 32 significant digits, like -1.7548776662466927600495088963585e+00, which parses back to a.
+static inline void dd_format(double_double a, char* text, size_t size) {
+    if (a.hi == 0 || !isfinite(a.hi)) {
+        snprintf(text, size, "%.17g", a.hi);
+        return;
+    }
+    int negative = a.hi < 0;
+    a = negative ? dd_negate(a) : a;
+    int exponent = (int)floor(log10(a.hi));
+    double_double scale = {1, 0};
+    for (int i = 0; i < abs(exponent); ++i) {
+        scale = dd_mul_double(scale, 10);
+    }
+    a = exponent < 0 ? dd_mul(a, scale) : dd_div(a, scale);
+    // log10 rounds either way next to powers of 10
+    if (a.hi >= 10) {
+        a = dd_div(a, (double_double){10, 0});
+        ++exponent;
+    } else if (a.hi < 1) {
+        a = dd_mul_double(a, 10);
+        --exponent;
+    }
+    char digits[33];
+    for (int i = 0; i < 32; ++i) {
+        int digit = (int)floor(a.hi);
+        digit -= dd_add_double(a, -digit).hi < 0;
+        digit = digit < 0 ? 0 : digit > 9 ? 9 : digit;
+        digits[i] = (char)('0' + digit);
+        a = dd_mul_double(dd_add_double(a, -digit), 10);
+    }
+    digits[32] = '\0';
+    snprintf(text, size, "%s%c.%se%+03d", negative ? "-" : "", digits[0], digits + 1, exponent);
+}
+
+#endif
@@ -0,0 +1,225 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "png.h"
+#include "raw_dump.h"
+
+// Statistics and pictures of a raw dump written by dump_render, straight from the mapping: nothing is rendered and
+// no plane is copied, so it works on dumps many times the size of memory. The picture is colored a row of a tile at
+// a time and averaged into blocks of --scale pixels on the way, so only the (scaled down) image is ever held.
+//
+// --coloring picks the planes the picture is colored by:
+//   escape    the escape iteration, in the viewer's bands
+//   smooth    escape iteration plus the smooth fraction, the viewer's palette blended between the bands
+//   distance  the distance estimate in pixels, dark at the boundary and light away from it
+// Pixels without a value (interior ones, and escaped ones of formulas that have no distance estimate) are black.
+
+// distance in pixels over which the distance coloring goes from black to nearly white
+#define DISTANCE_FALLOFF_PIXELS 4.0
+
+typedef enum { PICTURE_ESCAPE, PICTURE_SMOOTH, PICTURE_DISTANCE, PICTURE_COUNT } picture_coloring;
+
+static const char* PICTURE_COLORINGS[PICTURE_COUNT] = {"escape", "smooth", "distance"};
+static const unsigned PICTURE_FIELDS[PICTURE_COUNT] = {RAW_FIELD_ESCAPE, RAW_FIELD_ESCAPE | RAW_FIELD_SMOOTH,
+                                                       RAW_FIELD_DISTANCE};
+
+void printUsage(const char* program) {
+    printf("usage: %s DUMP [--png OUTPUT] [--scale N] [--coloring NAME]\n"
+           "  --png OUTPUT      write a picture of the dump\n"
+           "  --scale N         average blocks of N by N pixels into one, for thumbnails (default 1)\n"
+           "  --coloring NAME   escape, smooth or distance (default escape)\n",
+           program);
+}
+
+void printStatistics(const raw_dump* dump) {
+    const raw_dump_header* header = raw_dump_get_header(dump);
+    long long escaped = 0, interior = 0, total = 0;
+    int minEscape = header->max_iter, maxEscape = 0;
+    double distanceMin = INFINITY, distanceMax = 0;
+    for (int ty = 0; ty < raw_dump_tiles_y(dump); ++ty) {
+        for (int tx = 0; tx < raw_dump_tiles_x(dump); ++tx) {
+            raw_tile tile = raw_dump_get_tile(dump, tx, ty);
+            int rows = header->height - ty * RAW_DUMP_TILE < RAW_DUMP_TILE ? header->height - ty * RAW_DUMP_TILE
+                                                                          : RAW_DUMP_TILE;
+            int columns = header->width - tx * RAW_DUMP_TILE < RAW_DUMP_TILE ? header->width - tx * RAW_DUMP_TILE
+                                                                            : RAW_DUMP_TILE;
+            for (int y = 0; y < rows; ++y) {
+                for (int x = 0; x < columns; ++x) {
+                    int i = y * RAW_DUMP_TILE + x;
+                    if (tile.escape[i] < 0) {
+                        ++interior;
+                        continue;
+                    }
+                    ++escaped;
+                    total += tile.escape[i];
+                    minEscape = tile.escape[i] < minEscape ? tile.escape[i] : minEscape;
+                    maxEscape = tile.escape[i] > maxEscape ? tile.escape[i] : maxEscape;
+                    if ((header->fields & RAW_FIELD_DISTANCE) && isfinite(tile.distance[i])) {
+                        distanceMin = fmin(distanceMin, tile.distance[i]);
+                        distanceMax = fmax(distanceMax, tile.distance[i]);
+                    }
+                }
+            }
+        }
+    }
+    long long pixels = (long long)header->width * header->height;
+    printf("%s, power %d, %d iterations, rendered by the %s engine\n", formula_get(header->formula)->name,
+           header->power, header->max_iter, header->engine);
+    printf("center %s %s, width %g\n", header->center[0], header->center[1], header->view_width);
+    printf("%ux%u pixels in %dx%d tiles of %d, planes:%s%s%s%s\n", header->width, header->height,
+           raw_dump_tiles_x(dump), raw_dump_tiles_y(dump), RAW_DUMP_TILE,
+           header->fields & RAW_FIELD_ESCAPE ? " escape" : "", header->fields & RAW_FIELD_SMOOTH ? " smooth" : "",
+           header->fields & RAW_FIELD_DISTANCE ? " distance" : "", header->fields & RAW_FIELD_Z ? " z" : "");
+    printf("escaped %lld (%.2f%%), interior %lld (%.2f%%)\n", escaped, 100.0 * escaped / pixels, interior,
+           100.0 * interior / pixels);
+    if (escaped > 0) {
+        printf("escape iteration min %d, max %d, mean %.2f\n", minEscape, maxEscape, (double)total / escaped);
+    }
+    if (distanceMin <= distanceMax) {
+        printf("distance estimate min %g, max %g (%g to %g pixels)\n", distanceMin, distanceMax,
+               distanceMin * header->width / header->view_width, distanceMax * header->width / header->view_width);
+    }
+}
+
+// PICTURE_COUNT if there is no such coloring.
+static picture_coloring pictureColoringByName(const char* name) {
+    for (int i = 0; i < PICTURE_COUNT; ++i) {
+        if (strcmp(PICTURE_COLORINGS[i], name) == 0) {
+            return i;
+        }
+    }
+    return PICTURE_COUNT;
+}
+
+// Colors the first columns pixels of row y of tile into rgb; lower and upper are scratch space of RAW_DUMP_TILE.
+static void colorRow(const raw_dump_header* header, raw_tile tile, int y, int columns, picture_coloring coloring,
+                     int* lower, int* upper, unsigned char* rgb) {
+    const int32_t* escape = tile.escape + y * RAW_DUMP_TILE;
+    if (coloring == PICTURE_ESCAPE) {
+        colorize_iterations(escape, columns, rgb);
+    } else if (coloring == PICTURE_SMOOTH) {
+        // the bands of the escape iteration and the next one, blended by the fraction
+        unsigned char next[RAW_DUMP_TILE * 3];
+        for (int x = 0; x < columns; ++x) {
+            lower[x] = escape[x];
+            upper[x] = escape[x] < 0 ? -1 : escape[x] + 1;
+        }
+        colorize_iterations(lower, columns, rgb);
+        colorize_iterations(upper, columns, next);
+        const float* smooth = tile.smooth + y * RAW_DUMP_TILE;
+        for (int x = 0; x < columns; ++x) {
+            double fraction = isnan(smooth[x]) ? 0 : smooth[x];
+            for (int c = 0; c < 3; ++c) {
+                rgb[x * 3 + c] = (unsigned char)(rgb[x * 3 + c] * (1 - fraction) + next[x * 3 + c] * fraction + 0.5);
+            }
+        }
+    } else {
+        const float* distance = tile.distance + y * RAW_DUMP_TILE;
+        double pixelsPerUnit = header->width / header->view_width;
+        for (int x = 0; x < columns; ++x) {
+            double value = 0;
+            if (isfinite(distance[x])) {
+                value = 1 - exp(-distance[x] * pixelsPerUnit / DISTANCE_FALLOFF_PIXELS);
+            }
+            rgb[x * 3] = rgb[x * 3 + 1] = rgb[x * 3 + 2] = (unsigned char)(255 * value + 0.5);
+        }
+    }
+}
+
+int writePicture(const raw_dump* dump, const char* path, int scale, picture_coloring coloring) {
+    const raw_dump_header* header = raw_dump_get_header(dump);
+    if ((header->fields & PICTURE_FIELDS[coloring]) != PICTURE_FIELDS[coloring]) {
+        printf("The %s engine's dump has no planes for the %s coloring\n", header->engine,
+               PICTURE_COLORINGS[coloring]);
+        return 0;
+    }
+    int width = (header->width + scale - 1) / scale;
+    int height = (header->height + scale - 1) / scale;
+    // color sums and pixel counts of the blocks, rows from the top for the PNG
+    unsigned int* sums = calloc((size_t)width * height * 4, sizeof(unsigned int));
+    unsigned char rgb[RAW_DUMP_TILE * 3];
+    int lower[RAW_DUMP_TILE], upper[RAW_DUMP_TILE];
+    for (int ty = 0; ty < raw_dump_tiles_y(dump); ++ty) {
+        for (int tx = 0; tx < raw_dump_tiles_x(dump); ++tx) {
+            raw_tile tile = raw_dump_get_tile(dump, tx, ty);
+            for (int y = 0; y < RAW_DUMP_TILE && ty * RAW_DUMP_TILE + y < (int)header->height; ++y) {
+                int columns = header->width - tx * RAW_DUMP_TILE < RAW_DUMP_TILE ? header->width - tx * RAW_DUMP_TILE
+                                                                                : RAW_DUMP_TILE;
+                colorRow(header, tile, y, columns, coloring, lower, upper, rgb);
+                unsigned int* row = sums + (size_t)(height - 1 - (ty * RAW_DUMP_TILE + y) / scale) * width * 4;
+                for (int x = 0; x < columns; ++x) {
+                    unsigned int* block = row + (tx * RAW_DUMP_TILE + x) / scale * 4;
+                    block[0] += rgb[x * 3];
+                    block[1] += rgb[x * 3 + 1];
+                    block[2] += rgb[x * 3 + 2];
+                    ++block[3];
+                }
+            }
+        }
+    }
+    unsigned char* picture = malloc((size_t)width * height * 3);
+    for (size_t i = 0; i < (size_t)width * height; ++i) {
+        for (int c = 0; c < 3; ++c) {
+            picture[i * 3 + c] = (sums[i * 4 + c] + sums[i * 4 + 3] / 2) / sums[i * 4 + 3];
+        }
+    }
+    free(sums);
+    size_t size;
+    unsigned char* png = png_encode_rgb(picture, width, height, &size);
+    free(picture);
+    FILE* file = fopen(path, "wb");
+    int ok = file && fwrite(png, 1, size, file) == size;
+    if (file) {
+        fclose(file);
+    }
+    free(png);
+    if (!ok) {
+        printf("Couldn't write %s\n", path);
+        return 0;
+    }
+    printf("%dx%d picture in %s\n", width, height, path);
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* pngPath = NULL;
+    int scale = 1;
+    picture_coloring coloring = PICTURE_ESCAPE;
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--png") == 0 && rest >= 1) {
+            pngPath = argv[++i];
+        } else if (strcmp(argv[i], "--scale") == 0 && rest >= 1) {
+            scale = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--coloring") == 0 && rest >= 1) {
+            coloring = pictureColoringByName(argv[++i]);
+            if (coloring == PICTURE_COUNT) {
+                printf("Unknown coloring %s\n", argv[i]);
+                return -1;
+            }
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (scale < 1) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    raw_dump* dump = raw_dump_open(argv[1]);
+    if (!dump) {
+        return -1;
+    }
+    printStatistics(dump);
+    int ok = !pngPath || writePicture(dump, pngPath, scale, coloring);
+    raw_dump_close(dump);
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,208 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "deep_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+#include "raw_dump.h"
+
+// Renders a view into a raw dump (see raw_dump.h) that dump_inspect and other tools read without rendering again.
+// The cpu engine fills in every plane, straight into the mapped tiles. The gpu and deep engines only compute the
+// iterations: the gpu engine renders them into the tiles as well, the deep engine renders a row of tiles at a time,
+// so a single reference orbit covers many tiles.
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT --center X Y --width W [options]\n"
+           "  --center X Y            center of the image, to as many digits as needed\n"
+           "  --width W               extent of the image's width in the plane\n"
+           "  --size WIDTH HEIGHT     image size in pixels (default 1024 1024)\n"
+           "  --formula NAME          mandelbrot, multibrot, burning_ship, tricorn or newton\n"
+           "  --power N               power of multibrot and newton\n"
+           "  --max-iter N            iteration limit (default 1000)\n"
+           "  --engine cpu|gpu|deep   (default cpu)\n"
+           "  --threads N             cpu and deep engine threads (default: all cores)\n",
+           program);
+}
+
+typedef struct {
+    raw_dump* dump;
+    const fractal_params* params;
+    // next tile to render, shared between the workers
+    int* next;
+} tile_job;
+
+static void* renderTiles(void* arg) {
+    tile_job* job = arg;
+    int tilesX = raw_dump_tiles_x(job->dump);
+    int tiles = tilesX * raw_dump_tiles_y(job->dump);
+    for (int t = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED); t < tiles;
+         t = __atomic_fetch_add(job->next, 1, __ATOMIC_RELAXED)) {
+        fractal_view view;
+        raw_dump_tile_view(job->dump, t % tilesX, t / tilesX, &view);
+        raw_tile tile = raw_dump_get_tile(job->dump, t % tilesX, t / tilesX);
+        cpu_render_raw(job->params, &view, RAW_DUMP_TILE, RAW_DUMP_TILE, tile.escape, tile.smooth, tile.distance,
+                       tile.z);
+    }
+    return NULL;
+}
+
+int renderCpu(raw_dump* dump, const fractal_params* params, int threads) {
+    int next = 0;
+    pthread_t* workers = malloc(threads * sizeof(pthread_t));
+    tile_job job = {dump, params, &next};
+    for (int t = 0; t < threads; ++t) {
+        pthread_create(&workers[t], NULL, renderTiles, &job);
+    }
+    for (int t = 0; t < threads; ++t) {
+        pthread_join(workers[t], NULL);
+    }
+    free(workers);
+    return 1;
+}
+
+int renderGpu(raw_dump* dump, const fractal_params* params) {
+    gpu_engine engine;
+    if (!gl_context_create_offscreen() || !gpu_engine_init(&engine, params, RAW_DUMP_TILE)) {
+        return 0;
+    }
+    for (int ty = 0; ty < raw_dump_tiles_y(dump); ++ty) {
+        for (int tx = 0; tx < raw_dump_tiles_x(dump); ++tx) {
+            fractal_view view;
+            raw_dump_tile_view(dump, tx, ty, &view);
+            gpu_engine_render_iterations(&engine, &view, RAW_DUMP_TILE, RAW_DUMP_TILE,
+                                         raw_dump_get_tile(dump, tx, ty).escape);
+        }
+    }
+    gpu_engine_destroy(&engine);
+    gl_context_destroy();
+    return 1;
+}
+
+int renderDeep(raw_dump* dump, const fractal_params* params, int threads) {
+    const raw_dump_header* header = raw_dump_get_header(dump);
+    deep_view view;
+    if (!deep_view_parse_center(&view, header->center[0], header->center[1])) {
+        return 0;
+    }
+    mp_number center[2] = {view.center[0], view.center[1]};
+    deep_options options;
+    deep_options_default(&options);
+    int tilesX = raw_dump_tiles_x(dump);
+    int stripWidth = tilesX * RAW_DUMP_TILE;
+    double pixel = header->view_width / header->width;
+    int* strip = malloc((size_t)stripWidth * RAW_DUMP_TILE * sizeof(int));
+    int result = 1;
+    for (int ty = 0; ty < raw_dump_tiles_y(dump) && result; ++ty) {
+        // the strip's center relative to the image's, in pixels
+        double x = stripWidth / 2.0 - header->width / 2.0;
+        double y = ty * RAW_DUMP_TILE + RAW_DUMP_TILE / 2.0 - header->height / 2.0;
+        mp_number offset;
+        mp_from_double(&offset, x * pixel, MP_MAX_LIMBS);
+        mp_add(&view.center[0], &center[0], &offset);
+        mp_from_double(&offset, y * pixel, MP_MAX_LIMBS);
+        mp_add(&view.center[1], &center[1], &offset);
+        view.width = stripWidth * pixel;
+        result = deep_render_iterations(params, &view, stripWidth, RAW_DUMP_TILE, strip, threads, &options, NULL);
+        for (int tx = 0; tx < tilesX && result; ++tx) {
+            int32_t* escape = raw_dump_get_tile(dump, tx, ty).escape;
+            for (int row = 0; row < RAW_DUMP_TILE; ++row) {
+                memcpy(escape + row * RAW_DUMP_TILE, strip + (size_t)row * stripWidth + tx * RAW_DUMP_TILE,
+                       RAW_DUMP_TILE * sizeof(int));
+            }
+        }
+        printf("row %d/%d\n", ty + 1, raw_dump_tiles_y(dump));
+    }
+    free(strip);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    const char* center[2] = {NULL, NULL};
+    double viewWidth = 0;
+    int width = 1024, height = 1024;
+    const char* engine = "cpu";
+    int threads = cpu_thread_count();
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--center") == 0 && rest >= 2) {
+            center[0] = argv[++i];
+            center[1] = argv[++i];
+        } else if (strcmp(argv[i], "--width") == 0 && rest >= 1) {
+            viewWidth = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--formula") == 0 && rest >= 1) {
+            formula_id formula = formula_by_name(argv[++i]);
+            if (formula == FORMULA_COUNT) {
+                printf("Unknown formula %s\n", argv[i]);
+                return -1;
+            }
+            int maxIter = params.max_iter;
+            fractal_params_default(&params, formula);
+            params.max_iter = maxIter;
+        } else if (strcmp(argv[i], "--power") == 0 && rest >= 1) {
+            params.power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            engine = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    deep_view parsed;
+    if (!center[0] || !deep_view_parse_center(&parsed, center[0], center[1]) || viewWidth <= 0 ||
+        width <= 0 || height <= 0 || params.max_iter <= 0 || threads <= 0 || params.power < MIN_POWER ||
+        params.power > MAX_POWER) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    int cpu = strcmp(engine, "cpu") == 0;
+    int gpu = strcmp(engine, "gpu") == 0;
+    int deep = strcmp(engine, "deep") == 0;
+    if (!cpu && !gpu && !deep) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (deep && params.formula != FORMULA_MANDELBROT) {
+        printf("Only %s has a deep version\n", formula_get(FORMULA_MANDELBROT)->name);
+        return -1;
+    }
+    fractal_view view = {{atof(center[0]) - viewWidth / 2, atof(center[1]) - viewWidth * height / width / 2},
+                         viewWidth};
+    precision_tier needed = precision_tier_for_view(&view, width);
+    if ((gpu && needed > PRECISION_FLOAT) || (cpu && needed > PRECISION_DOUBLE)) {
+        printf("The view needs %s precision, the %s engine's pixels will blur together\n",
+               precision_tier_name(needed), engine);
+    }
+
+    raw_dump* dump = raw_dump_create(outputPath, width, height, &params, center, viewWidth,
+                                     cpu ? RAW_FIELD_ALL : RAW_FIELD_ESCAPE, engine);
+    if (!dump) {
+        return -1;
+    }
+    int rendered = cpu ? renderCpu(dump, &params, threads)
+                       : gpu ? renderGpu(dump, &params) : renderDeep(dump, &params, threads);
+    raw_dump_close(dump);
+    if (!rendered) {
+        printf("Failed to render %s\n", outputPath);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,307 @@
+#include "farm.h"
+
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "cpu_engine.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+#include "video.h"
+
+// Fills a unix socket address for unix:PATH, otherwise resolves HOST:PORT. Returns 0 if address is neither.
+static int resolve(const char* address, int passive, struct sockaddr_un* local, struct addrinfo** remote) {
+    if (strncmp(address, "unix:", 5) == 0) {
+        memset(local, 0, sizeof(*local));
+        local->sun_family = AF_UNIX;
+        strncpy(local->sun_path, address + 5, sizeof(local->sun_path) - 1);
+        *remote = NULL;
+        return 1;
+    }
+    const char* colon = strrchr(address, ':');
+    if (!colon || colon == address) {
+        return 0;
+    }
+    char host[256];
+    snprintf(host, sizeof(host), "%.*s", (int)(colon - address), address);
+    struct addrinfo hints = {0};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    return getaddrinfo(host, colon + 1, &hints, remote) == 0;
+}
+
+static int open_socket(const char* address, int passive) {
+    struct sockaddr_un local;
+    struct addrinfo* remote;
+    if (!resolve(address, passive, &local, &remote)) {
+        fprintf(stderr, "Can't resolve %s\n", address);
+        return -1;
+    }
+    int result = -1;
+    if (!remote) {
+        result = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (passive) {
+            unlink(local.sun_path);
+        }
+        if (result >= 0 && (passive ? bind(result, (struct sockaddr*)&local, sizeof(local))
+                                    : connect(result, (struct sockaddr*)&local, sizeof(local))) != 0) {
+            close(result);
+            result = -1;
+        }
+    }
+    for (struct addrinfo* candidate = remote; candidate && result < 0; candidate = candidate->ai_next) {
+        result = socket(candidate->ai_family, candidate->ai_socktype, candidate->ai_protocol);
+        int reuse = 1;
+        if (result >= 0 && passive) {
+            setsockopt(result, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (result >= 0 && (passive ? bind(result, candidate->ai_addr, candidate->ai_addrlen)
+                                    : connect(result, candidate->ai_addr, candidate->ai_addrlen)) != 0) {
+            close(result);
+            result = -1;
+        }
+    }
+    if (remote) {
+        freeaddrinfo(remote);
+    }
+    if (result >= 0 && passive && listen(result, SOMAXCONN) != 0) {
+        close(result);
+        result = -1;
+    }
+    if (result < 0) {
+        fprintf(stderr, "Couldn't %s %s\n", passive ? "listen on" : "connect to", address);
+    }
+    return result;
+}
+
+int farm_listen(const char* address) {
+    return open_socket(address, 1);
+}
+
+int farm_connect(const char* address) {
+    return open_socket(address, 0);
+}
+
+static int send_all(int socket, const void* data, size_t size) {
+    const char* bytes = data;
+    while (size > 0) {
+        ssize_t sent = send(socket, bytes, size, 0);
+        if (sent <= 0) {
+            return 0;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return 1;
+}
+
+static int receive_all(int socket, void* data, size_t size) {
+    char* bytes = data;
+    while (size > 0) {
+        ssize_t received = recv(socket, bytes, size, 0);
+        if (received <= 0) {
+            return 0;
+        }
+        bytes += received;
+        size -= received;
+    }
+    return 1;
+}
+
+int farm_send(int socket, farm_message_type type, int tx, int ty, const void* payload, uint32_t bytes) {
+    farm_message message = {type, tx, ty, bytes};
+    return send_all(socket, &message, sizeof(message)) && send_all(socket, payload, bytes);
+}
+
+int farm_receive(int socket, farm_message* message, unsigned char** payload, size_t* capacity) {
+    if (!receive_all(socket, message, sizeof(*message))) {
+        return 0;
+    }
+    if (message->bytes > *capacity) {
+        unsigned char* grown = realloc(*payload, message->bytes);
+        if (!grown) {
+            return 0;
+        }
+        *payload = grown;
+        *capacity = message->bytes;
+    }
+    return receive_all(socket, *payload, message->bytes);
+}
+
+void farm_tile_view(const tiled_image_header* job, int tx, int ty, int* width, int* height, fractal_view* view) {
+    int tileSize = job->tile_size;
+    int restX = job->width - tx * tileSize;
+    int restY = job->height - ty * tileSize;
+    *width = restX < tileSize ? restX : tileSize;
+    *height = restY < tileSize ? restY : tileSize;
+    double pixel = job->view_width / job->width;
+    // tile rows count from the top, the engines' rows from the bottom
+    int bottom = job->height - ty * tileSize - *height;
+    view->corner[0] = job->corner[0] + (double)tx * tileSize * pixel;
+    view->corner[1] = job->corner[1] + bottom * pixel;
+    view->width = *width * pixel;
+}
+
+int farm_video_chunk(const farm_video_header* job, int chunk, int* first) {
+    *first = chunk * FARM_VIDEO_CHUNK;
+    int rest = (int)job->frames - *first;
+    return rest < FARM_VIDEO_CHUNK ? rest : FARM_VIDEO_CHUNK;
+}
+
+int farm_worker_run(const char* address, int useGpu, int threads) {
+    int server = farm_connect(address);
+    if (server < 0) {
+        return 0;
+    }
+    farm_message message;
+    unsigned char* payload = NULL;
+    size_t capacity = 0;
+    tiled_image_header job;
+    farm_video_header videoJob;
+    if (!farm_send(server, FARM_HELLO, FARM_VERSION, 0, NULL, 0) ||
+        !farm_receive(server, &message, &payload, &capacity) ||
+        !((message.type == FARM_JOB && message.bytes == sizeof(job)) ||
+          (message.type == FARM_VIDEO_JOB && message.bytes == sizeof(videoJob)))) {
+        fprintf(stderr, "No job from %s\n", address);
+        free(payload);
+        close(server);
+        return 0;
+    }
+    int video = message.type == FARM_VIDEO_JOB;
+    fractal_params params;
+    if (video) {
+        memcpy(&videoJob, payload, sizeof(videoJob));
+        params = (fractal_params){.formula = videoJob.formula,
+                                  .power = videoJob.power,
+                                  .max_iter = videoJob.max_iter,
+                                  .coloring = COLORING_ITERATIONS};
+    } else {
+        memcpy(&job, payload, sizeof(job));
+        params = (fractal_params){
+            .formula = job.formula, .power = job.power, .max_iter = job.max_iter, .coloring = job.coloring};
+    }
+    if (params.formula < 0 || params.formula >= FORMULA_COUNT || params.coloring < 0 ||
+        params.coloring >= COLORING_COUNT) {
+        fprintf(stderr, "Unknown formula or coloring in the job from %s\n", address);
+        free(payload);
+        close(server);
+        return 0;
+    }
+
+    gpu_engine engine;
+    video_zoom zoom;
+    if (useGpu && !gl_context_create_offscreen()) {
+        free(payload);
+        close(server);
+        return 0;
+    }
+    if (video) {
+        fractal_view from = {{videoJob.from[0], videoJob.from[1]}, videoJob.from[2]};
+        fractal_view to = {{videoJob.to[0], videoJob.to[1]}, videoJob.to[2]};
+        if (!video_zoom_init(&zoom, &params, &from, &to, videoJob.width, videoJob.height, videoJob.frames, useGpu,
+                             threads)) {
+            free(payload);
+            close(server);
+            return 0;
+        }
+    } else if (useGpu && !gpu_engine_init(&engine, &params, job.tile_size)) {
+        free(payload);
+        close(server);
+        return 0;
+    }
+    size_t pixels = video ? 0 : (size_t)job.tile_size * job.tile_size;
+    size_t frameBytes = video ? (size_t)videoJob.width * videoJob.height * 3 : 0;
+    int* iterations = malloc(pixels * sizeof(int));
+    float* statistics = malloc(pixels * sizeof(float));
+    unsigned char* rendered = malloc(pixels * 3);
+    unsigned char* tile = malloc(video ? frameBytes * FARM_VIDEO_CHUNK : pixels * 3);
+
+    int queue[FARM_WINDOW][2];
+    int queued = 0;
+    int connected = 1;
+    int done = 0;
+    while (connected && !done) {
+        // take in everything that arrived, waiting only when there is nothing to render
+        struct pollfd poller = {server, POLLIN, 0};
+        while (connected && !done && (queued == 0 || poll(&poller, 1, 0) > 0)) {
+            connected = farm_receive(server, &message, &payload, &capacity);
+            if (!connected) {
+                break;
+            }
+            if (message.type == FARM_DONE) {
+                done = 1;
+            } else if (message.type == FARM_TILE && queued == FARM_WINDOW) {
+                // the coordinator would wait for the tile forever, it has to hand it to another worker
+                fprintf(stderr, "%s queued more than %d tiles, disconnecting\n", address, FARM_WINDOW);
+                connected = 0;
+            } else if (message.type == FARM_TILE) {
+                queue[queued][0] = message.tx;
+                queue[queued][1] = message.ty;
+                ++queued;
+            } else if (message.type == FARM_CANCEL) {
+                for (int i = 0; i < queued; ++i) {
+                    if (queue[i][0] == message.tx && queue[i][1] == message.ty) {
+                        memmove(queue[i], queue[i + 1], (queued - i - 1) * sizeof(queue[0]));
+                        --queued;
+                        break;
+                    }
+                }
+            }
+        }
+        if (!connected || done || queued == 0) {
+            continue;
+        }
+
+        int tx = queue[0][0], ty = queue[0][1];
+        memmove(queue[0], queue[1], (queued - 1) * sizeof(queue[0]));
+        --queued;
+        if (video) {
+            int first;
+            int frames = farm_video_chunk(&videoJob, tx, &first);
+            for (int f = 0; f < frames; ++f) {
+                video_zoom_render_frame(&zoom, first + f, tile + f * frameBytes);
+            }
+            connected = farm_send(server, FARM_RESULT, tx, ty, tile, (uint32_t)(frames * frameBytes));
+            continue;
+        }
+        int width, height;
+        fractal_view view;
+        farm_tile_view(&job, tx, ty, &width, &height, &view);
+        if (useGpu) {
+            gpu_engine_render_rgb(&engine, &view, width, height, rendered);
+        } else if (params.coloring != COLORING_ITERATIONS) {
+            // the same density as the GPU's STATISTIC_DENSITY, like poster
+            cpu_render_statistics_parallel(&params, &view, width, height, iterations, statistics, threads);
+            colorize_statistics(params.coloring, iterations, statistics, width * height, 1.0, rendered);
+        } else {
+            cpu_render_iterations_parallel(&params, &view, width, height, iterations, threads, 1);
+            colorize_iterations(iterations, width * height, rendered);
+        }
+        for (int j = 0; j < height; ++j) {
+            memcpy(tile + (size_t)j * width * 3, rendered + (size_t)(height - 1 - j) * width * 3, (size_t)width * 3);
+        }
+        connected = farm_send(server, FARM_RESULT, tx, ty, tile, (uint32_t)width * height * 3);
+    }
+
+    free(tile);
+    free(rendered);
+    free(statistics);
+    free(iterations);
+    free(payload);
+    if (video) {
+        video_zoom_destroy(&zoom);
+    } else if (useGpu) {
+        gpu_engine_destroy(&engine);
+    }
+    if (useGpu) {
+        gl_context_destroy();
+    }
+    close(server);
+    return done;
+}
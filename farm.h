@@ -0,0 +1,71 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fractal.h"
+#include "tiled_image.h"
+
+// Protocol between render_farm, which splits a tiled_image into tiles or a zoom video into chunks of frames, and the
+// farm_worker processes rendering them.
+//
+// Every message is a farm_message followed by `bytes` of payload, in native byte order (a farm needs machines that
+// agree on it, which every machine we run on does). A worker connects and sends FARM_HELLO with the protocol
+// version in tx; the coordinator answers with FARM_JOB, whose payload is the tiled_image_header of the image. After
+// that the coordinator keeps up to FARM_WINDOW tiles queued on each worker with FARM_TILE, and the worker answers
+// every tile with FARM_RESULT carrying its pixels, rows top to bottom, 3 bytes per pixel. FARM_CANCEL takes back a
+// queued tile that was handed to an idle worker instead, FARM_DONE tells the worker to exit.
+//
+// A video is the same with FARM_VIDEO_JOB and a farm_video_header instead of FARM_JOB: the tiles are chunks of
+// FARM_VIDEO_CHUNK frames, numbered by tx with ty 0, and the result carries the chunk's frames one after the other.
+//
+// Addresses are HOST:PORT for TCP or unix:PATH for a unix socket.
+
+#define FARM_VERSION 2
+// tiles queued on a worker at once, so it never waits for the next one to arrive
+#define FARM_WINDOW 3
+// frames of a video rendered as one tile, enough for the keyframes to be reused between them
+#define FARM_VIDEO_CHUNK 8
+
+typedef enum { FARM_HELLO, FARM_JOB, FARM_TILE, FARM_CANCEL, FARM_RESULT, FARM_DONE, FARM_VIDEO_JOB } farm_message_type;
+
+typedef struct {
+    uint32_t type;
+    int32_t tx;
+    int32_t ty;
+    uint32_t bytes;
+} farm_message;
+
+// A zoom video as zoom_video renders it, colored by iterations.
+typedef struct {
+    int32_t formula;
+    int32_t power;
+    int32_t max_iter;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frames;
+    // bottom left corner and width of the first and the last frame
+    double from[3];
+    double to[3];
+} farm_video_header;
+
+// Return a socket, or -1 after printing why.
+int farm_listen(const char* address);
+int farm_connect(const char* address);
+
+// Return 0 when the connection is gone.
+int farm_send(int socket, farm_message_type type, int tx, int ty, const void* payload, uint32_t bytes);
+// The payload goes into *payload, which is grown with realloc as needed.
+int farm_receive(int socket, farm_message* message, unsigned char** payload, size_t* capacity);
+
+// Size and part of the plane of tile (tx, ty) of the image, cropped like tiled_image_tile_size.
+void farm_tile_view(const tiled_image_header* job, int tx, int ty, int* width, int* height, fractal_view* view);
+
+// Number of frames in chunk of the video, the first of them goes into *first.
+int farm_video_chunk(const farm_video_header* job, int chunk, int* first);
+
+// Renders tiles for the coordinator at address until it is done. Returns 0 if the connection failed or was lost.
+int farm_worker_run(const char* address, int useGpu, int threads);
+
+#endif
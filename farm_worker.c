@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "farm.h"
+
+// Renders tiles for a render_farm coordinator, on this machine or another one, until the image is done.
+
+void printUsage(const char* program) {
+    printf("usage: %s ADDRESS [options]\n"
+           "  ADDRESS                 HOST:PORT or unix:PATH the coordinator listens on\n"
+           "  --engine cpu|gpu        (default gpu)\n"
+           "  --threads N             cpu engine threads (default: all cores)\n",
+           program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* address = argv[1];
+    int useGpu = 1;
+    int threads = cpu_thread_count();
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            useGpu = strcmp(argv[++i], "gpu") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    return farm_worker_run(address, useGpu, threads) ? 0 : -1;
+}
@@ -0,0 +1,96 @@
+#include "fractal.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define DEFAULT_MAX_ITER 1000
+// mantissa bits the iteration eats before neighbouring pixels stop being told apart
+#define PRECISION_GUARD_BITS 4
+
+static const formula_info FORMULAS[FORMULA_COUNT] = {
+    [FORMULA_MANDELBROT] = {"mandelbrot", "FORMULA_MANDELBROT", 2, 0},
+    [FORMULA_MULTIBROT] = {"multibrot", "FORMULA_MULTIBROT", 3, 1},
+    [FORMULA_BURNING_SHIP] = {"burning_ship", "FORMULA_BURNING_SHIP", 2, 0},
+    [FORMULA_TRICORN] = {"tricorn", "FORMULA_TRICORN", 2, 0},
+    [FORMULA_NEWTON] = {"newton", "FORMULA_NEWTON", 3, 1},
+};
+
+static const char* COLORINGS[COLORING_COUNT][2] = {
+    [COLORING_ITERATIONS] = {"iterations", "COLORING_ITERATIONS"},
+    [COLORING_TRAP_POINT] = {"trap_point", "COLORING_TRAP_POINT"},
+    [COLORING_TRAP_LINE] = {"trap_line", "COLORING_TRAP_LINE"},
+    [COLORING_TRAP_CROSS] = {"trap_cross", "COLORING_TRAP_CROSS"},
+    [COLORING_STRIPE] = {"stripe", "COLORING_STRIPE"},
+    [COLORING_TRIANGLE] = {"triangle", "COLORING_TRIANGLE"},
+    [COLORING_INTERIOR_DISTANCE] = {"interior_distance", "COLORING_INTERIOR_DISTANCE"},
+};
+
+const formula_info* formula_get(formula_id formula) {
+    return &FORMULAS[formula];
+}
+
+formula_id formula_by_name(const char* name) {
+    for (int i = 0; i < FORMULA_COUNT; ++i) {
+        if (strcmp(FORMULAS[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return FORMULA_COUNT;
+}
+
+const char* coloring_name(coloring_id coloring) {
+    return COLORINGS[coloring][0];
+}
+
+coloring_id coloring_by_name(const char* name) {
+    for (int i = 0; i < COLORING_COUNT; ++i) {
+        if (strcmp(COLORINGS[i][0], name) == 0) {
+            return i;
+        }
+    }
+    return COLORING_COUNT;
+}
+
+void fractal_params_default(fractal_params* params, formula_id formula) {
+    params->formula = formula;
+    params->power = FORMULAS[formula].default_power;
+    params->max_iter = DEFAULT_MAX_ITER;
+    params->coloring = COLORING_ITERATIONS;
+}
+
+const char* precision_tier_name(precision_tier tier) {
+    static const char* NAMES[PRECISION_COUNT] = {"float", "double", "deep"};
+    return NAMES[tier];
+}
+
+precision_tier precision_tier_for_view(const fractal_view* view, int width) {
+    double magnitude = fmax(fmax(fabs(view->corner[0]), fabs(view->corner[0] + view->width)),
+                            fmax(fabs(view->corner[1]), fabs(view->corner[1] + view->width)));
+    // bits needed to address a single pixel relative to the largest coordinate in view
+    double bits = log2(fmax(magnitude, 1) / (view->width / width)) + PRECISION_GUARD_BITS;
+    if (bits <= 24) {
+        return PRECISION_FLOAT;
+    }
+    if (bits <= 53) {
+        return PRECISION_DOUBLE;
+    }
+    return PRECISION_DEEP;
+}
+
+int fractal_shader_defines(const fractal_params* params, char* buf, int size) {
+    int written = 0;
+    for (int i = 0; i < FORMULA_COUNT; ++i) {
+        written += snprintf(buf + written, written < size ? size - written : 0, "#define %s %d\n",
+                            FORMULAS[i].macro, i);
+    }
+    for (int i = 0; i < COLORING_COUNT; ++i) {
+        written += snprintf(buf + written, written < size ? size - written : 0, "#define %s %d\n",
+                            COLORINGS[i][1], i);
+    }
+    written += snprintf(buf + written, written < size ? size - written : 0,
+                        "#define FORMULA %s\n#define POWER %d\n#define MAX_ITER %d\n#define COLORING %s\n",
+                        FORMULAS[params->formula].macro, params->power, params->max_iter,
+                        COLORINGS[params->coloring][1]);
+    return written;
+}
@@ -0,0 +1,85 @@
+#ifndef FRACTAL_H
+#define FRACTAL_H
+
+// Registry of the fractal formulas implemented in fractal_kernel.glsl.
+// The ids are also emitted into the shader source as FORMULA_* defines, so keep the order in sync with
+// the table in fractal.c.
+typedef enum {
+    FORMULA_MANDELBROT,
+    FORMULA_MULTIBROT,
+    FORMULA_BURNING_SHIP,
+    FORMULA_TRICORN,
+    FORMULA_NEWTON,
+    FORMULA_COUNT
+} formula_id;
+
+typedef struct {
+    const char* name;
+    const char* macro;
+    // power used when none is given, 2 for formulas that don't take one
+    int default_power;
+    // whether the power can be changed at all
+    char has_power;
+} formula_info;
+
+// What escaping pixels are colored by: their iteration, or a statistic of their orbit (see
+// formula_iterate_statistic in fractal_kernel.glsl). COLORING_INTERIOR_DISTANCE colors escaping pixels by iteration
+// and shades the interior by its distance to the boundary. Every statistic is a kernel variant of its own, emitted
+// into the shader source as COLORING_* defines like the formulas, so the iteration coloring pays nothing for them.
+typedef enum {
+    COLORING_ITERATIONS,
+    COLORING_TRAP_POINT,
+    COLORING_TRAP_LINE,
+    COLORING_TRAP_CROSS,
+    COLORING_STRIPE,
+    COLORING_TRIANGLE,
+    COLORING_INTERIOR_DISTANCE,
+    COLORING_COUNT
+} coloring_id;
+
+// Everything that selects a specialized kernel, on the GPU as well as on the CPU.
+typedef struct {
+    formula_id formula;
+    int power;
+    int max_iter;
+    coloring_id coloring;
+} fractal_params;
+
+// Square region of the plane: the image covers [corner, corner + width] horizontally and the same
+// fractal distance per pixel vertically.
+typedef struct {
+    double corner[2];
+    double width;
+} fractal_view;
+
+// home view of the viewer and the default of the batch tools
+#define CAMERA_CORNER_X -2.2
+#define CAMERA_CORNER_Y -1.5
+#define CAMERA_WIDTH 3
+
+// Number formats a view can be rendered in, from the cheapest.
+typedef enum { PRECISION_FLOAT, PRECISION_DOUBLE, PRECISION_DEEP, PRECISION_COUNT } precision_tier;
+
+#define MIN_POWER 2
+#define MAX_POWER 16
+
+const formula_info* formula_get(formula_id formula);
+// Returns FORMULA_COUNT if there is no formula with such name.
+formula_id formula_by_name(const char* name);
+
+const char* coloring_name(coloring_id coloring);
+// Returns COLORING_COUNT if there is no coloring with such name.
+coloring_id coloring_by_name(const char* name);
+
+// Colored by iterations.
+void fractal_params_default(fractal_params* params, formula_id formula);
+
+const char* precision_tier_name(precision_tier tier);
+// Cheapest tier that still tells neighbouring pixels apart when view is rendered width pixels wide.
+precision_tier precision_tier_for_view(const fractal_view* view, int width);
+
+// Writes the #define block that turns the generic kernel into the specialized one for params.
+// Returns the number of characters written (like snprintf).
+int fractal_shader_defines(const fractal_params* params, char* buf, int size);
+
+#endif
@@ -0,0 +1,366 @@
+// Fractal formulas shared by the GPU and the CPU engine.
+//
+// On the GPU this file is spliced into fragment_shader.glsl right after the #version line, together with the
+// FORMULA_* ids generated from the registry in fractal.c. On the CPU it is #included by cpu_engine.c, which
+// defines FRACTAL_KERNEL_HOST and provides C versions of vec2/vec3 and their constructors.
+// Because C has no vector operators, everything below uses only component access, scalar arithmetic
+// and function calls.
+//
+// Every formula function takes the formula id and power as arguments. Callers always pass compile time
+// constants (FORMULA and POWER in the shader, one instantiation per formula in cpu_engine.c), so each
+// variant is folded into its own specialized kernel.
+
+#ifndef FRACTAL_KERNEL_HOST
+#define real float
+#define complex_arg(a) atan((a).y, (a).x)
+#define real_to_int(a) int(a)
+#else
+#define complex_arg(a) atan2((a).y, (a).x)
+#define real_to_int(a) ((int)(a))
+typedef struct formula_orbit formula_orbit;
+#endif
+
+#define NEWTON_TOLERANCE 1e-6
+// orbit traps: the point, and the axes of the plane as the line and the cross
+#define TRAP_POINT_X 0.0
+#define TRAP_POINT_Y 0.0
+#define TRAP_NONE 1e30
+// stripes per turn of the argument
+#define STRIPE_DENSITY 5.0
+// |dz_n / dz_1|^2 below which the orbit has been drawn into an attracting cycle, so c is interior
+#define INTERIOR_THRESHOLD 1e-24
+#define INTERIOR_NEWTON_STEPS 8
+
+vec2 complex_add(vec2 a, vec2 b) {
+    return vec2(a.x + b.x, a.y + b.y);
+}
+
+vec2 complex_sub(vec2 a, vec2 b) {
+    return vec2(a.x - b.x, a.y - b.y);
+}
+
+// (a.x + ia.y) * (b.x + ib.y) = (a.x * b.x - a.y * b.y, i(a.x * b.y + a.y * b.x))
+vec2 complex_mult(vec2 a, vec2 b) {
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+// (a.x + ia.y)^2 = (a.x^2 - a.y^2, i * 2 * a.x * a.y), one multiplication less than complex_mult(a, a)
+vec2 complex_square(vec2 a) {
+    return vec2(a.x * a.x - a.y * a.y, 2.0 * a.x * a.y);
+}
+
+real complex_squared_abs(vec2 a) {
+    return a.x * a.x + a.y * a.y;
+}
+
+vec2 complex_conj(vec2 a) {
+    return vec2(a.x, -a.y);
+}
+
+// a / b = a * conj(b) / |b|^2
+vec2 complex_div(vec2 a, vec2 b) {
+    real denominator = complex_squared_abs(b);
+    vec2 numerator = complex_mult(a, complex_conj(b));
+    return vec2(numerator.x / denominator, numerator.y / denominator);
+}
+
+real real_abs(real a) {
+    return a < 0.0 ? -a : a;
+}
+
+real real_min(real a, real b) {
+    return a < b ? a : b;
+}
+
+// a^power by squaring, power >= 1
+vec2 complex_pow(vec2 a, int power) {
+    vec2 result = a;
+    vec2 base = a;
+    int rest = power - 1;
+    while (rest > 0) {
+        if (rest % 2 == 1) {
+            result = complex_mult(result, base);
+        }
+        rest /= 2;
+        if (rest > 0) {
+            base = complex_square(base);
+        }
+    }
+    return result;
+}
+
+// Starting value of the orbit for pixel c.
+vec2 formula_start(int formula, vec2 c) {
+    if (formula == FORMULA_NEWTON) {
+        return c;
+    }
+    return vec2(0.0, 0.0);
+}
+
+// One iteration of the formula.
+vec2 formula_step(int formula, int power, vec2 z, vec2 c) {
+    if (formula == FORMULA_MANDELBROT) {
+        return complex_add(complex_square(z), c);
+    }
+    if (formula == FORMULA_MULTIBROT) {
+        return complex_add(complex_pow(z, power), c);
+    }
+    if (formula == FORMULA_BURNING_SHIP) {
+        return complex_add(complex_square(vec2(real_abs(z.x), real_abs(z.y))), c);
+    }
+    if (formula == FORMULA_TRICORN) {
+        return complex_add(complex_square(complex_conj(z)), c);
+    }
+    // Newton's method for z^power - 1: z - (z^power - 1) / (power * z^(power - 1))
+    vec2 derivative = complex_pow(z, power - 1);
+    vec2 value = complex_sub(complex_mult(derivative, z), vec2(1.0, 0.0));
+    derivative = vec2(derivative.x * real(power), derivative.y * real(power));
+    return complex_sub(z, complex_div(value, derivative));
+}
+
+// Escape test for the escape time formulas, convergence test for Newton.
+bool formula_done(int formula, vec2 z, vec2 previous) {
+    if (formula == FORMULA_NEWTON) {
+        return complex_squared_abs(complex_sub(z, previous)) < NEWTON_TOLERANCE;
+    }
+    return complex_squared_abs(z) >= 4.0;
+}
+
+// Whether interior points are detected by the derivative of the orbit. Only the Mandelbrot set's is cheap enough,
+// one multiplication per iteration: a multibrot's would cost another power, and the burning ship's and tricorn's
+// formulas have no complex derivative.
+bool formula_checks_interior(int formula) {
+    return formula == FORMULA_MANDELBROT;
+}
+
+// dz times the derivative of z^2 + c at z, the chain rule: from 1 at z_1 on, dz tracks dz_n / dz_1.
+vec2 formula_derivative_step(vec2 dz, vec2 z) {
+    return complex_mult(vec2(2.0 * z.x, 2.0 * z.y), dz);
+}
+
+// Where the orbit of c ended: its last z, the iteration at which it escaped (or converged), -1 if it did neither
+// within max_iter, and how many iterations that took. With track_dc it also carries dz/dc, the derivative of z by c
+// the distance estimate needs, which only makes sense for the formulas holomorphic in c.
+struct formula_orbit {
+    vec2 z;
+    vec2 dc;
+    int escaped;
+    int executed;
+};
+
+// The iteration loop of every engine that needs no statistic. Where formula_checks_interior, the orbit stops early
+// once its derivative shows it is caught in an attracting cycle: |dz_n / dz_1| shrinks geometrically there and grows
+// everywhere else, so interior pixels no longer all run to max_iter. Like formula, track_dc is a compile time
+// constant in every caller, so the dz/dc update is folded away where it isn't wanted.
+formula_orbit formula_run(int formula, int power, vec2 c, int max_iter, bool track_dc) {
+    formula_orbit orbit;
+    orbit.z = formula_start(formula, c);
+    orbit.dc = vec2(0.0, 0.0);
+    orbit.escaped = -1;
+    orbit.executed = max_iter;
+    vec2 dz = vec2(1.0, 0.0);
+    for (int i = 0; i < max_iter; ++i) {
+        vec2 previous = orbit.z;
+        if (track_dc) {
+            // power z^(power - 1) dc + 1
+            vec2 derivative = complex_pow(orbit.z, power - 1);
+            derivative = vec2(derivative.x * real(power), derivative.y * real(power));
+            orbit.dc = complex_add(complex_mult(derivative, orbit.dc), vec2(1.0, 0.0));
+        }
+        orbit.z = formula_step(formula, power, orbit.z, c);
+        if (formula_done(formula, orbit.z, previous)) {
+            orbit.escaped = i;
+            orbit.executed = i + 1;
+            return orbit;
+        }
+        if (formula_checks_interior(formula)) {
+            dz = formula_derivative_step(dz, orbit.z);
+            if (complex_squared_abs(dz) < INTERIOR_THRESHOLD) {
+                orbit.executed = i + 1;
+                return orbit;
+            }
+        }
+    }
+    return orbit;
+}
+
+// The iteration of formula_run in x, the iterations it executed in y.
+vec2 formula_iterate_executed(int formula, int power, vec2 c, int max_iter) {
+    formula_orbit orbit = formula_run(formula, power, c, max_iter, false);
+    return vec2(real(orbit.escaped), real(orbit.executed));
+}
+
+// Just the iteration of formula_iterate_executed.
+int formula_iterate(int formula, int power, vec2 c, int max_iter) {
+    return real_to_int(formula_iterate_executed(formula, power, c, max_iter).x);
+}
+
+// Distance estimate from interior c to the boundary of its hyperbolic component (Mandelbrot set only), from the
+// attracting cycle of the period that the orbit at z was drawn into: Newton's method finds the cycle's point z0,
+// then with the derivatives of z_period(z0) the distance is (1 - |dz|^2) / |dzdc + dzdz dc / (1 - dz)|.
+// Returns 0 if z0 isn't attracting, for a wrong guess of the period.
+real formula_interior_distance(vec2 c, vec2 z, int period) {
+    vec2 z0 = z;
+    for (int newton = 0; newton < INTERIOR_NEWTON_STEPS; ++newton) {
+        vec2 w = z0;
+        vec2 dw = vec2(1.0, 0.0);
+        for (int k = 0; k < period; ++k) {
+            dw = formula_derivative_step(dw, w);
+            w = complex_add(complex_square(w), c);
+        }
+        z0 = complex_sub(z0, complex_div(complex_sub(w, z0), complex_sub(dw, vec2(1.0, 0.0))));
+    }
+    vec2 w = z0;
+    vec2 dz = vec2(1.0, 0.0);
+    vec2 dc = vec2(0.0, 0.0);
+    vec2 dzdz = vec2(0.0, 0.0);
+    vec2 dcdz = vec2(0.0, 0.0);
+    for (int k = 0; k < period; ++k) {
+        // every update reads the values before this iteration
+        vec2 twice_w = vec2(2.0 * w.x, 2.0 * w.y);
+        dcdz = complex_add(complex_mult(vec2(2.0 * dc.x, 2.0 * dc.y), dz), complex_mult(twice_w, dcdz));
+        dzdz = complex_add(complex_mult(vec2(2.0 * dz.x, 2.0 * dz.y), dz), complex_mult(twice_w, dzdz));
+        dc = complex_add(complex_mult(twice_w, dc), vec2(1.0, 0.0));
+        dz = complex_mult(twice_w, dz);
+        w = complex_add(complex_square(w), c);
+    }
+    real attraction = 1.0 - complex_squared_abs(dz);
+    if (!(attraction > 0.0)) {
+        return 0.0;
+    }
+    vec2 denominator = complex_add(dcdz, complex_div(complex_mult(dzdz, dc), complex_sub(vec2(1.0, 0.0), dz)));
+    return attraction / sqrt(complex_squared_abs(denominator));
+}
+
+// formula_iterate_executed, accumulating the statistic of the orbit the coloring colors by: returns the iteration (or
+// -1) in x, the statistic in y and the iterations executed in z.
+//   COLORING_TRAP_POINT, _LINE, _CROSS  smallest distance of z to the trap
+//   COLORING_STRIPE                     average of sin(STRIPE_DENSITY arg z) / 2 + 1 / 2
+//   COLORING_TRIANGLE                   average position of |z_n| between the bounds the triangle inequality puts on
+//                                       it, ||z_{n-1}^p| - |c|| and |z_{n-1}^p| + |c|
+//   COLORING_INTERIOR_DISTANCE          formula_interior_distance in pixels for interior points caught by the
+//                                       derivative, 0 for all others
+// The averages leave out z_1, which is just c, and blend the last two averages by the fraction of the smooth
+// iteration count, so they don't band at the escape iterations.
+vec3 formula_iterate_statistic(int formula, int power, int coloring, vec2 c, int max_iter, real pixel) {
+    vec2 z = formula_start(formula, c);
+    vec2 dz = vec2(1.0, 0.0);
+    // the iteration at which the orbit came closest to 0, the period of the cycle an interior orbit is drawn into
+    real closest = TRAP_NONE;
+    int period = 1;
+    real trap = TRAP_NONE;
+    real sum = 0.0;
+    real previous_sum = 0.0;
+    int terms = 0;
+    real c_abs = sqrt(complex_squared_abs(c));
+    int escaped = -1;
+    int executed = max_iter;
+    for (int i = 0; i < max_iter && escaped < 0; ++i) {
+        vec2 previous = z;
+        z = formula_step(formula, power, z, c);
+        if (coloring == COLORING_TRAP_POINT) {
+            trap = real_min(trap, sqrt(complex_squared_abs(complex_sub(z, vec2(TRAP_POINT_X, TRAP_POINT_Y)))));
+        } else if (coloring == COLORING_TRAP_LINE) {
+            trap = real_min(trap, real_abs(z.y));
+        } else if (coloring == COLORING_TRAP_CROSS) {
+            trap = real_min(trap, real_min(real_abs(z.x), real_abs(z.y)));
+        } else if (i > 0 && coloring != COLORING_INTERIOR_DISTANCE) {
+            previous_sum = sum;
+            ++terms;
+            if (coloring == COLORING_STRIPE) {
+                sum += 0.5 * sin(STRIPE_DENSITY * complex_arg(z)) + 0.5;
+            } else {
+                // z - c is z_{n-1}^p for the escape time formulas
+                real power_abs = sqrt(complex_squared_abs(complex_sub(z, c)));
+                real low = real_abs(power_abs - c_abs);
+                real high = power_abs + c_abs;
+                sum += high > low ? (sqrt(complex_squared_abs(z)) - low) / (high - low) : 0.0;
+            }
+        }
+        if (formula_done(formula, z, previous)) {
+            escaped = i;
+            executed = i + 1;
+        } else if (formula_checks_interior(formula)) {
+            if (coloring == COLORING_INTERIOR_DISTANCE && complex_squared_abs(z) < closest) {
+                closest = complex_squared_abs(z);
+                period = i + 1;
+            }
+            dz = formula_derivative_step(dz, z);
+            if (complex_squared_abs(dz) < INTERIOR_THRESHOLD) {
+                executed = i + 1;
+                if (coloring == COLORING_INTERIOR_DISTANCE) {
+                    return vec3(-1.0, formula_interior_distance(c, z, period) / pixel, real(executed));
+                }
+                break;
+            }
+        }
+    }
+    if (coloring == COLORING_INTERIOR_DISTANCE) {
+        return vec3(real(escaped), 0.0, real(executed));
+    }
+    if (coloring == COLORING_TRAP_POINT || coloring == COLORING_TRAP_LINE || coloring == COLORING_TRAP_CROSS) {
+        return vec3(real(escaped), trap, real(executed));
+    }
+    real average = terms > 0 ? sum / real(terms) : 0.0;
+    if (escaped < 0 || terms < 2) {
+        return vec3(real(escaped), average, real(executed));
+    }
+    // 1 - log2(log |z| / log 2), the fraction of the smooth iteration count
+    real fraction = 1.0 - log2(0.5 * log(complex_squared_abs(z)) / log(2.0));
+    fraction = fraction < 0.0 ? 0.0 : fraction > 1.0 ? 1.0 : fraction;
+    real previous_average = previous_sum / real(terms - 1);
+    return vec3(real(escaped), previous_average + (average - previous_average) * fraction, real(executed));
+}
+
+// Cosine gradient through the rainbow for the statistics, density turns per unit.
+vec3 color_by_statistic(real value, real density) {
+    real turn = 6.283185307 * value * density;
+    return vec3(0.5 + 0.5 * cos(turn), 0.5 + 0.5 * cos(turn - 2.094395102), 0.5 + 0.5 * cos(turn - 4.188790205));
+}
+
+// Closed form of the rainbow palette: red -> yellow -> green -> cyan -> blue -> magenta -> red,
+// CYCLE_COLORS shades per transition.
+vec3 color_by_iter_rainbow(int iter) {
+    int CYCLE_COLORS = 20;
+    int COLORS_AMOUNT = CYCLE_COLORS * 6 - 5;
+    real step_diff = 1.0 / real(CYCLE_COLORS - 1);
+    int index = iter % COLORS_AMOUNT;
+    if (index < CYCLE_COLORS) {
+        return vec3(1.0, real(index) * step_diff, 0.0);
+    }
+    int segment = (index - CYCLE_COLORS) / (CYCLE_COLORS - 1) + 1;
+    real t = real((index - CYCLE_COLORS) % (CYCLE_COLORS - 1) + 1) * step_diff;
+    if (segment == 1) {
+        return vec3(1.0 - t, 1.0, 0.0);
+    }
+    if (segment == 2) {
+        return vec3(0.0, 1.0, t);
+    }
+    if (segment == 3) {
+        return vec3(0.0, 1.0 - t, 1.0);
+    }
+    if (segment == 4) {
+        return vec3(t, 0.0, 1.0);
+    }
+    return vec3(1.0, 0.0, 1.0 - t);
+}
+
+// Gray for interior points by their distance to the boundary in pixels, dark at the boundary and lighter inside.
+vec3 color_by_interior_distance(real distance, real density) {
+    real shade = distance * density / (1.0 + distance * density);
+    return vec3(shade, shade, shade);
+}
+
+// Color of a kernel result, the iteration (-1 for interior points) and the statistic of the coloring.
+vec3 color_by_result(int coloring, int iter, real statistic, real density) {
+    if (iter < 0) {
+        if (coloring == COLORING_INTERIOR_DISTANCE) {
+            return color_by_interior_distance(statistic, density);
+        }
+        return vec3(0.0, 0.0, 0.0);
+    }
+    if (coloring == COLORING_ITERATIONS || coloring == COLORING_INTERIOR_DISTANCE) {
+        return color_by_iter_rainbow(iter);
+    }
+    return color_by_statistic(statistic, density);
+}
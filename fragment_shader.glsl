@@ -1,40 +1,14 @@
 #version 330 core
 
-#define MAX_ITER 1000
-#define LIGHT_COEFF vec4(0.3, 0.3, 0.3, 0.0)
+// FORMULA, POWER, MAX_ITER, COLORING and the formula functions are spliced in after the #version line,
+// see fractal_kernel.glsl
 
 in vec2 coords;
 out vec4 color;
 
+// bottom left corner of the viewport in the plane and the size of its (square) pixels
 uniform vec2 camera_corner;
-uniform float camera_width;
-
-uniform float zoom_rectangle_left_x;
-uniform float zoom_rectangle_up_y;
-uniform float zoom_rectangle_right_x;
-uniform float zoom_rectangle_down_y;
-uniform bool draw_zoom_rectangle;
-
-vec2 complex_add(vec2 a, vec2 b) {
-    return a + b;
-}
-
-// (a.x + ia.y) * (b.x + ib.y) = (a.x * b.x - a.y * b.y, i(a.x * b.y + a.y * b.x))
-vec2 complex_mult(vec2 a, vec2 b) {
-    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
-}
-
-float complex_squared_abs(vec2 a) {
-    return a.x * a.x + a.y * a.y;
-}
-
-float complex_abs(vec2 a) {
-    return sqrt(complex_squared_abs(a));
-}
-
-vec2 fractal_func(vec2 z, vec2 c) {
-    return complex_add(complex_mult(z, z), c);
-}
+uniform float camera_pixel;
 
 vec3 color_by_iter_orange(int iter) {
     vec3 base_color = vec3(1, 0.55, 0);
@@ -52,52 +26,39 @@ vec3 color_by_iter_rgb(int iter) {
     }
 }
 
-vec3 color_by_iter_rainbow(int iter) {
-    const int CYCLE_COLORS = 20;
-    const int COLORS_AMOUNT = CYCLE_COLORS * 6 - 5;
-    float step_diff = 1.0 / (CYCLE_COLORS - 1);
-    vec3 colors[COLORS_AMOUNT];
-    for (int i = 0; i < CYCLE_COLORS; ++i) {
-        colors[0 * CYCLE_COLORS + i] = vec3(1.0, i * step_diff, 0.0);
-    }
-    for (int i = 1; i < CYCLE_COLORS; ++i) {
-        colors[1 * CYCLE_COLORS + i - 1] = vec3(1.0 - i * step_diff, 1.0, 0.0);
-    }
-    for (int i = 1; i < CYCLE_COLORS; ++i) {
-        colors[2 * CYCLE_COLORS - 1 + i - 1] = vec3(0.0, 1.0, i * step_diff);
-    }
-    for (int i = 1; i < CYCLE_COLORS; ++i) {
-        colors[3 * CYCLE_COLORS - 2 + i - 1] = vec3(0.0, 1.0 - i * step_diff, 1.0);
-    }
-    for (int i = 1; i < CYCLE_COLORS; ++i) {
-        colors[4 * CYCLE_COLORS - 3 + i - 1] = vec3(i * step_diff, 0.0, 1.0);
-    }
-    for (int i = 1; i < CYCLE_COLORS; ++i) {
-        colors[5 * CYCLE_COLORS - 4 + i - 1] = vec3(1.0, 0.0, 1.0 - i * step_diff);
-    }
-    return colors[iter % COLORS_AMOUNT];
-}
+// turns of the palette per unit of the orbit statistic, when colored by one
+#define STATISTIC_DENSITY 1.0
 
 vec4 calculate_color_for_coordinates(vec2 camera_coords) {
-    vec2 z = vec2(0, 0);
-    for (int i = 0; i < MAX_ITER; ++i) {
-        z = fractal_func(z, camera_coords);
-        if (complex_squared_abs(z) >= 4) {
-            return vec4(color_by_iter_rainbow(i), 1);
-        }
+#if COLORING != COLORING_ITERATIONS
+    vec3 result = formula_iterate_statistic(FORMULA, POWER, COLORING, camera_coords, MAX_ITER, camera_pixel);
+    return vec4(color_by_result(COLORING, int(result.x), result.y, STATISTIC_DENSITY), 1);
+#else
+    int iter = formula_iterate(FORMULA, POWER, camera_coords, MAX_ITER);
+    if (iter >= 0) {
+        return vec4(color_by_iter_rainbow(iter), 1);
     }
     return vec4(0, 0, 0, 1);
+#endif
 }
 
 void main() {
-    vec2 camera_coords = (coords * 0.5 + vec2(0.5, 0.5)) * camera_width + camera_corner;
+    vec2 camera_coords = camera_corner + gl_FragCoord.xy * camera_pixel;
 
-    color = calculate_color_for_coordinates(camera_coords);
+#ifdef OUTPUT_ITERATIONS
+    // raw result of the kernel for whatever colors it later (color_shader.glsl, engines reading it back):
+    // the iteration, -1 if the point never escaped, how many iterations were executed (fewer than MAX_ITER for
+    // interior points the derivative caught) and the orbit statistic, so recoloring it differently doesn't iterate
+    // again
+#if COLORING != COLORING_ITERATIONS
+    vec3 result = formula_iterate_statistic(FORMULA, POWER, COLORING, camera_coords, MAX_ITER, camera_pixel);
+    color = vec4(result.x, result.z, result.y, 1);
+#else
+    vec2 result = formula_iterate_executed(FORMULA, POWER, camera_coords, MAX_ITER);
+    color = vec4(result.x, result.y, 0, 1);
+#endif
+    return;
+#endif
 
-    if (draw_zoom_rectangle) {
-        if (zoom_rectangle_left_x <= coords[0] && coords[0] <= zoom_rectangle_right_x && \
-            zoom_rectangle_down_y <= coords[1] && coords[1] <= zoom_rectangle_up_y) {
-            color += LIGHT_COEFF;
-        }
-    }
+    color = calculate_color_for_coordinates(camera_coords);
 }
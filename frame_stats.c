@@ -0,0 +1,111 @@
+#include "frame_stats.h"
+
+#include <math.h>
+
+int frame_stats_init(frame_stats* stats, const char* csvPath) {
+    *stats = (frame_stats){0};
+    glGenQueries(FRAME_STATS_SLOTS * PASS_COUNT, &stats->queries[0][0]);
+    glGenBuffers(1, &stats->iterationBuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, stats->iterationBuffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, 2 * sizeof(float), NULL, GL_STREAM_READ);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (csvPath) {
+        stats->csv = fopen(csvPath, "w");
+        if (!stats->csv) {
+            fprintf(stderr, "Couldn't create %s\n", csvPath);
+            return 0;
+        }
+        fprintf(stats->csv, "frame,fractal_gpu_ms,color_gpu_ms,overlay_gpu_ms,cpu_ms,iterations_per_s,precision\n");
+    }
+    return 1;
+}
+
+void frame_stats_destroy(frame_stats* stats) {
+    glDeleteQueries(FRAME_STATS_SLOTS * PASS_COUNT, &stats->queries[0][0]);
+    glDeleteBuffers(1, &stats->iterationBuffer);
+    if (stats->iterationFence) {
+        glDeleteSync(stats->iterationFence);
+    }
+    if (stats->csv) {
+        fclose(stats->csv);
+    }
+}
+
+void frame_stats_begin_frame(frame_stats* stats) {
+    stats->slot = (stats->slot + 1) % FRAME_STATS_SLOTS;
+    for (int pass = 0; pass < PASS_COUNT; ++pass) {
+        if (!stats->issued[stats->slot][pass]) {
+            continue;
+        }
+        stats->issued[stats->slot][pass] = 0;
+        GLuint query = stats->queries[stats->slot][pass];
+        GLint available = 0;
+        glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint64 nanoseconds;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            stats->gpuMilliseconds[pass] = nanoseconds / 1e6;
+            if (pass == PASS_FRACTAL) {
+                stats->nanosecondsPerPixel = nanoseconds / stats->fractalPixels[stats->slot];
+            }
+        }
+    }
+
+    if (stats->iterationFence && glClientWaitSync(stats->iterationFence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+        glDeleteSync(stats->iterationFence);
+        stats->iterationFence = 0;
+        float mean[2];
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, stats->iterationBuffer);
+        glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, sizeof(mean), mean);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        stats->iterations = mean[1] * stats->iterationPixels;
+    }
+    if (stats->gpuMilliseconds[PASS_FRACTAL] > 0) {
+        stats->iterationsPerSecond = stats->iterations / (stats->gpuMilliseconds[PASS_FRACTAL] / 1e3);
+    }
+}
+
+void frame_stats_begin_pass(frame_stats* stats, render_pass pass) {
+    glBeginQuery(GL_TIME_ELAPSED, stats->queries[stats->slot][pass]);
+    stats->issued[stats->slot][pass] = 1;
+}
+
+void frame_stats_end_pass(frame_stats* stats) {
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void frame_stats_count_iterations(frame_stats* stats, GLuint texture, int width, int height) {
+    if (stats->iterationFence) {
+        glDeleteSync(stats->iterationFence);
+    }
+    // the smallest mipmap level holds the mean over the whole image
+    int level = (int)floor(log2(width > height ? width : height));
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, stats->iterationBuffer);
+    glGetTexImage(GL_TEXTURE_2D, level, GL_RG, GL_FLOAT, (void*)0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    stats->iterationFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stats->iterationPixels = (double)width * height;
+    stats->fractalPixels[stats->slot] = stats->iterationPixels;
+}
+
+void frame_stats_set_iterations(frame_stats* stats, double iterations, int width, int height) {
+    if (stats->iterationFence) {
+        glDeleteSync(stats->iterationFence);
+        stats->iterationFence = 0;
+    }
+    stats->iterations = iterations;
+    stats->fractalPixels[stats->slot] = (double)width * height;
+}
+
+void frame_stats_end_frame(frame_stats* stats, double cpuMilliseconds, precision_tier precision) {
+    stats->cpuMilliseconds = cpuMilliseconds;
+    if (stats->csv) {
+        fprintf(stats->csv, "%ld,%.3f,%.3f,%.3f,%.3f,%.0f,%s\n", stats->frame, stats->gpuMilliseconds[PASS_FRACTAL],
+                stats->gpuMilliseconds[PASS_COLOR], stats->gpuMilliseconds[PASS_OVERLAY], cpuMilliseconds,
+                stats->iterationsPerSecond, precision_tier_name(precision));
+    }
+    ++stats->frame;
+}
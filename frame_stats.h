@@ -0,0 +1,62 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <glad/glad.h>
+
+#include <stdio.h>
+
+#include "fractal.h"
+
+// Per pass GPU times, CPU time and iteration throughput of the viewer's frames.
+//
+// GL_TIME_ELAPSED queries are double buffered: a frame's queries are only read back when their slot comes round
+// again, and dropped if they still aren't done then, so measuring never waits for the GPU. The iteration count of
+// the fractal pass is read back the same way, through a pixel buffer and a fence.
+
+#define FRAME_STATS_SLOTS 2
+
+typedef enum { PASS_FRACTAL, PASS_COLOR, PASS_OVERLAY, PASS_COUNT } render_pass;
+
+typedef struct {
+    GLuint queries[FRAME_STATS_SLOTS][PASS_COUNT];
+    char issued[FRAME_STATS_SLOTS][PASS_COUNT];
+    int slot;
+    long frame;
+
+    // size of the fractal pass issued in every slot
+    double fractalPixels[FRAME_STATS_SLOTS];
+
+    GLuint iterationBuffer;
+    GLsync iterationFence;
+    double iterationPixels;
+
+    FILE* csv;
+
+    // latest measurements, the fractal pass only runs when the image changes
+    double gpuMilliseconds[PASS_COUNT];
+    double cpuMilliseconds;
+    double iterations;
+    double iterationsPerSecond;
+    // GPU time of the fractal pass per pixel, to predict the time of a render at another resolution
+    double nanosecondsPerPixel;
+} frame_stats;
+
+// csvPath may be NULL. Returns 0 if the CSV file can't be created.
+int frame_stats_init(frame_stats* stats, const char* csvPath);
+void frame_stats_destroy(frame_stats* stats);
+
+// Collects whatever results have arrived since the previous frame.
+void frame_stats_begin_frame(frame_stats* stats);
+void frame_stats_begin_pass(frame_stats* stats, render_pass pass);
+void frame_stats_end_pass(frame_stats* stats);
+
+// Starts reading back the number of iterations the fractal pass just executed, from the second channel of the
+// level 0 of texture; the texture needs mipmaps. Call it after every fractal pass.
+void frame_stats_count_iterations(frame_stats* stats, GLuint texture, int width, int height);
+// Instead of frame_stats_count_iterations, for fractal passes that know how many iterations they executed: the
+// tiled pass only executes the ones of the tiles it renders, not of those it draws from the cache.
+void frame_stats_set_iterations(frame_stats* stats, double iterations, int width, int height);
+
+void frame_stats_end_frame(frame_stats* stats, double cpuMilliseconds, precision_tier precision);
+
+#endif
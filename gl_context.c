@@ -0,0 +1,141 @@
+#include "gl_context.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+static GLFWwindow* offscreenWindow;
+
+#ifdef HAVE_EGL
+static EGLDisplay headlessDisplay = EGL_NO_DISPLAY;
+static EGLContext headlessContext = EGL_NO_CONTEXT;
+#endif
+
+int gl_context_create_offscreen(void) {
+    if (!glfwInit()) {
+        fprintf(stderr, "Failed to start GLFW context, trying headless\n");
+        return gl_context_create_headless();
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    // everything is drawn into framebuffer objects, the window only carries the context
+    offscreenWindow = glfwCreateWindow(1, 1, "didedoshka's fractal", NULL, NULL);
+    if (!offscreenWindow) {
+        fprintf(stderr, "Failed to create GLFW window, trying headless\n");
+        glfwTerminate();
+        return gl_context_create_headless();
+    }
+    glfwMakeContextCurrent(offscreenWindow);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        fprintf(stderr, "Failed to initialize OpenGL context\n");
+        gl_context_destroy();
+        return 0;
+    }
+    return 1;
+}
+
+#ifdef HAVE_EGL
+
+static int has_extension(const char* extensions, const char* name) {
+    size_t length = strlen(name);
+    for (const char* found = extensions; found && (found = strstr(found, name)); found += length) {
+        if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0')) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int gl_context_create_headless(void) {
+    // the surfaceless platform needs neither a display server nor a GPU device node
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (!getPlatformDisplay ||
+        !has_extension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+        fprintf(stderr, "EGL has no surfaceless platform\n");
+        return 0;
+    }
+    headlessDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+    if (headlessDisplay == EGL_NO_DISPLAY || !eglInitialize(headlessDisplay, NULL, NULL)) {
+        fprintf(stderr, "Failed to initialize EGL\n");
+        headlessDisplay = EGL_NO_DISPLAY;
+        return 0;
+    }
+    if (!has_extension(eglQueryString(headlessDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context") ||
+        !eglBindAPI(EGL_OPENGL_API)) {
+        fprintf(stderr, "EGL can't make desktop OpenGL current without a surface\n");
+        gl_context_destroy();
+        return 0;
+    }
+
+    // the surface type defaults to windows, which the surfaceless platform has none of
+    const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+    EGLConfig config;
+    EGLint configCount;
+    if (!eglChooseConfig(headlessDisplay, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        fprintf(stderr, "No EGL config for desktop OpenGL\n");
+        gl_context_destroy();
+        return 0;
+    }
+    const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION,
+                                        3,
+                                        EGL_CONTEXT_MINOR_VERSION,
+                                        3,
+                                        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                        EGL_NONE};
+    headlessContext = eglCreateContext(headlessDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+    if (headlessContext == EGL_NO_CONTEXT ||
+        !eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, headlessContext)) {
+        fprintf(stderr, "Failed to create a headless OpenGL 3.3 context\n");
+        gl_context_destroy();
+        return 0;
+    }
+
+    if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+        fprintf(stderr, "Failed to initialize OpenGL context\n");
+        gl_context_destroy();
+        return 0;
+    }
+    return 1;
+}
+
+#else
+
+int gl_context_create_headless(void) {
+    fprintf(stderr, "Built without EGL, no headless OpenGL context\n");
+    return 0;
+}
+
+#endif
+
+void gl_context_destroy(void) {
+#ifdef HAVE_EGL
+    if (headlessDisplay != EGL_NO_DISPLAY) {
+        eglMakeCurrent(headlessDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (headlessContext != EGL_NO_CONTEXT) {
+            eglDestroyContext(headlessDisplay, headlessContext);
+        }
+        eglTerminate(headlessDisplay);
+        headlessDisplay = EGL_NO_DISPLAY;
+        headlessContext = EGL_NO_CONTEXT;
+        return;
+    }
+#endif
+    glfwDestroyWindow(offscreenWindow);
+    offscreenWindow = NULL;
+    glfwTerminate();
+}
@@ -0,0 +1,16 @@
+#ifndef GL_CONTEXT_H
+#define GL_CONTEXT_H
+
+// OpenGL 3.3 core context for batch jobs that never show a window. Everything they draw goes into framebuffer
+// objects, so the context needs no default framebuffer.
+//
+// gl_context_create_offscreen uses a hidden GLFW window. Where there is no display to open one on (CI, render
+// nodes), it falls back to gl_context_create_headless: a surfaceless EGL context, which Mesa provides without any GPU
+// through llvmpipe. That one is only built where CMake found EGL (HAVE_EGL).
+//
+// Both return 0 (after printing why) if no context could be created.
+int gl_context_create_offscreen(void);
+int gl_context_create_headless(void);
+void gl_context_destroy(void);
+
+#endif
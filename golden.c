@@ -0,0 +1,442 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "deep_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+#include "png.h"
+
+// Golden image regression check: renders a fixed set of views through every engine that can render them and
+// compares the iteration buffers with golden data stored in the repository, so faster kernels can't drift away
+// from the reference unnoticed.
+//
+// The golden data of a view comes from its reference engine: cpu_scalar, the double precision translation of
+// fragment_shader.glsl's kernel, for the views double can resolve, and the deep engine with plain perturbation (no
+// BLA tables) for those beyond. Every engine renders the views within its precision tier and is held to the pixels
+// the golden data resolves (see isResolved): one matches if both escaped at most iteration_tolerance iterations
+// apart, or neither did, and at most mismatch_tolerance of them may not. The pixels in unresolved dust only count
+// towards the report.
+//
+// For each comparison that fails a mismatch map is written: black where the pixels are equal, gray where they are
+// within the tolerance, red where both escaped further apart, white where only one of them escaped and dark blue
+// where unresolved pixels differ.
+//
+// --update renders the golden data again, after a change that is meant to alter the images.
+
+#define GOLDEN_SIZE 128
+#define GOLDEN_MAGIC "FRGOLDEN"
+#define GOLDEN_VERSION 1
+#define RESOLVED_NEIGHBOUR_ITERATIONS 4
+
+// Layout (native byte order): golden_header, then int32_t iterations[height][width] rows from the bottom, as
+// cpu_render_iterations leaves them.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    int32_t formula;
+    int32_t power;
+    int32_t max_iter;
+    double center[2];
+    double view_width;
+} golden_header;
+
+typedef struct {
+    const char* name;
+    formula_id formula;
+    // to as many digits as the view needs, the deep engine reads them with as many limbs as the width calls for
+    const char* center[2];
+    double width;
+    int max_iter;
+} golden_scene;
+
+static const golden_scene SCENES[] = {
+    {"home", FORMULA_MANDELBROT, {"-0.7", "0"}, CAMERA_WIDTH, 1000},
+    {"seahorse_valley", FORMULA_MANDELBROT, {"-0.7436438870", "0.1318259040"}, 0.05, 1000},
+    // mostly inside the main cardioid, nearly every pixel runs to max_iter
+    {"interior", FORMULA_MANDELBROT, {"-0.15", "0"}, 0.6, 1000},
+    // dendrite around a Misiurewicz point, nearly all boundary
+    {"filaments", FORMULA_MANDELBROT, {"-0.1010963638456222", "0.9562865108091415"}, 2e-3, 1000},
+    {"burning_ship", FORMULA_BURNING_SHIP, {"-1.7600", "-0.0300"}, 0.12, 500},
+    {"newton", FORMULA_NEWTON, {"0", "0"}, 3, 100},
+    // period 7 minibrot in the antenna, beyond single precision
+    {"deep_minibrot", FORMULA_MANDELBROT, {"-1.9990956823270185", "0"}, 1e-6, 2000},
+    // beyond double precision
+    {"deep_seahorse",
+     FORMULA_MANDELBROT,
+     {"-0.743643887037158704752191506114774", "0.131825904205311970493132056385139"},
+     1e-20,
+     10000},
+    // filaments at the Misiurewicz point c = i, beyond double-double, so the reference orbit is multiprecision
+    {"deep_misiurewicz", FORMULA_MANDELBROT, {"0", "1"}, 1e-40, 2000},
+};
+
+#define SCENE_COUNT (int)(sizeof(SCENES) / sizeof(SCENES[0]))
+
+typedef enum { ENGINE_GPU_FRAGMENT, ENGINE_CPU_SCALAR, ENGINE_CPU_SIMD, ENGINE_DEEP, ENGINE_COUNT } engine_id;
+
+typedef struct {
+    const char* name;
+    // the deepest views it resolves
+    precision_tier precision;
+    int iteration_tolerance;
+    double mismatch_tolerance;
+} engine_info;
+
+// cpu_scalar makes the golden data and has to reproduce it, but another compiler may contract a multiply and an
+// add here and there. Float separates fewer points, so resolved pixels close to the boundary still escape an
+// iteration or two earlier or later. The BLA tables neglect terms below BLA_EPSILON, which does the same.
+static const engine_info ENGINES[ENGINE_COUNT] = {
+    [ENGINE_GPU_FRAGMENT] = {"gpu_fragment", PRECISION_FLOAT, 2, 0.005},
+    [ENGINE_CPU_SCALAR] = {"cpu_scalar", PRECISION_DOUBLE, 0, 0.001},
+    [ENGINE_CPU_SIMD] = {"cpu_simd", PRECISION_DOUBLE, 0, 0.001},
+    [ENGINE_DEEP] = {"deep", PRECISION_DEEP, 2, 0.001},
+};
+
+void printUsage(const char* program) {
+    printf("usage: %s [options]\n"
+           "  --golden DIR            golden data (default golden)\n"
+           "  --maps DIR              write the mismatch maps there (default .)\n"
+           "  --engines NAME,...      gpu_fragment, cpu_scalar, cpu_simd, deep (default all)\n"
+           "  --scenes NAME,...       (default all)\n"
+           "  --threads N             (default: all cores)\n"
+           "  --update                render the golden data again instead of checking against it\n",
+           program);
+}
+
+// Sets selected[i] for the names in the comma separated text, 0 if one of them isn't in names.
+int parseNameList(char* text, const char* const* names, int count, char* selected) {
+    memset(selected, 0, count);
+    for (char* item = strtok(text, ","); item; item = strtok(NULL, ",")) {
+        int found = 0;
+        for (int i = 0; i < count; ++i) {
+            if (strcmp(item, names[i]) == 0) {
+                selected[i] = found = 1;
+            }
+        }
+        if (!found) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void sceneParams(const golden_scene* scene, fractal_params* params) {
+    fractal_params_default(params, scene->formula);
+    params->max_iter = scene->max_iter;
+}
+
+void sceneView(const golden_scene* scene, fractal_view* view) {
+    view->corner[0] = atof(scene->center[0]) - scene->width / 2;
+    view->corner[1] = atof(scene->center[1]) - scene->width / 2;
+    view->width = scene->width;
+}
+
+void sceneHeader(const golden_scene* scene, golden_header* header) {
+    fractal_params params;
+    sceneParams(scene, &params);
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, GOLDEN_MAGIC, sizeof(header->magic));
+    header->version = GOLDEN_VERSION;
+    header->width = GOLDEN_SIZE;
+    header->height = GOLDEN_SIZE;
+    header->formula = params.formula;
+    header->power = params.power;
+    header->max_iter = params.max_iter;
+    header->center[0] = atof(scene->center[0]);
+    header->center[1] = atof(scene->center[1]);
+    header->view_width = scene->width;
+}
+
+precision_tier scenePrecision(const golden_scene* scene) {
+    fractal_view view;
+    sceneView(scene, &view);
+    return precision_tier_for_view(&view, GOLDEN_SIZE);
+}
+
+int engineRenders(engine_id engine, const golden_scene* scene) {
+    return scenePrecision(scene) <= ENGINES[engine].precision &&
+           (engine != ENGINE_DEEP || scene->formula == FORMULA_MANDELBROT);
+}
+
+// Returns 0 (after printing why) if the engine can't render the scene.
+int render(engine_id engine, const golden_scene* scene, int threads, int useBla, int* iterations) {
+    fractal_params params;
+    fractal_view view;
+    sceneParams(scene, &params);
+    sceneView(scene, &view);
+    if (engine == ENGINE_GPU_FRAGMENT) {
+        gpu_engine gpu;
+        if (!gpu_engine_init(&gpu, &params, GOLDEN_SIZE)) {
+            return 0;
+        }
+        gpu_engine_render_iterations(&gpu, &view, GOLDEN_SIZE, GOLDEN_SIZE, iterations);
+        gpu_engine_destroy(&gpu);
+    } else if (engine == ENGINE_DEEP) {
+        deep_view deep;
+        deep.width = scene->width;
+        if (!deep_view_parse_center(&deep, scene->center[0], scene->center[1])) {
+            printf("Can't parse the center of %s\n", scene->name);
+            return 0;
+        }
+        deep_options options;
+        deep_options_default(&options);
+        options.use_bla = useBla;
+        return deep_render_iterations(&params, &deep, GOLDEN_SIZE, GOLDEN_SIZE, iterations, threads, &options, NULL);
+    } else {
+        cpu_render_iterations_parallel(&params, &view, GOLDEN_SIZE, GOLDEN_SIZE, iterations, threads,
+                                       engine == ENGINE_CPU_SIMD);
+    }
+    return 1;
+}
+
+// The golden data of a view is rendered by the most accurate engine that is fast enough to run in the check.
+engine_id referenceEngine(const golden_scene* scene) {
+    return scenePrecision(scene) <= PRECISION_DOUBLE ? ENGINE_CPU_SCALAR : ENGINE_DEEP;
+}
+
+void goldenPath(const char* directory, const golden_scene* scene, char* path, size_t size) {
+    snprintf(path, size, "%s/%s.golden", directory, scene->name);
+}
+
+int writeGolden(const char* path, const golden_scene* scene, const int* iterations) {
+    golden_header header;
+    sceneHeader(scene, &header);
+    size_t count = (size_t)GOLDEN_SIZE * GOLDEN_SIZE;
+    FILE* file = fopen(path, "wb");
+    int ok = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(iterations, sizeof(int32_t), count, file) == count;
+    if (file && fclose(file) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        printf("Couldn't write %s\n", path);
+    }
+    return ok;
+}
+
+int readGolden(const char* path, const golden_scene* scene, int* iterations) {
+    golden_header expected, header;
+    sceneHeader(scene, &expected);
+    size_t count = (size_t)GOLDEN_SIZE * GOLDEN_SIZE;
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        printf("Couldn't open %s, create it with --update\n", path);
+        return 0;
+    }
+    int ok = fread(&header, sizeof(header), 1, file) == 1 && fread(iterations, sizeof(int32_t), count, file) == count;
+    fclose(file);
+    if (!ok) {
+        printf("%s is truncated\n", path);
+        return 0;
+    }
+    if (memcmp(&header, &expected, sizeof(header)) != 0) {
+        printf("%s holds another view than %s, update it with --update\n", path, scene->name);
+        return 0;
+    }
+    return 1;
+}
+
+typedef struct {
+    // of the resolved pixels
+    int resolved;
+    int mismatches;
+    // unresolved pixels that aren't equal, only reported
+    int unresolvedDifferent;
+} comparison;
+
+// Whether the golden data pins the pixel down: its neighbours escaped (or not) like it, at most
+// RESOLVED_NEIGHBOUR_ITERATIONS iterations apart. Elsewhere the pixel samples dust or a filament that the image
+// doesn't resolve, where the slightest difference in rounding escapes at another iteration, so no other engine
+// could be expected to reproduce it.
+int isResolved(const int* golden, int x, int y) {
+    static const int OFFSETS[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    int value = golden[y * GOLDEN_SIZE + x];
+    for (int k = 0; k < 4; ++k) {
+        int nx = x + OFFSETS[k][0];
+        int ny = y + OFFSETS[k][1];
+        if (nx < 0 || ny < 0 || nx >= GOLDEN_SIZE || ny >= GOLDEN_SIZE) {
+            continue;
+        }
+        int neighbour = golden[ny * GOLDEN_SIZE + nx];
+        if ((neighbour < 0) != (value < 0) || abs(neighbour - value) > RESOLVED_NEIGHBOUR_ITERATIONS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Fills result and the mismatch map, 3 bytes per pixel with the rows from the bottom.
+void compare(const int* golden, const int* iterations, int tolerance, comparison* result, unsigned char* map) {
+    memset(result, 0, sizeof(*result));
+    for (int i = 0; i < GOLDEN_SIZE * GOLDEN_SIZE; ++i) {
+        unsigned char color[3] = {0, 0, 0};
+        int resolved = isResolved(golden, i % GOLDEN_SIZE, i / GOLDEN_SIZE);
+        result->resolved += resolved;
+        if (golden[i] == iterations[i]) {
+            // black
+        } else if (!resolved) {
+            ++result->unresolvedDifferent;
+            color[2] = 128;
+        } else if ((golden[i] < 0) != (iterations[i] < 0)) {
+            ++result->mismatches;
+            color[0] = color[1] = color[2] = 255;
+        } else {
+            if (abs(golden[i] - iterations[i]) > tolerance) {
+                ++result->mismatches;
+                color[0] = 255;
+            } else {
+                color[0] = color[1] = color[2] = 96;
+            }
+        }
+        memcpy(map + (size_t)i * 3, color, 3);
+    }
+}
+
+void writeMap(const char* directory, const golden_scene* scene, engine_id engine, const unsigned char* map) {
+    // PNG rows go from the top
+    int stride = GOLDEN_SIZE * 3;
+    unsigned char flipped[GOLDEN_SIZE * GOLDEN_SIZE * 3];
+    for (int row = 0; row < GOLDEN_SIZE; ++row) {
+        memcpy(flipped + row * stride, map + (GOLDEN_SIZE - 1 - row) * stride, stride);
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/mismatch-%s-%s.png", directory, scene->name, ENGINES[engine].name);
+    size_t size;
+    unsigned char* png = png_encode_rgb(flipped, GOLDEN_SIZE, GOLDEN_SIZE, &size);
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(png, 1, size, file) != size) {
+        printf("Couldn't write %s\n", path);
+    } else {
+        printf("  mismatch map in %s\n", path);
+    }
+    if (file) {
+        fclose(file);
+    }
+    free(png);
+}
+
+int main(int argc, char** argv) {
+    const char* goldenDirectory = "golden";
+    const char* mapDirectory = ".";
+    char enabled[ENGINE_COUNT];
+    char selected[SCENE_COUNT];
+    memset(enabled, 1, sizeof(enabled));
+    memset(selected, 1, sizeof(selected));
+    int threads = cpu_thread_count();
+    int update = 0;
+
+    const char* engineNames[ENGINE_COUNT];
+    for (int i = 0; i < ENGINE_COUNT; ++i) {
+        engineNames[i] = ENGINES[i].name;
+    }
+    const char* sceneNames[SCENE_COUNT];
+    for (int i = 0; i < SCENE_COUNT; ++i) {
+        sceneNames[i] = SCENES[i].name;
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--golden") == 0 && rest >= 1) {
+            goldenDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--maps") == 0 && rest >= 1) {
+            mapDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--engines") == 0 && rest >= 1 &&
+                   parseNameList(argv[i + 1], engineNames, ENGINE_COUNT, enabled)) {
+            ++i;
+        } else if (strcmp(argv[i], "--scenes") == 0 && rest >= 1 &&
+                   parseNameList(argv[i + 1], sceneNames, SCENE_COUNT, selected)) {
+            ++i;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--update") == 0) {
+            update = 1;
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (threads <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    int count = GOLDEN_SIZE * GOLDEN_SIZE;
+    int* golden = malloc(count * sizeof(int));
+    int* iterations = malloc(count * sizeof(int));
+    unsigned char* map = malloc((size_t)count * 3);
+    char path[4096];
+
+    if (update) {
+        for (int s = 0; s < SCENE_COUNT; ++s) {
+            if (!selected[s]) {
+                continue;
+            }
+            engine_id reference = referenceEngine(&SCENES[s]);
+            goldenPath(goldenDirectory, &SCENES[s], path, sizeof(path));
+            if (!render(reference, &SCENES[s], threads, 0, golden) || !writeGolden(path, &SCENES[s], golden)) {
+                return -1;
+            }
+            printf("Wrote %s with %s\n", path, ENGINES[reference].name);
+        }
+        return 0;
+    }
+
+    // headless on machines without a display, see gl_context.h
+    int haveContext = enabled[ENGINE_GPU_FRAGMENT] && gl_context_create_offscreen();
+    if (enabled[ENGINE_GPU_FRAGMENT] && !haveContext) {
+        printf("Skipping %s, no OpenGL context\n", ENGINES[ENGINE_GPU_FRAGMENT].name);
+        enabled[ENGINE_GPU_FRAGMENT] = 0;
+    }
+
+    int checks = 0;
+    int failures = 0;
+    for (int s = 0; s < SCENE_COUNT; ++s) {
+        if (!selected[s]) {
+            continue;
+        }
+        goldenPath(goldenDirectory, &SCENES[s], path, sizeof(path));
+        if (!readGolden(path, &SCENES[s], golden)) {
+            ++failures;
+            continue;
+        }
+        for (int e = 0; e < ENGINE_COUNT; ++e) {
+            if (!enabled[e] || !engineRenders(e, &SCENES[s])) {
+                continue;
+            }
+            ++checks;
+            if (!render(e, &SCENES[s], threads, 1, iterations)) {
+                printf("%-16s %-13s FAILED to render\n", SCENES[s].name, ENGINES[e].name);
+                ++failures;
+                continue;
+            }
+            comparison result;
+            compare(golden, iterations, ENGINES[e].iteration_tolerance, &result, map);
+            int passed = result.mismatches <= ENGINES[e].mismatch_tolerance * result.resolved;
+            printf("%-16s %-13s %s %5d of %5d resolved pixels differ by more than %d iterations (%.2f%%, %.2f%% "
+                   "allowed), %d unresolved ones differ\n",
+                   SCENES[s].name, ENGINES[e].name, passed ? "ok    " : "FAILED", result.mismatches, result.resolved,
+                   ENGINES[e].iteration_tolerance, 100.0 * result.mismatches / fmax(result.resolved, 1),
+                   100 * ENGINES[e].mismatch_tolerance, result.unresolvedDifferent);
+            if (!passed) {
+                ++failures;
+                writeMap(mapDirectory, &SCENES[s], e, map);
+            }
+        }
+    }
+    printf("%d of %d checks failed\n", failures, checks);
+
+    free(golden);
+    free(iterations);
+    free(map);
+    if (haveContext) {
+        gl_context_destroy();
+    }
+    return failures ? -1 : 0;
+}
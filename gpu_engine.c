@@ -0,0 +1,112 @@
+#include "gpu_engine.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader.h"
+
+static int init_target(gpu_target* target, const fractal_params* params, const char* defines, GLint internalFormat,
+                       GLenum format, GLenum type, int size) {
+    char* fragmentShaderSource = build_fragment_shader_source(FRAGMENT_SHADER_PATH, params, defines);
+    if (!fragmentShaderSource) {
+        return 0;
+    }
+    target->program = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    free(fragmentShaderSource);
+    if (!target->program) {
+        return 0;
+    }
+    target->cameraCornerLocation = glGetUniformLocation(target->program, "camera_corner");
+    target->cameraPixelLocation = glGetUniformLocation(target->program, "camera_pixel");
+
+    glGenTextures(1, &target->texture);
+    glBindTexture(GL_TEXTURE_2D, target->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, size, size, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &target->framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+}
+
+static void destroy_target(gpu_target* target) {
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteTextures(1, &target->texture);
+    glDeleteProgram(target->program);
+}
+
+int gpu_engine_init(gpu_engine* engine, const fractal_params* params, int maxSize) {
+    engine->params = *params;
+    engine->maxSize = maxSize;
+
+    float vertices[] = {
+        -1.0f, 1.0f,   // top left
+        -1.0f, -1.0f,  // bottom left
+        1.0f,  -1.0f,  // bottom right
+        -1.0f, 1.0f,   // top left
+        1.0f,  1.0f,   // top right
+        1.0f,  -1.0f,  // bottom right
+    };
+    glGenVertexArrays(1, &engine->VAO);
+    glGenBuffers(1, &engine->VBO);
+    glBindVertexArray(engine->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, engine->VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // iteration counts are exact in a float up to 2^24, the iterations executed go in the second channel
+    return init_target(&engine->rgb, params, NULL, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, maxSize) &&
+           init_target(&engine->iterations, params, "#define OUTPUT_ITERATIONS\n", GL_RG32F, GL_RG, GL_FLOAT,
+                       maxSize);
+}
+
+void gpu_engine_destroy(gpu_engine* engine) {
+    glDeleteVertexArrays(1, &engine->VAO);
+    glDeleteBuffers(1, &engine->VBO);
+    destroy_target(&engine->rgb);
+    destroy_target(&engine->iterations);
+}
+
+static void draw(gpu_engine* engine, gpu_target* target, const fractal_view* view, int width, int height) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glViewport(0, 0, width, height);
+    glUseProgram(target->program);
+    glBindVertexArray(engine->VAO);
+    glUniform2f(target->cameraCornerLocation, view->corner[0], view->corner[1]);
+    glUniform1f(target->cameraPixelLocation, view->width / width);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+void gpu_engine_render_rgb(gpu_engine* engine, const fractal_view* view, int width, int height, unsigned char* rgb) {
+    draw(engine, &engine->rgb, view, width, height);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+}
+
+// Reads one channel of the iterations target into counts.
+static void read_counts(GLenum channel, int width, int height, int* counts) {
+    // float and int have the same size, so convert in place
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, channel, GL_FLOAT, counts);
+    for (int i = 0; i < width * height; ++i) {
+        float value;
+        memcpy(&value, &counts[i], sizeof(value));
+        counts[i] = (int)value;
+    }
+}
+
+void gpu_engine_render_iterations(gpu_engine* engine, const fractal_view* view, int width, int height,
+                                  int* iterations) {
+    draw(engine, &engine->iterations, view, width, height);
+    read_counts(GL_RED, width, height, iterations);
+}
+
+void gpu_engine_render_executed(gpu_engine* engine, const fractal_view* view, int width, int height,
+                                int* iterations, int* executed) {
+    draw(engine, &engine->iterations, view, width, height);
+    read_counts(GL_RED, width, height, iterations);
+    read_counts(GL_GREEN, width, height, executed);
+}
@@ -0,0 +1,45 @@
+#ifndef GPU_ENGINE_H
+#define GPU_ENGINE_H
+
+#include <glad/glad.h>
+
+#include "fractal.h"
+
+// Renders fragment_shader.glsl into a framebuffer object and reads the result back, for batch jobs.
+// Needs a current GL context, see gl_context.h.
+
+// One variant of the shader with the texture it renders into.
+typedef struct {
+    GLuint program;
+    GLuint framebuffer;
+    GLuint texture;
+    GLint cameraCornerLocation;
+    GLint cameraPixelLocation;
+} gpu_target;
+
+typedef struct {
+    fractal_params params;
+    int maxSize;
+    GLuint VAO;
+    GLuint VBO;
+    // colored image
+    gpu_target rgb;
+    // raw iteration counts and the iterations executed, compiled with OUTPUT_ITERATIONS
+    gpu_target iterations;
+} gpu_engine;
+
+// maxSize bounds the width and height of a single render. Returns 0 if the kernel doesn't compile.
+int gpu_engine_init(gpu_engine* engine, const fractal_params* params, int maxSize);
+void gpu_engine_destroy(gpu_engine* engine);
+
+// Same pixel layout as cpu_render_iterations + colorize_iterations: rows from the bottom, 3 bytes per pixel.
+void gpu_engine_render_rgb(gpu_engine* engine, const fractal_view* view, int width, int height, unsigned char* rgb);
+
+// Same output as cpu_render_iterations, computed in single precision.
+void gpu_engine_render_iterations(gpu_engine* engine, const fractal_view* view, int width, int height,
+                                  int* iterations);
+// The same, with how many iterations each pixel executed in executed (see cpu_render_executed).
+void gpu_engine_render_executed(gpu_engine* engine, const fractal_view* view, int width, int height,
+                                int* iterations, int* executed);
+
+#endif
@@ -0,0 +1,143 @@
+#include "hud.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shader.h"
+
+#define HUD_SHADER_PATH "hud_shader.glsl"
+#define GLYPH_WIDTH 3
+#define GLYPH_HEIGHT 5
+// texels per font pixel
+#define HUD_SCALE 3
+#define HUD_MARGIN 1
+
+typedef struct {
+    char character;
+    // GLYPH_HEIGHT rows of GLYPH_WIDTH pixels, from the top
+    const char* bits;
+} glyph;
+
+static const glyph FONT[] = {
+    {'0', "111101101101111"}, {'1', "010110010010111"}, {'2', "111001111100111"}, {'3', "111001111001111"},
+    {'4', "101101111001001"}, {'5', "111100111001111"}, {'6', "111100111101111"}, {'7', "111001001001001"},
+    {'8', "111101111101111"}, {'9', "111101111001111"}, {'A', "010101111101101"}, {'B', "110101110101110"},
+    {'C', "011100100100011"}, {'D', "110101101101110"}, {'E', "111100110100111"}, {'F', "111100110100100"},
+    {'G', "011100101101011"}, {'H', "101101111101101"}, {'I', "111010010010111"}, {'J', "001001001101010"},
+    {'K', "101101110101101"}, {'L', "100100100100111"}, {'M', "101111111101101"}, {'N', "110101101101101"},
+    {'O', "010101101101010"}, {'P', "110101110100100"}, {'Q', "010101101110011"}, {'R', "110101110101101"},
+    {'S', "011100010001110"}, {'T', "111010010010010"}, {'U', "101101101101111"}, {'V', "101101101101010"},
+    {'W', "101101111111101"}, {'X', "101101010101101"}, {'Y', "101101010010010"}, {'Z', "111001010100111"},
+    {'.', "000000000000010"}, {':', "000010000010000"}, {'/', "001001010100100"}, {'-', "000000111000000"},
+    {'%', "101001010100101"}, {'(', "010100100100010"}, {')', "010001001001010"},
+};
+
+static const char* glyph_bits(char character) {
+    for (size_t i = 0; i < sizeof(FONT) / sizeof(FONT[0]); ++i) {
+        if (FONT[i].character == character) {
+            return FONT[i].bits;
+        }
+    }
+    return NULL;
+}
+
+int hud_init(hud* hud) {
+    memset(hud, 0, sizeof(*hud));
+    char* fragmentShaderSource = load_shader_from_file(HUD_SHADER_PATH);
+    if (!fragmentShaderSource) {
+        fprintf(stderr, "Couln't load %s\n", HUD_SHADER_PATH);
+        return 0;
+    }
+    hud->program = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    free(fragmentShaderSource);
+    if (!hud->program) {
+        return 0;
+    }
+    hud->hudLocation = glGetUniformLocation(hud->program, "hud");
+
+    hud->width = (HUD_COLUMNS * (GLYPH_WIDTH + HUD_MARGIN) + HUD_MARGIN) * HUD_SCALE;
+    hud->height = (HUD_ROWS * (GLYPH_HEIGHT + HUD_MARGIN) + HUD_MARGIN) * HUD_SCALE;
+    hud->pixels = calloc(hud->width * hud->height, 4);
+    glGenTextures(1, &hud->texture);
+    glBindTexture(GL_TEXTURE_2D, hud->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, hud->width, hud->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    return 1;
+}
+
+void hud_destroy(hud* hud) {
+    glDeleteTextures(1, &hud->texture);
+    glDeleteProgram(hud->program);
+    free(hud->pixels);
+}
+
+// Texel rows covered by a line of text, the last one also owns the bottom margin.
+static void line_texels(int row, int* top, int* height) {
+    *top = row * (GLYPH_HEIGHT + HUD_MARGIN) * HUD_SCALE;
+    *height = (GLYPH_HEIGHT + HUD_MARGIN + (row == HUD_ROWS - 1 ? HUD_MARGIN : 0)) * HUD_SCALE;
+}
+
+// Redraws one line of text into the pixel buffer: white glyphs on a translucent black background.
+static void rasterize_line(hud* hud, int row) {
+    int top, lineHeight;
+    line_texels(row, &top, &lineHeight);
+    for (int y = top; y < top + lineHeight; ++y) {
+        for (int x = 0; x < hud->width; ++x) {
+            unsigned char* pixel = hud->pixels + (y * hud->width + x) * 4;
+            pixel[0] = pixel[1] = pixel[2] = 0;
+            pixel[3] = 160;
+        }
+    }
+    for (int column = 0; hud->text[row][column]; ++column) {
+        const char* bits = glyph_bits(hud->text[row][column]);
+        if (!bits) {
+            continue;
+        }
+        for (int i = 0; i < GLYPH_WIDTH * GLYPH_HEIGHT; ++i) {
+            if (bits[i] != '1') {
+                continue;
+            }
+            int left = (column * (GLYPH_WIDTH + HUD_MARGIN) + HUD_MARGIN + i % GLYPH_WIDTH) * HUD_SCALE;
+            int up = top + ((HUD_MARGIN + i / GLYPH_WIDTH) * HUD_SCALE);
+            for (int y = up; y < up + HUD_SCALE; ++y) {
+                memset(hud->pixels + (y * hud->width + left) * 4, 255, HUD_SCALE * 4);
+            }
+        }
+    }
+}
+
+void hud_set_line(hud* hud, int row, const char* text) {
+    char line[HUD_COLUMNS + 1];
+    int length = 0;
+    for (; text[length] && length < HUD_COLUMNS; ++length) {
+        line[length] = toupper((unsigned char)text[length]);
+    }
+    line[length] = '\0';
+    if (strcmp(line, hud->text[row]) == 0) {
+        return;
+    }
+    strcpy(hud->text[row], line);
+    rasterize_line(hud, row);
+
+    int top, lineHeight;
+    line_texels(row, &top, &lineHeight);
+    glBindTexture(GL_TEXTURE_2D, hud->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, top, hud->width, lineHeight, GL_RGBA, GL_UNSIGNED_BYTE,
+                    hud->pixels + top * hud->width * 4);
+}
+
+void hud_draw(hud* hud, int framebufferHeight) {
+    glViewport(0, framebufferHeight - hud->height, hud->width, hud->height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glUseProgram(hud->program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, hud->texture);
+    glUniform1i(hud->hudLocation, 0);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDisable(GL_BLEND);
+}
@@ -0,0 +1,32 @@
+#ifndef HUD_H
+#define HUD_H
+
+#include <glad/glad.h>
+
+// Small text overlay in the top left corner of the window, drawn with a built-in 3x5 pixel font.
+// Only digits, upper case letters, space and . : / - % ( ) are drawn.
+
+#define HUD_COLUMNS 40
+#define HUD_ROWS 8
+
+typedef struct {
+    GLuint program;
+    GLuint texture;
+    GLint hudLocation;
+    char text[HUD_ROWS][HUD_COLUMNS + 1];
+    // texture contents, rows from the top
+    unsigned char* pixels;
+    int width;
+    int height;
+} hud;
+
+int hud_init(hud* hud);
+void hud_destroy(hud* hud);
+
+// Replaces line row of the text, lower case letters are drawn as upper case.
+void hud_set_line(hud* hud, int row, const char* text);
+
+// Draws over whatever is bound, with the quad VAO bound. Leaves the viewport and blending changed.
+void hud_draw(hud* hud, int framebufferHeight);
+
+#endif
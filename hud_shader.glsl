@@ -0,0 +1,11 @@
+#version 330 core
+
+in vec2 coords;
+out vec4 color;
+
+uniform sampler2D hud;
+
+// Drawn with alpha blending into a viewport covering just the HUD, see hud.c.
+void main() {
+    color = texture(hud, vec2(coords.x * 0.5 + 0.5, 0.5 - coords.y * 0.5));
+}
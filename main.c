@@ -6,49 +6,78 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
 
-const unsigned int SHADER_MAX_SOURCE_SIZE = 1024 * 1024;
-const unsigned int SHADER_MAX_LINE_SIZE = 180;
-const GLuint WIDTH = 900, HEIGHT = 900;
+#include "fractal.h"
+#include "frame_stats.h"
+#include "gpu_engine.h"
+#include "hud.h"
+#include "nucleus.h"
+#include "png.h"
+#include "readback.h"
+#include "shader.h"
+#include "spsc_queue.h"
+#include "tile_cache.h"
+#include "trace.h"
 
-const char* vertexShaderSource =
-    "#version 330 core\n"
-    "layout (location = 0) in vec2 position;\n"
-    "out vec2 coords;\n"
-    "void main()\n"
-    "{\n"
-    "   coords = position;\n"
-    "   gl_Position = vec4(position, 0.0f, 1.0f);\n"
-    "}\0";
-
-char* load_shader_from_file(const char* path) {
-    FILE* file;
-    file = fopen(path, "r");
-    if (!file) {
-        return NULL;
-    }
+#define COLOR_SHADER_PATH "color_shader.glsl"
+#define OVERLAY_SHADER_PATH "overlay_shader.glsl"
+#define TILE_SHADER_PATH "tile_shader.glsl"
+// 64 MiB of iterations
+#define TILE_CACHE_MEMORY_TILES 256
+// how often the HUD text changes, faster is unreadable
+#define HUD_REFRESH_SECONDS 0.25
 
-    char buf[SHADER_MAX_LINE_SIZE];
-    char* res = malloc(SHADER_MAX_SOURCE_SIZE);
+// initial window size
+const GLuint WIDTH = 900, HEIGHT = 900;
 
-    while (fgets(buf, SHADER_MAX_LINE_SIZE, file)) {
-        strcat(res, buf);
-    }
+// The camera is the center of the window and the extent of its shorter side in the plane, so resizing the window
+// keeps the same region in view and only shows more or less of the plane along the longer side.
+double cameraCenter[2] = {CAMERA_CORNER_X + CAMERA_WIDTH / 2.0, CAMERA_CORNER_Y + CAMERA_WIDTH / 2.0};
+double cameraSize = CAMERA_WIDTH;
+// the fractal pass only runs when this is set, every other frame just recolors the last iterations (render thread)
+char cameraChanged = 1;
 
-    fclose(file);
+fractal_params fractalParams;
+GLuint fractalProgram;
+GLuint colorProgram;
+GLuint overlayProgram;
 
-    return res;
-}
+GLint cameraCornerLocation;
+GLint cameraPixelLocation;
+GLint iterationsLocation;
+GLint statisticDensityLocation;
+// palette turns per unit of the orbit statistic, [ and ] change it without iterating again
+float statisticDensity = 1;
 
-#define CAMERA_CORNER_X -2.2
-#define CAMERA_CORNER_Y -1.5
-#define CAMERA_WIDTH 3
+// iterations of the fractal pass: the iteration in red, how many iterations were executed in green, and with a
+// coloring other than COLORING_ITERATIONS the orbit statistic in blue
+GLuint fractalFramebuffer;
+GLuint fractalTexture;
+GLint framebufferWidth, framebufferHeight;
+// the cursor is reported in screen coordinates, which differ from framebuffer pixels on HiDPI screens
+int windowWidth = WIDTH, windowHeight = HEIGHT;
+// the fractal pass renders at this fraction of the framebuffer resolution and the color pass upscales it
+float renderScale = 1;
+GLint renderWidth, renderHeight;
 
-float cameraCorner[2] = {CAMERA_CORNER_X, CAMERA_CORNER_Y};
-float cameraWidth = CAMERA_WIDTH;
+// Dynamic resolution: while the camera moves continuously (panning, scrolling) the fractal pass renders at the finest
+// level whose predicted GPU time fits the frame budget. Level n has half the pixels of level n - 1. Once input
+// stops the view is rendered again at level 0.
+#define RENDER_LEVELS 7
+#define FRAME_BUDGET_MILLISECONDS 12
+// a finer level has to fit in this fraction of the budget, or the level flips (and reallocates) every frame
+#define FINER_LEVEL_MARGIN 0.7
+#define INTERACTION_IDLE_SECONDS 0.15
+int renderLevel = 0;
+double lastInteraction = -1;
 
-GLint cameraCornerLocation;
-GLint cameraWidthLocation;
+// one scroll step zooms by this factor
+#define ZOOM_STEP 1.25
+char panning = 0;
+float panX;
+float panY;
 
 float zoomRectangleFirstX;
 float zoomRectangleFirstY;
@@ -65,22 +94,145 @@ GLint zoomRectangleLeftLocation;
 GLint zoomRectangleUpLocation;
 GLint zoomRectangleRightLocation;
 GLint zoomRectangleDownLocation;
-GLint drawZoomRectangleLocation;
+
+// Auto zoom (N key): the camera glides onto the lowest period nucleus in view until its minibrot fills this many
+// times its radius, or zooms into a Misiurewicz point by the given factor. Each input tick moves the center by the
+// given fraction of the way and zooms by the factor.
+#define AUTO_ZOOM_MINIBROT_RADII 8
+#define AUTO_ZOOM_MISIUREWICZ_DEPTH 100
+#define AUTO_ZOOM_CENTERING 0.2
+#define AUTO_ZOOM_FACTOR 0.95
+// the fractal pass works in float, views much smaller than this next to their center's coordinates turn to blocks
+#define AUTO_ZOOM_MIN_RELATIVE_SIZE 1e-4
+char autoZooming = 0;
+double autoZoomCenter[2];
+double autoZoomSize;
+
+// The nucleus is searched for on a thread of its own, which can take a while deep down with a high max_iter. The
+// main thread starts it, checks every input tick whether it is done and then joins it; nothing else touches
+// autoZoomSearch while it runs.
+typedef struct {
+    double_double center[2];
+    double width;
+    double height;
+    int maxPeriod;
+    // the camera size when the search started
+    double size;
+    int found;
+    periodic_point point;
+    char done;
+} auto_zoom_search;
+auto_zoom_search autoZoomSearch;
+pthread_t autoZoomSearchThread;
+char autoZoomSearching = 0;
+// whether to glide to what the running search finds, and whether to search the current view again after it
+char autoZoomSearchWanted = 0;
+char autoZoomSearchAgain = 0;
+
+#define MAX_PENDING_CLICKS 8
+
+typedef struct {
+    int button;
+    int action;
+    // where the cursor was at the time
+    float x;
+    float y;
+} pending_click;
+
+// Input gathered by the callbacks since the last frame, applied all at once by applyPendingInput. Cursor motion is
+// coalesced to the latest position, clicks are kept in order.
+typedef struct {
+    char cursorMoved;
+    float cursorX;
+    float cursorY;
+    pending_click clicks[MAX_PENDING_CLICKS];
+    int clickCount;
+    // scroll steps, positive zooms in
+    double scroll;
+} pending_input;
+
+pending_input pendingInput;
+
+// The main thread only handles input: the callbacks and applyPendingInput change the globals above, and after every
+// batch of events whatever the picture depends on is copied into a camera_snapshot and pushed to the render thread,
+// which owns the GL context. However long a frame takes, events keep being handled and the window stays responsive,
+// and once the frame is done the render thread skips straight to the latest snapshot.
+typedef struct {
+    double center[2];
+    double size;
+    fractal_params params;
+    float statisticDensity;
+    char drawZoomRectangle;
+    float zoomRectangleLeft;
+    float zoomRectangleUp;
+    float zoomRectangleRight;
+    float zoomRectangleDown;
+    int framebufferWidth;
+    int framebufferHeight;
+    double lastInteraction;
+    char showHud;
+    char recording;
+    // screenshots asked for so far, the render thread takes one whenever this grows
+    int screenshots;
+} camera_snapshot;
+
+// the render thread drains the queue every frame, so it only fills up while a frame takes very long
+#define SNAPSHOT_QUEUE_CAPACITY 16
+// how often the main thread wakes up while there's something to do without events: auto zooming, waiting for the
+// auto zoom's search or a snapshot that didn't fit in the queue
+#define INPUT_TICK_SECONDS (1.0 / 60)
+spsc_queue* snapshots;
+// the snapshot the render thread draws, the main thread only writes it before starting the render thread
+camera_snapshot snapshot;
+char renderFailed = 0;
+
+// With --tile-cache, still views are assembled from cached quadtree tiles, rendering only the missing ones with
+// tileEngine, so going back to a view that was seen before (like the home view) doesn't compute anything.
+tile_cache* tileCache;
+gpu_engine tileEngine;
+GLuint tileProgram;
+GLuint tileTexture;
+GLint tileCameraCornerLocation;
+GLint tileCameraPixelLocation;
+GLint tileLocation;
+GLint tileCornerLocation;
+GLint tileWidthLocation;
+
+frame_stats frameStats;
+hud statsHud;
+char showHud = 1;
+
+// Screenshots (p) and recording (r, with --record) read the frame back asynchronously and write the PNGs on the
+// readback thread, so neither stalls the render thread. Recorded frames are numbered by capture, so the frames the
+// writer didn't keep up with leave gaps. droppedBeforeRecording belongs to the render thread.
+readback* frameReadback;
+int screenshotRequests = 0;
+char recording = 0;
+const char* recordDirectory;
+long droppedBeforeRecording = 0;
 
 double screenToDeviceXCoordinate(double x) {
-    return (x / WIDTH) * 2 - 1;
+    return (x / windowWidth) * 2 - 1;
 }
 
 double screenToDeviceYCoordinate(double y) {
-    return -((y / HEIGHT) * 2 - 1);
+    return -((y / windowHeight) * 2 - 1);
+}
+
+double deviceToFractalXCoordinate(double x) {
+    return cameraCenter[0] + x * cameraSize / 2 * windowWidth / fmin(windowWidth, windowHeight);
 }
 
-float deviceToFractalXCoordinate(float x) {
-    return ((x + 1) / 2) * cameraWidth + cameraCorner[0];
+double deviceToFractalYCoordinate(double y) {
+    return cameraCenter[1] + y * cameraSize / 2 * windowHeight / fmin(windowWidth, windowHeight);
 }
 
-float deviceToFractalYCoordinate(float y) {
-    return ((y + 1) / 2) * cameraWidth + cameraCorner[1];
+// What the fractal pass renders: the camera with square pixels over the whole render target.
+fractal_view renderView() {
+    double pixel = snapshot.size / fmin(renderWidth, renderHeight);
+    fractal_view view = {{snapshot.center[0] - pixel * renderWidth / 2, snapshot.center[1] - pixel * renderHeight / 2},
+                         pixel * renderWidth};
+    return view;
 }
 
 void calculateZoomRectangleCoords() {
@@ -92,170 +244,721 @@ void calculateZoomRectangleCoords() {
     float width = secondX - firstX;
     float height = secondY - firstY;
 
-    float size = fminf(fabsf(width), fabsf(height));
+    // square on screen, so compare the sides in screen coordinates
+    float size = fminf(fabsf(width) * windowWidth, fabsf(height) * windowHeight);
+    float sizeX = size / windowWidth;
+    float sizeY = size / windowHeight;
 
     if (width < 0) {
-        zoomRectangleLeft = firstX - size;
+        zoomRectangleLeft = firstX - sizeX;
         zoomRectangleRight = firstX;
     } else {
         zoomRectangleLeft = firstX;
-        zoomRectangleRight = firstX + size;
+        zoomRectangleRight = firstX + sizeX;
     }
     if (height < 0) {
-        zoomRectangleDown = firstY - size;
+        zoomRectangleDown = firstY - sizeY;
         zoomRectangleUp = firstY;
     } else {
         zoomRectangleDown = firstY;
-        zoomRectangleUp = firstY + size;
+        zoomRectangleUp = firstY + sizeY;
     }
 }
 
 void sendZoomRectangleCoords() {
-    glUniform1f(zoomRectangleLeftLocation, zoomRectangleLeft);
-    glUniform1f(zoomRectangleRightLocation, zoomRectangleRight);
-    glUniform1f(zoomRectangleDownLocation, zoomRectangleDown);
-    glUniform1f(zoomRectangleUpLocation, zoomRectangleUp);
-    glUniform1i(drawZoomRectangleLocation, drawZoomRectangle);
+    glUniform1f(zoomRectangleLeftLocation, snapshot.zoomRectangleLeft);
+    glUniform1f(zoomRectangleRightLocation, snapshot.zoomRectangleRight);
+    glUniform1f(zoomRectangleDownLocation, snapshot.zoomRectangleDown);
+    glUniform1f(zoomRectangleUpLocation, snapshot.zoomRectangleUp);
 }
 
 void cursorPositionCallback(GLFWwindow* window, double xpos, double ypos) {
-    float currentXCursorPos = fmax(-1.0, fmin(1.0, screenToDeviceXCoordinate(xpos)));
-    float currentYCursorPos = fmax(-1.0, fmin(1.0, screenToDeviceYCoordinate(ypos)));
+    pendingInput.cursorX = fmax(-1.0, fmin(1.0, screenToDeviceXCoordinate(xpos)));
+    pendingInput.cursorY = fmax(-1.0, fmin(1.0, screenToDeviceYCoordinate(ypos)));
+    pendingInput.cursorMoved = 1;
+
+    TRACE_INSTANT("cursor", "x,y", pendingInput.cursorX, pendingInput.cursorY, 0);
+}
+
+void scrollCallback(GLFWwindow* window, double xoffset, double yoffset) {
+    TRACE_INSTANT("scroll", "y", yoffset, 0, 0);
+    pendingInput.scroll += yoffset;
+}
+
+void recalculateCamera() {
+    double centerX = deviceToFractalXCoordinate((zoomRectangleLeft + zoomRectangleRight) / 2);
+    double centerY = deviceToFractalYCoordinate((zoomRectangleDown + zoomRectangleUp) / 2);
+    cameraCenter[0] = centerX;
+    cameraCenter[1] = centerY;
+    // the square fills the shorter side of the window
+    cameraSize *= (zoomRectangleRight - zoomRectangleLeft) / 2 * windowWidth / fmin(windowWidth, windowHeight);
+    TRACE_INSTANT("camera", "x,y,size", cameraCenter[0], cameraCenter[1], cameraSize);
+}
+
+void moveZoomRectangleCorner(float x, float y) {
     if (!drawZoomRectangle) {
-        zoomRectangleFirstX = currentXCursorPos;
-        zoomRectangleFirstY = currentYCursorPos;
+        zoomRectangleFirstX = x;
+        zoomRectangleFirstY = y;
     } else {
-        zoomRectangleSecondX = currentXCursorPos;
-        zoomRectangleSecondY = currentYCursorPos;
+        zoomRectangleSecondX = x;
+        zoomRectangleSecondY = y;
     }
-    calculateZoomRectangleCoords();
-    sendZoomRectangleCoords();
-
-    printf("cursor position x: %f y: %f\n", currentXCursorPos, currentYCursorPos);
 }
 
-void recalculateCamera() {
-    cameraCorner[0] = deviceToFractalXCoordinate(zoomRectangleLeft);
-    cameraCorner[1] = deviceToFractalYCoordinate(zoomRectangleDown);
-    cameraWidth *= (zoomRectangleRight - zoomRectangleLeft) / 2;
+// Moves the camera so that the point under (panX, panY) ends up under (x, y).
+void panTo(float x, float y) {
+    if (x == panX && y == panY) {
+        return;
+    }
+    cameraCenter[0] += deviceToFractalXCoordinate(panX) - deviceToFractalXCoordinate(x);
+    cameraCenter[1] += deviceToFractalYCoordinate(panY) - deviceToFractalYCoordinate(y);
+    panX = x;
+    panY = y;
+    lastInteraction = glfwGetTime();
+    TRACE_INSTANT("camera", "x,y,size", cameraCenter[0], cameraCenter[1], cameraSize);
+}
 
-    glUniform2f(cameraCornerLocation, cameraCorner[0], cameraCorner[1]);
-    glUniform1f(cameraWidthLocation, cameraWidth);
+// Zooms by ZOOM_STEP per step, keeping the point under the cursor in place.
+void zoomAt(float x, float y, double steps) {
+    double fixedX = deviceToFractalXCoordinate(x);
+    double fixedY = deviceToFractalYCoordinate(y);
+    double factor = pow(ZOOM_STEP, -steps);
+    cameraCenter[0] = fixedX + (cameraCenter[0] - fixedX) * factor;
+    cameraCenter[1] = fixedY + (cameraCenter[1] - fixedY) * factor;
+    cameraSize *= factor;
+    lastInteraction = glfwGetTime();
+    TRACE_INSTANT("camera", "x,y,size", cameraCenter[0], cameraCenter[1], cameraSize);
 }
 
-void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
-    if (button == GLFW_MOUSE_BUTTON_LEFT) {
-        if (action == GLFW_PRESS) {
+void applyClick(const pending_click* click) {
+    moveZoomRectangleCorner(click->x, click->y);
+    if (panning) {
+        panTo(click->x, click->y);
+    }
+    if (click->button == GLFW_MOUSE_BUTTON_LEFT) {
+        if (click->action == GLFW_PRESS) {
             drawZoomRectangle = 1;
             zoomRectangleSecondX = zoomRectangleFirstX;
             zoomRectangleSecondY = zoomRectangleFirstY;
         }
-        if (action == GLFW_RELEASE) {
+        if (click->action == GLFW_RELEASE && drawZoomRectangle) {
+            calculateZoomRectangleCoords();
             recalculateCamera();
             drawZoomRectangle = 0;
             // if user wants to make another zoom from the spot he just finished
             zoomRectangleFirstX = zoomRectangleSecondX;
             zoomRectangleFirstY = zoomRectangleSecondY;
         }
-        calculateZoomRectangleCoords();
-        sendZoomRectangleCoords();
-        printf("%d\n", drawZoomRectangle);
-    } else if (button == GLFW_MOUSE_BUTTON_RIGHT) {
-        if (action == GLFW_RELEASE) {
-            cameraCorner[0] = CAMERA_CORNER_X;
-            cameraCorner[1] = CAMERA_CORNER_Y;
-            cameraWidth = CAMERA_WIDTH;
-            glUniform2f(cameraCornerLocation, cameraCorner[0], cameraCorner[1]);
-            glUniform1f(cameraWidthLocation, cameraWidth);
+    } else if (click->button == GLFW_MOUSE_BUTTON_RIGHT) {
+        if (click->action == GLFW_RELEASE) {
+            cameraCenter[0] = CAMERA_CORNER_X + CAMERA_WIDTH / 2.0;
+            cameraCenter[1] = CAMERA_CORNER_Y + CAMERA_WIDTH / 2.0;
+            cameraSize = CAMERA_WIDTH;
+            TRACE_INSTANT("camera", "x,y,size", cameraCenter[0], cameraCenter[1], cameraSize);
         }
+    } else if (click->button == GLFW_MOUSE_BUTTON_MIDDLE) {
+        panning = click->action == GLFW_PRESS;
+        panX = click->x;
+        panY = click->y;
     }
 }
 
-int main(void) {
-    if (glfwInit()) {
-        printf("Started GLFW context, OpenGL 3.3\n");
+void applyPendingClicks() {
+    for (int i = 0; i < pendingInput.clickCount; ++i) {
+        applyClick(&pendingInput.clicks[i]);
+    }
+    pendingInput.clickCount = 0;
+}
+
+void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods) {
+    TRACE_INSTANT("mouse button", "button,action", button, action, 0);
+    // a full batch is replayed early rather than dropping a click, a lost release would leave the zoom rectangle open
+    if (pendingInput.clickCount == MAX_PENDING_CLICKS) {
+        applyPendingClicks();
+    }
+    pendingInput.clicks[pendingInput.clickCount++] =
+        (pending_click){button, action, pendingInput.cursorX, pendingInput.cursorY};
+}
+
+// Replays the clicks since the last batch of events and then the latest cursor position, so the zoom rectangle and
+// the camera change at most once per snapshot however fast the mouse reports.
+void applyPendingInput() {
+    if (!pendingInput.cursorMoved && pendingInput.clickCount == 0 && pendingInput.scroll == 0) {
+        return;
+    }
+    // the user takes over
+    if (pendingInput.clickCount > 0 || pendingInput.scroll != 0) {
+        autoZooming = 0;
+        autoZoomSearchWanted = 0;
+        autoZoomSearchAgain = 0;
+    }
+    applyPendingClicks();
+    if (pendingInput.cursorMoved) {
+        moveZoomRectangleCorner(pendingInput.cursorX, pendingInput.cursorY);
+        if (panning) {
+            panTo(pendingInput.cursorX, pendingInput.cursorY);
+        }
+    }
+    if (pendingInput.scroll != 0) {
+        zoomAt(pendingInput.cursorX, pendingInput.cursorY, pendingInput.scroll);
+    }
+    calculateZoomRectangleCoords();
+    pendingInput.cursorMoved = 0;
+    pendingInput.scroll = 0;
+}
+
+// Search thread.
+void* searchAutoZoomTarget(void* arg) {
+    auto_zoom_search* search = arg;
+    search->found =
+        periodic_point_find(search->center, search->width, search->height, search->maxPeriod, &search->point);
+    __atomic_store_n(&search->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Starts looking for the nucleus of the lowest period in the window, or a Misiurewicz point, to auto zoom towards.
+void startAutoZoom() {
+    if (fractalParams.formula != FORMULA_MANDELBROT) {
+        printf("Auto zoom only finds nuclei of %s\n", formula_get(FORMULA_MANDELBROT)->name);
+        return;
+    }
+    double shorter = fmin(windowWidth, windowHeight);
+    autoZoomSearch = (auto_zoom_search){{dd_from_double(cameraCenter[0]), dd_from_double(cameraCenter[1])},
+                                        cameraSize * windowWidth / shorter,
+                                        cameraSize * windowHeight / shorter,
+                                        fractalParams.max_iter,
+                                        cameraSize};
+    if (pthread_create(&autoZoomSearchThread, NULL, searchAutoZoomTarget, &autoZoomSearch) != 0) {
+        printf("Failed to start looking for a nucleus\n");
+        return;
+    }
+    autoZoomSearching = 1;
+    autoZoomSearchWanted = 1;
+}
+
+// Once the search is done, starts the glide to what it found.
+void finishAutoZoomSearch() {
+    if (!autoZoomSearching || !__atomic_load_n(&autoZoomSearch.done, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    pthread_join(autoZoomSearchThread, NULL);
+    autoZoomSearching = 0;
+    if (autoZoomSearchAgain) {
+        autoZoomSearchAgain = 0;
+        startAutoZoom();
+        return;
+    }
+    if (!autoZoomSearchWanted) {
+        return;
+    }
+    if (!autoZoomSearch.found) {
+        printf("No nucleus or Misiurewicz point up to period %d in view\n", autoZoomSearch.maxPeriod);
+        return;
+    }
+    periodic_point point = autoZoomSearch.point;
+    autoZoomCenter[0] = dd_to_double(point.c[0]);
+    autoZoomCenter[1] = dd_to_double(point.c[1]);
+    autoZoomSize = point.preperiod == 0 ? point.size * AUTO_ZOOM_MINIBROT_RADII
+                                        : autoZoomSearch.size / AUTO_ZOOM_MISIUREWICZ_DEPTH;
+    autoZoomSize = fmax(autoZoomSize, hypot(autoZoomCenter[0], autoZoomCenter[1]) * AUTO_ZOOM_MIN_RELATIVE_SIZE);
+    // never zooms out, a minibrot bigger than the window is only centered
+    autoZoomSize = fmin(autoZoomSize, cameraSize);
+    autoZooming = 1;
+    if (point.preperiod == 0) {
+        printf("Zooming into the period %d nucleus at %.17g %.17g\n", point.period, autoZoomCenter[0],
+               autoZoomCenter[1]);
     } else {
-        printf("Failed to start GLFW context\n");
-        return -1;
+        printf("Zooming into the Misiurewicz point of preperiod %d, period %d at %.17g %.17g\n", point.preperiod,
+               point.period, autoZoomCenter[0], autoZoomCenter[1]);
     }
+}
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-    glfwWindowHint(GLFW_RESIZABLE, GL_FALSE);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+// One tick of the auto zoom.
+void stepAutoZoom() {
+    if (!autoZooming) {
+        return;
+    }
+    cameraCenter[0] += (autoZoomCenter[0] - cameraCenter[0]) * AUTO_ZOOM_CENTERING;
+    cameraCenter[1] += (autoZoomCenter[1] - cameraCenter[1]) * AUTO_ZOOM_CENTERING;
+    cameraSize = fmax(cameraSize * AUTO_ZOOM_FACTOR, autoZoomSize);
+    if (cameraSize == autoZoomSize) {
+        cameraCenter[0] = autoZoomCenter[0];
+        cameraCenter[1] = autoZoomCenter[1];
+        autoZooming = 0;
+    }
+    lastInteraction = glfwGetTime();
+    TRACE_INSTANT("camera", "x,y,size", cameraCenter[0], cameraCenter[1], cameraSize);
+}
 
-    GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "didedoshka's fractal", NULL, NULL);
-    glfwMakeContextCurrent(window);
-    if (window) {
-        printf("Created GLFW window\n");
+void framebufferSizeCallback(GLFWwindow* window, int width, int height) {
+    framebufferWidth = width;
+    framebufferHeight = height;
+}
+
+void windowSizeCallback(GLFWwindow* window, int width, int height) {
+    windowWidth = width;
+    windowHeight = height;
+}
+
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (action != GLFW_PRESS && action != GLFW_REPEAT) {
+        return;
+    }
+    TRACE_INSTANT("key", "key", key, 0, 0);
+    if (GLFW_KEY_1 <= key && key < GLFW_KEY_1 + FORMULA_COUNT) {
+        coloring_id coloring = fractalParams.coloring;
+        fractal_params_default(&fractalParams, key - GLFW_KEY_1);
+        fractalParams.coloring = coloring;
+    } else if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+        fractalParams.coloring = (fractalParams.coloring + 1) % COLORING_COUNT;
+    } else if (key == GLFW_KEY_LEFT_BRACKET) {
+        statisticDensity /= 2;
+    } else if (key == GLFW_KEY_RIGHT_BRACKET) {
+        statisticDensity *= 2;
+    } else if (key == GLFW_KEY_H && action == GLFW_PRESS) {
+        showHud = !showHud;
+    } else if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+        ++screenshotRequests;
+    } else if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+        if (autoZooming) {
+            autoZooming = 0;
+        } else if (autoZoomSearching && autoZoomSearchWanted) {
+            autoZoomSearchWanted = 0;
+        } else if (autoZoomSearching) {
+            // the running search is for a view that may be gone, look again once it is done
+            autoZoomSearchAgain = 1;
+        } else {
+            startAutoZoom();
+        }
+    } else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+        if (recordDirectory) {
+            recording = !recording;
+            printf(recording ? "Recording to %s\n" : "Stopped recording to %s\n", recordDirectory);
+        } else {
+            printf("Start with --record DIR to record\n");
+        }
+    } else if (formula_get(fractalParams.formula)->has_power) {
+        if (key == GLFW_KEY_UP && fractalParams.power < MAX_POWER) {
+            ++fractalParams.power;
+        } else if (key == GLFW_KEY_DOWN && fractalParams.power > MIN_POWER) {
+            --fractalParams.power;
+        }
+    }
+}
+
+// Compiles path with the kernel specialized for the snapshot's parameters spliced in, 0 on failure.
+GLuint buildKernelProgram(const char* path, const char* extraDefines) {
+    char* fragmentShaderSource = build_fragment_shader_source(path, &snapshot.params, extraDefines);
+    if (!fragmentShaderSource) {
+        return 0;
+    }
+    GLuint program = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    free(fragmentShaderSource);
+    return program;
+}
+
+// Compiles the tile drawing shader and the engine rendering missing tiles for the snapshot's parameters.
+int useTilePrograms() {
+    if (tileProgram) {
+        glDeleteProgram(tileProgram);
+        gpu_engine_destroy(&tileEngine);
+    }
+    tileProgram = buildKernelProgram(TILE_SHADER_PATH, NULL);
+    if (!tileProgram || !gpu_engine_init(&tileEngine, &snapshot.params, TILE_PIXELS)) {
+        return 0;
+    }
+    tileCameraCornerLocation = glGetUniformLocation(tileProgram, "camera_corner");
+    tileCameraPixelLocation = glGetUniformLocation(tileProgram, "camera_pixel");
+    tileLocation = glGetUniformLocation(tileProgram, "tile");
+    tileCornerLocation = glGetUniformLocation(tileProgram, "tile_corner");
+    tileWidthLocation = glGetUniformLocation(tileProgram, "tile_width");
+    return 1;
+}
+
+// Compiles the fractal and color passes specialized for the snapshot's parameters, keeping the old programs if
+// compilation fails.
+int useShaderProgram() {
+    GLuint fractal = buildKernelProgram(FRAGMENT_SHADER_PATH, "#define OUTPUT_ITERATIONS\n");
+    GLuint color = fractal ? buildKernelProgram(COLOR_SHADER_PATH, NULL) : 0;
+    if (!color) {
+        glDeleteProgram(fractal);
+        return 0;
+    }
+    if (fractalProgram) {
+        glDeleteProgram(fractalProgram);
+        glDeleteProgram(colorProgram);
+    }
+    fractalProgram = fractal;
+    colorProgram = color;
+    cameraChanged = 1;
+    printf("Using %s, power %d, colored by %s\n", formula_get(snapshot.params.formula)->name, snapshot.params.power,
+           coloring_name(snapshot.params.coloring));
+
+    cameraCornerLocation = glGetUniformLocation(fractalProgram, "camera_corner");
+    cameraPixelLocation = glGetUniformLocation(fractalProgram, "camera_pixel");
+    iterationsLocation = glGetUniformLocation(colorProgram, "iterations");
+    statisticDensityLocation = glGetUniformLocation(colorProgram, "statistic_density");
+    return !tileCache || useTilePrograms();
+}
+
+int useOverlayProgram() {
+    char* fragmentShaderSource = load_shader_from_file(OVERLAY_SHADER_PATH);
+    if (!fragmentShaderSource) {
+        return 0;
+    }
+    overlayProgram = create_shader_program(vertexShaderSource, fragmentShaderSource);
+    free(fragmentShaderSource);
+    if (!overlayProgram) {
+        return 0;
+    }
+    zoomRectangleLeftLocation = glGetUniformLocation(overlayProgram, "zoom_rectangle_left_x");
+    zoomRectangleUpLocation = glGetUniformLocation(overlayProgram, "zoom_rectangle_up_y");
+    zoomRectangleRightLocation = glGetUniformLocation(overlayProgram, "zoom_rectangle_right_x");
+    zoomRectangleDownLocation = glGetUniformLocation(overlayProgram, "zoom_rectangle_down_y");
+    return 1;
+}
+
+// Float target the fractal pass renders into, with mipmaps so frame_stats can average it on the GPU.
+void createFractalTarget() {
+    glGenTextures(1, &fractalTexture);
+    glBindTexture(GL_TEXTURE_2D, fractalTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glGenFramebuffers(1, &fractalFramebuffer);
+}
+
+// Reallocates the fractal target for the current framebuffer size, render scale and level.
+void resizeFractalTarget() {
+    float scale = renderScale * powf(M_SQRT1_2, renderLevel);
+    renderWidth = fmax(1, roundf(snapshot.framebufferWidth * scale));
+    renderHeight = fmax(1, roundf(snapshot.framebufferHeight * scale));
+    glBindTexture(GL_TEXTURE_2D, fractalTexture);
+    if (snapshot.params.coloring == COLORING_ITERATIONS) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, renderWidth, renderHeight, 0, GL_RG, GL_FLOAT, NULL);
     } else {
-        printf("Failed to create GLFW window\n");
-        glfwTerminate();
-        return -1;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, renderWidth, renderHeight, 0, GL_RGBA, GL_FLOAT, NULL);
     }
+    glGenerateMipmap(GL_TEXTURE_2D);
 
+    glBindFramebuffer(GL_FRAMEBUFFER, fractalFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fractalTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    cameraChanged = 1;
+}
+
+// Picks the render level for this frame from the measured cost of the fractal pass per pixel.
+void chooseRenderLevel() {
+    int level = 0;
+    if (glfwGetTime() - snapshot.lastInteraction < INTERACTION_IDLE_SECONDS && frameStats.nanosecondsPerPixel > 0) {
+        double pixels = snapshot.framebufferWidth * renderScale * snapshot.framebufferHeight * renderScale;
+        double milliseconds = frameStats.nanosecondsPerPixel * pixels / 1e6;
+        while (level < RENDER_LEVELS - 1 && milliseconds / (1 << level) > FRAME_BUDGET_MILLISECONDS) {
+            ++level;
+        }
+        while (level < renderLevel && milliseconds / (1 << level) > FRAME_BUDGET_MILLISECONDS * FINER_LEVEL_MARGIN) {
+            ++level;
+        }
+    }
+    if (level != renderLevel) {
+        renderLevel = level;
+        resizeFractalTarget();
+        TRACE_INSTANT("render level", "level,width,height", renderLevel, renderWidth, renderHeight);
+    }
+}
+
+void renderFractalPass() {
+    fractal_view view = renderView();
+    glBindFramebuffer(GL_FRAMEBUFFER, fractalFramebuffer);
+    glViewport(0, 0, renderWidth, renderHeight);
+    glUseProgram(fractalProgram);
+    glUniform2f(cameraCornerLocation, view.corner[0], view.corner[1]);
+    glUniform1f(cameraPixelLocation, view.width / renderWidth);
+
+    TRACE_BEGIN("fractal pass");
+    frame_stats_begin_pass(&frameStats, PASS_FRACTAL);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    frame_stats_end_pass(&frameStats);
+    TRACE_END("fractal pass");
+
+    frame_stats_count_iterations(&frameStats, fractalTexture, renderWidth, renderHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// The fractal pass from tiles of the cache. Returns 0 without drawing anything if the view can't be tiled: it
+// leaves the quadtree or is deeper than the tiles the GPU engine renders in single precision.
+int renderTiledFractalPass() {
+    fractal_view view = renderView();
+    double pixel = view.width / renderWidth;
+    int level = tile_level_for_pixel(pixel);
+    double tileWidth = ldexp(TILE_ROOT_WIDTH, -level);
+    double rootLeft = TILE_ROOT_CENTER_X - TILE_ROOT_WIDTH / 2;
+    double rootBottom = TILE_ROOT_CENTER_Y - TILE_ROOT_WIDTH / 2;
+    int64_t firstX = floor((view.corner[0] - rootLeft) / tileWidth);
+    int64_t firstY = floor((view.corner[1] - rootBottom) / tileWidth);
+    int64_t lastX = floor((view.corner[0] + pixel * renderWidth - rootLeft) / tileWidth);
+    int64_t lastY = floor((view.corner[1] + pixel * renderHeight - rootBottom) / tileWidth);
+    if (level > TILE_MAX_FLOAT_LEVEL || firstX < 0 || firstY < 0 || lastX >= (1LL << level) ||
+        lastY >= (1LL << level)) {
+        return 0;
+    }
+
+    static int iterations[TILE_PIXELS * TILE_PIXELS];
+    static int executed[TILE_PIXELS * TILE_PIXELS];
+    static float texels[TILE_PIXELS * TILE_PIXELS];
+    GLint vertexArray;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+    TRACE_BEGIN("tiled fractal pass");
+    frame_stats_begin_pass(&frameStats, PASS_FRACTAL);
+    // executed by the tiles rendered, counted like the fractal pass does
+    double renderedIterations = 0;
+    for (int64_t y = firstY; y <= lastY; ++y) {
+        for (int64_t x = firstX; x <= lastX; ++x) {
+            tile_key key;
+            fractal_view tileView;
+            tile_key_init(&key, &snapshot.params, level, x, y);
+            tile_key_view(&key, &tileView);
+            if (!tile_cache_get(tileCache, &key, iterations)) {
+                TRACE_INSTANT("tile miss", "level,x,y", level, x, y);
+                gpu_engine_render_executed(&tileEngine, &tileView, TILE_PIXELS, TILE_PIXELS, iterations, executed);
+                tile_cache_put(tileCache, &key, iterations);
+                for (int i = 0; i < TILE_PIXELS * TILE_PIXELS; ++i) {
+                    renderedIterations += executed[i];
+                }
+            }
+            for (int i = 0; i < TILE_PIXELS * TILE_PIXELS; ++i) {
+                texels[i] = iterations[i];
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, fractalFramebuffer);
+            glViewport(0, 0, renderWidth, renderHeight);
+            glBindVertexArray(vertexArray);
+            glUseProgram(tileProgram);
+            glUniform2f(tileCameraCornerLocation, view.corner[0], view.corner[1]);
+            glUniform1f(tileCameraPixelLocation, pixel);
+            glUniform2f(tileCornerLocation, tileView.corner[0], tileView.corner[1]);
+            glUniform1f(tileWidthLocation, tileView.width);
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, tileTexture);
+            glUniform1i(tileLocation, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILE_PIXELS, TILE_PIXELS, GL_RED, GL_FLOAT, texels);
+
+            // only touch the pixels of this tile, the shader discards the partially covered ones outside it
+            int left = floor((tileView.corner[0] - view.corner[0]) / pixel);
+            int bottom = floor((tileView.corner[1] - view.corner[1]) / pixel);
+            int size = ceil(tileView.width / pixel) + 2;
+            glEnable(GL_SCISSOR_TEST);
+            glScissor(left, bottom, size, size);
+            glDrawArrays(GL_TRIANGLES, 0, 6);
+            glDisable(GL_SCISSOR_TEST);
+        }
+    }
+    frame_stats_end_pass(&frameStats);
+    TRACE_END("tiled fractal pass");
+
+    frame_stats_set_iterations(&frameStats, renderedIterations, renderWidth, renderHeight);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return 1;
+}
+
+void renderColorPass() {
+    glViewport(0, 0, snapshot.framebufferWidth, snapshot.framebufferHeight);
+    glUseProgram(colorProgram);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, fractalTexture);
+    glUniform1i(iterationsLocation, 0);
+    glUniform1f(statisticDensityLocation, snapshot.statisticDensity);
+
+    TRACE_BEGIN("color pass");
+    frame_stats_begin_pass(&frameStats, PASS_COLOR);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    frame_stats_end_pass(&frameStats);
+    TRACE_END("color pass");
+}
+
+void renderOverlayPass() {
+    glUseProgram(overlayProgram);
+    sendZoomRectangleCoords();
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    TRACE_BEGIN("overlay pass");
+    frame_stats_begin_pass(&frameStats, PASS_OVERLAY);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    frame_stats_end_pass(&frameStats);
+    TRACE_END("overlay pass");
+
+    glDisable(GL_BLEND);
+}
+
+void updateHud(precision_tier needed) {
+    char line[HUD_COLUMNS + 1];
+    snprintf(line, sizeof(line), "FRACTAL GPU %.2f MS", frameStats.gpuMilliseconds[PASS_FRACTAL]);
+    hud_set_line(&statsHud, 0, line);
+    snprintf(line, sizeof(line), "COLOR GPU %.2f MS", frameStats.gpuMilliseconds[PASS_COLOR]);
+    hud_set_line(&statsHud, 1, line);
+    snprintf(line, sizeof(line), "OVERLAY GPU %.2f MS", frameStats.gpuMilliseconds[PASS_OVERLAY]);
+    hud_set_line(&statsHud, 2, line);
+    snprintf(line, sizeof(line), "CPU %.2f MS", frameStats.cpuMilliseconds);
+    hud_set_line(&statsHud, 3, line);
+    snprintf(line, sizeof(line), "%.1f M ITERATIONS/S", frameStats.iterationsPerSecond / 1e6);
+    hud_set_line(&statsHud, 4, line);
+    // the viewer always renders in float, say so when the view is past what float can resolve
+    if (needed == PRECISION_FLOAT) {
+        snprintf(line, sizeof(line), "PRECISION FLOAT");
+    } else {
+        snprintf(line, sizeof(line), "PRECISION FLOAT (NEEDS %s)", precision_tier_name(needed));
+    }
+    hud_set_line(&statsHud, 5, line);
+    snprintf(line, sizeof(line), "RESOLUTION %dX%d", renderWidth, renderHeight);
+    hud_set_line(&statsHud, 6, line);
+    long dropped = readback_dropped(frameReadback);
+    if (snapshot.recording) {
+        snprintf(line, sizeof(line), "RECORDING (%ld DROPPED)", dropped - droppedBeforeRecording);
+    } else if (dropped) {
+        snprintf(line, sizeof(line), "%ld FRAMES DROPPED", dropped);
+    } else {
+        line[0] = 0;
+    }
+    hud_set_line(&statsHud, 7, line);
+}
+
+void writePng(const char* path, const readback_frame* frame) {
+    // PNG rows go from the top
+    int stride = frame->width * 3;
+    unsigned char* flipped = malloc((size_t)stride * frame->height);
+    for (int row = 0; row < frame->height; ++row) {
+        memcpy(flipped + (size_t)row * stride, frame->rgb + (size_t)(frame->height - 1 - row) * stride, stride);
+    }
+    size_t size;
+    unsigned char* png = png_encode_rgb(flipped, frame->width, frame->height, &size);
+    FILE* file = fopen(path, "wb");
+    if (!file || fwrite(png, 1, size, file) != size) {
+        fprintf(stderr, "Couldn't write %s\n", path);
+    }
+    if (file) {
+        fclose(file);
+    }
+    free(png);
+    free(flipped);
+}
+
+void writeScreenshot(const readback_frame* frame, void* context) {
+    char path[64];
+    time_t now = time(NULL);
+    size_t length = strftime(path, sizeof(path), "screenshot-%Y%m%d-%H%M%S", localtime(&now));
+    snprintf(path + length, sizeof(path) - length, "-%ld.png", frame->sequence);
+    writePng(path, frame);
+    printf("Saved %s\n", path);
+}
+
+void writeRecordedFrame(const readback_frame* frame, void* context) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/frame_%06ld.png", recordDirectory, frame->sequence);
+    writePng(path, frame);
+}
+
+// Main thread. Zeroed first, so two snapshots of the same state compare equal with memcmp.
+void takeSnapshot(camera_snapshot* next) {
+    memset(next, 0, sizeof(*next));
+    next->center[0] = cameraCenter[0];
+    next->center[1] = cameraCenter[1];
+    next->size = cameraSize;
+    next->params = fractalParams;
+    next->statisticDensity = statisticDensity;
+    next->drawZoomRectangle = drawZoomRectangle;
+    next->zoomRectangleLeft = zoomRectangleLeft;
+    next->zoomRectangleUp = zoomRectangleUp;
+    next->zoomRectangleRight = zoomRectangleRight;
+    next->zoomRectangleDown = zoomRectangleDown;
+    next->framebufferWidth = framebufferWidth;
+    next->framebufferHeight = framebufferHeight;
+    next->lastInteraction = lastInteraction;
+    next->showHud = showHud;
+    next->recording = recording;
+    next->screenshots = screenshotRequests;
+}
+
+// Render thread. Switches to the latest snapshot in the queue, if any, and redoes whatever it invalidates. Returns
+// whether a screenshot was asked for since the last one.
+int receiveSnapshot() {
+    camera_snapshot next;
+    int received = 0;
+    while (spsc_queue_pop(snapshots, &next)) {
+        received = 1;
+    }
+    if (!received) {
+        return 0;
+    }
+    TRACE_INSTANT("snapshot", "x,y,size", next.center[0], next.center[1], next.size);
+    int rebuild = memcmp(&next.params, &snapshot.params, sizeof(fractal_params)) != 0;
+    // the statistic needs a blue channel in the fractal target
+    int resize = next.framebufferWidth != snapshot.framebufferWidth ||
+                 next.framebufferHeight != snapshot.framebufferHeight ||
+                 next.params.coloring != snapshot.params.coloring;
+    if (next.center[0] != snapshot.center[0] || next.center[1] != snapshot.center[1] || next.size != snapshot.size) {
+        cameraChanged = 1;
+    }
+    int screenshot = next.screenshots != snapshot.screenshots;
+    if (next.recording && !snapshot.recording) {
+        droppedBeforeRecording = readback_dropped(frameReadback);
+    } else if (!next.recording && snapshot.recording) {
+        // frames still in the queue may be dropped after this, the HUD keeps counting them
+        long dropped = readback_dropped(frameReadback) - droppedBeforeRecording;
+        if (dropped) {
+            printf("%ld recorded frames dropped, the writer didn't keep up\n", dropped);
+        }
+    }
+    snapshot = next;
+    if (rebuild) {
+        useShaderProgram();
+    }
+    if (resize) {
+        resizeFractalTarget();
+    }
+    return screenshot;
+}
+
+typedef struct {
+    GLFWwindow* window;
+    const char* csvPath;
+} render_thread_args;
+
+// Makes the window's context current on this thread and renders the latest snapshot every frame until the window
+// closes. If setting up fails it closes the window, so the main thread stops waiting for events.
+void* renderThread(void* arg) {
+    render_thread_args* args = arg;
+    glfwMakeContextCurrent(args->window);
     if (gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         printf("Initialized OpenGL context\n");
     } else {
         printf("Failed to initialize OpenGL context\n");
-        return -1;
+        renderFailed = 1;
+        glfwSetWindowShouldClose(args->window, GLFW_TRUE);
+        glfwPostEmptyEvent();
+        return NULL;
     }
+    glViewport(0, 0, snapshot.framebufferWidth, snapshot.framebufferHeight);
 
-    GLint width, height;
-    glfwGetFramebufferSize(window, &width, &height);
-    glViewport(0, 0, width, height);
-
-    glfwSetCursorPosCallback(window, cursorPositionCallback);
-    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    if (tileCache) {
+        glGenTextures(1, &tileTexture);
+        glBindTexture(GL_TEXTURE_2D, tileTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, TILE_PIXELS, TILE_PIXELS, 0, GL_RED, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
 
     // build and compile our shader program
     // ------------------------------------
-    // vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    // check for shader compile errors
-    GLint success;
-    char infoLog[512];
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
-    }
-
-    // fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    char* fragmentShaderPath = "fragment_shader.glsl";
-    const char* fragmentShaderSource = load_shader_from_file(fragmentShaderPath);
-    if (!fragmentShaderSource) {
-        printf("Couln't load %s\n", fragmentShaderPath);
-        return -1;
-    }
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-    // check for shader compile errors
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        printf("ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
-        return -1;
-    }
-    // link shaders
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    // check for linking errors
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        printf("ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
-        return -1;
+    if (!useShaderProgram() || !useOverlayProgram() || !hud_init(&statsHud) ||
+        !frame_stats_init(&frameStats, args->csvPath) || !(frameReadback = readback_create())) {
+        renderFailed = 1;
+        glfwSetWindowShouldClose(args->window, GLFW_TRUE);
+        glfwPostEmptyEvent();
+        return NULL;
     }
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    free(fragmentShaderSource);
+    createFractalTarget();
+    resizeFractalTarget();
 
     // set up vertex data (and buffer(s)) and configure vertex attributes
     // ------------------------------------------------------------------
@@ -280,27 +983,234 @@ int main(void) {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    glUseProgram(shaderProgram);
+    double hudUpdated = 0;
+    // Game loop
+    while (!glfwWindowShouldClose(args->window)) {
+        int takeScreenshot = receiveSnapshot();
+        if (snapshot.framebufferWidth == 0 || snapshot.framebufferHeight == 0) {
+            // minimized, nothing to draw into
+            struct timespec tick = {0, INPUT_TICK_SECONDS * 1e9};
+            nanosleep(&tick, NULL);
+            continue;
+        }
+        double frameStart = glfwGetTime();
+        TRACE_BEGIN("frame");
+        frame_stats_begin_frame(&frameStats);
+        readback_poll(frameReadback);
+        chooseRenderLevel();
+        if (cameraChanged) {
+            cameraChanged = 0;
+            // tiles only pay off for views that stay on screen, not for the reduced levels while moving, and only
+            // hold iterations
+            if (!tileCache || renderLevel != 0 || snapshot.params.coloring != COLORING_ITERATIONS ||
+                !renderTiledFractalPass()) {
+                renderFractalPass();
+            }
+        }
+        renderColorPass();
+        // before the overlays, so they don't end up in the pictures
+        if (takeScreenshot) {
+            readback_capture(frameReadback, 0, 0, snapshot.framebufferWidth, snapshot.framebufferHeight,
+                             writeScreenshot, NULL);
+        }
+        if (snapshot.recording) {
+            readback_capture(frameReadback, 0, 0, snapshot.framebufferWidth, snapshot.framebufferHeight,
+                             writeRecordedFrame, NULL);
+        }
+        if (snapshot.drawZoomRectangle) {
+            renderOverlayPass();
+        }
+
+        fractal_view view = renderView();
+        precision_tier needed = precision_tier_for_view(&view, renderWidth);
+        if (snapshot.showHud) {
+            if (frameStart - hudUpdated >= HUD_REFRESH_SECONDS) {
+                hudUpdated = frameStart;
+                updateHud(needed);
+            }
+            TRACE_BEGIN("hud");
+            hud_draw(&statsHud, snapshot.framebufferHeight);
+            TRACE_END("hud");
+        }
+        // everything up to here is CPU work, swapping may wait for vsync
+        frame_stats_end_frame(&frameStats, (glfwGetTime() - frameStart) * 1e3, needed);
+        TRACE_END("frame");
 
-    cameraCornerLocation = glGetUniformLocation(shaderProgram, "camera_corner");
-    cameraWidthLocation = glGetUniformLocation(shaderProgram, "camera_width");
-    zoomRectangleLeftLocation = glGetUniformLocation(shaderProgram, "zoom_rectangle_left_x");
-    zoomRectangleUpLocation = glGetUniformLocation(shaderProgram, "zoom_rectangle_up_y");
-    zoomRectangleRightLocation = glGetUniformLocation(shaderProgram, "zoom_rectangle_right_x");
-    zoomRectangleDownLocation = glGetUniformLocation(shaderProgram, "zoom_rectangle_down_y");
-    drawZoomRectangleLocation = glGetUniformLocation(shaderProgram, "draw_zoom_rectangle");
+        glfwSwapBuffers(args->window);
+    }
 
-    glUniform2f(cameraCornerLocation, cameraCorner[0], cameraCorner[1]);
-    glUniform1f(cameraWidthLocation, cameraWidth);
+    readback_destroy(frameReadback);
+    frame_stats_destroy(&frameStats);
+    hud_destroy(&statsHud);
+    if (tileCache) {
+        gpu_engine_destroy(&tileEngine);
+    }
+    glfwMakeContextCurrent(NULL);
+    return NULL;
+}
 
-    // Game loop
-    while (!glfwWindowShouldClose(window)) {
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+void printUsage(const char* program) {
+    printf("usage: %s [FORMULA [POWER]] [options]\n"
+           "  --size WIDTH HEIGHT     initial window size (default %d %d)\n"
+           "  --scale F               render the fractal at this fraction of the window resolution (default 1)\n"
+           "  --csv FILE              log per frame GPU and CPU times there\n"
+           "  --trace FILE            record input and render passes there, for chrome://tracing\n"
+           "  --tile-cache DIR        keep rendered tiles there and draw still views from them\n"
+           "  --record DIR            r records every frame there as PNG\n"
+           "  --coloring NAME         iterations, trap_point, trap_line, trap_cross, stripe, triangle or\n"
+           "                          interior_distance\n"
+           "drag a square to zoom into it, scroll to zoom, drag with the middle button to pan, right click to reset,\n"
+           "1-%d to switch formulas, up/down to change the power, h to toggle the stats, p to take a screenshot,\n"
+           "n to zoom into the lowest period minibrot in view, c to cycle colorings, [ and ] to change their density\n",
+           program, WIDTH, HEIGHT, FORMULA_COUNT);
+}
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+int main(int argc, char** argv) {
+    const char* positional[2] = {NULL, NULL};
+    int positionalCount = 0;
+    const char* csvPath = NULL;
+    const char* tracePath = NULL;
+    const char* tileCachePath = NULL;
+    coloring_id coloring = COLORING_ITERATIONS;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--size") == 0 && i + 2 < argc) {
+            windowWidth = atoi(argv[++i]);
+            windowHeight = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--scale") == 0 && i + 1 < argc) {
+            renderScale = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (strcmp(argv[i], "--tile-cache") == 0 && i + 1 < argc) {
+            tileCachePath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordDirectory = argv[++i];
+        } else if (strcmp(argv[i], "--coloring") == 0 && i + 1 < argc) {
+            coloring = coloring_by_name(argv[++i]);
+            if (coloring == COLORING_COUNT) {
+                printf("Unknown coloring %s\n", argv[i]);
+                return -1;
+            }
+        } else if (argv[i][0] != '-' && positionalCount < 2) {
+            positional[positionalCount++] = argv[i];
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (windowWidth <= 0 || windowHeight <= 0 || renderScale <= 0 || renderScale > 1) {
+        printUsage(argv[0]);
+        return -1;
     }
 
+    formula_id formula = FORMULA_MANDELBROT;
+    if (positional[0]) {
+        formula = formula_by_name(positional[0]);
+        if (formula == FORMULA_COUNT) {
+            printf("Unknown formula %s, available:", positional[0]);
+            for (int i = 0; i < FORMULA_COUNT; ++i) {
+                printf(" %s", formula_get(i)->name);
+            }
+            printf("\n");
+            return -1;
+        }
+    }
+    fractal_params_default(&fractalParams, formula);
+    fractalParams.coloring = coloring;
+    if (positional[1]) {
+        fractalParams.power = fmax(MIN_POWER, fmin(MAX_POWER, atoi(positional[1])));
+    }
+
+    if (tracePath && !trace_start(tracePath)) {
+        return -1;
+    }
+
+    if (glfwInit()) {
+        printf("Started GLFW context, OpenGL 3.3\n");
+    } else {
+        printf("Failed to start GLFW context\n");
+        return -1;
+    }
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_RESIZABLE, GL_TRUE);
+    // HiDPI: sizes in screen coordinates, framebuffer in native pixels
+    glfwWindowHint(GLFW_SCALE_TO_MONITOR, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+
+    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "didedoshka's fractal", NULL, NULL);
+    if (window) {
+        printf("Created GLFW window\n");
+    } else {
+        printf("Failed to create GLFW window\n");
+        glfwTerminate();
+        return -1;
+    }
+
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+
+    glfwSetCursorPosCallback(window, cursorPositionCallback);
+    glfwSetMouseButtonCallback(window, mouseButtonCallback);
+    glfwSetKeyCallback(window, keyCallback);
+    glfwSetScrollCallback(window, scrollCallback);
+    glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+    glfwSetWindowSizeCallback(window, windowSizeCallback);
+
+    if (tileCachePath) {
+        tileCache = tile_cache_open(tileCachePath, TILE_CACHE_MEMORY_TILES);
+        if (!tileCache) {
+            return -1;
+        }
+    }
+
+    snapshots = spsc_queue_create(sizeof(camera_snapshot), SNAPSHOT_QUEUE_CAPACITY);
+    if (!snapshots) {
+        return -1;
+    }
+    // the render thread starts from this one, before anything is pushed
+    takeSnapshot(&snapshot);
+    camera_snapshot published;
+    memcpy(&published, &snapshot, sizeof(published));
+    render_thread_args renderArgs = {window, csvPath};
+    pthread_t renderer;
+    if (pthread_create(&renderer, NULL, renderThread, &renderArgs) != 0) {
+        printf("Failed to start the render thread\n");
+        return -1;
+    }
+
+    // input loop, the frames are rendered by renderThread
+    char unpublished = 0;
+    while (!glfwWindowShouldClose(window)) {
+        if (autoZooming || autoZoomSearching || unpublished) {
+            glfwWaitEventsTimeout(INPUT_TICK_SECONDS);
+        } else {
+            glfwWaitEvents();
+        }
+        applyPendingInput();
+        finishAutoZoomSearch();
+        stepAutoZoom();
+        camera_snapshot next;
+        takeSnapshot(&next);
+        if (unpublished || memcmp(&next, &published, sizeof(next)) != 0) {
+            // a full queue means the render thread is busy with a long frame, it gets the latest state next tick
+            unpublished = !spsc_queue_push(snapshots, &next);
+            memcpy(&published, &next, sizeof(next));
+        }
+    }
+
+    pthread_join(renderer, NULL);
+    if (autoZoomSearching) {
+        pthread_join(autoZoomSearchThread, NULL);
+    }
+    spsc_queue_destroy(snapshots);
+    if (tileCache) {
+        tile_cache_close(tileCache);
+    }
     glfwTerminate();
-    return 0;
+    trace_stop();
+    return renderFailed ? -1 : 0;
 }
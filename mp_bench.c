@@ -0,0 +1,188 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "deep_engine.h"
+#include "multiprecision.h"
+
+// Times reference orbits in plain double, double-double and the multiprecision numbers at several precisions, and
+// the products they spend their time in, and prints the results as JSON. The orbit is that of the period 3 nucleus,
+// which never escapes, so every precision runs all iterations. Their largest difference to the double-double orbit
+// shows that the faster arithmetic didn't lose digits.
+
+#define MAX_LIST 16
+#define NUCLEUS "-1.75487766624669276004950889635852"
+#define PRODUCTS 20000
+
+typedef struct {
+    int values[MAX_LIST];
+    int count;
+} int_list;
+
+void printUsage(const char* program) {
+    printf("usage: %s [options]\n"
+           "  --output FILE           write the JSON there instead of stdout\n"
+           "  --bits N,N,...          fractional bits (default 128,256,512,1024,2048,4000)\n"
+           "  --max-iter N            orbit length (default 100000)\n"
+           "  --repeat N              keep the fastest of N runs (default 1)\n",
+           program);
+}
+
+int parseIntList(char* text, int_list* list) {
+    list->count = 0;
+    for (char* item = strtok(text, ","); item; item = strtok(NULL, ",")) {
+        if (list->count == MAX_LIST || atoi(item) <= 0) {
+            return 0;
+        }
+        list->values[list->count++] = atoi(item);
+    }
+    return list->count > 0;
+}
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Same loop as reference_orbit_compute in plain double.
+void referenceOrbitDouble(double* z, double cx, double cy, int maxIter) {
+    double x = 0, y = 0;
+    for (int n = 0; n <= maxIter; ++n) {
+        z[2 * n] = x;
+        z[2 * n + 1] = y;
+        if (x * x + y * y >= 4.0) {
+            break;
+        }
+        double nextX = x * x - y * y + cx;
+        y = 2 * x * y + cy;
+        x = nextX;
+    }
+}
+
+double maxDifference(const double* a, const double* b, int maxIter) {
+    double difference = 0;
+    for (int n = 0; n <= 2 * maxIter + 1; ++n) {
+        difference = fmax(difference, fabs(a[n] - b[n]));
+    }
+    return difference;
+}
+
+int main(int argc, char** argv) {
+    const char* outputPath = NULL;
+    int_list bits = {{128, 256, 512, 1024, 2048, 4000}, 6};
+    int maxIter = 100000;
+    int repeat = 1;
+
+    for (int i = 1; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--output") == 0 && rest >= 1) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--bits") == 0 && rest >= 1 && parseIntList(argv[i + 1], &bits)) {
+            ++i;
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            maxIter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--repeat") == 0 && rest >= 1) {
+            repeat = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (maxIter <= 0) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    FILE* output = outputPath ? fopen(outputPath, "w") : stdout;
+    if (!output) {
+        printf("Couldn't open %s\n", outputPath);
+        return -1;
+    }
+
+    double* plain = malloc(((size_t)maxIter + 1) * 2 * sizeof(double));
+    double best = 0;
+    for (int k = 0; k < repeat || k == 0; ++k) {
+        double start = now();
+        referenceOrbitDouble(plain, atof(NUCLEUS), 0, maxIter);
+        double time = now() - start;
+        best = k == 0 || time < best ? time : best;
+    }
+    double doubleNs = best * 1e9 / maxIter;
+    fprintf(output, "{\n  \"max_iter\": %d,\n  \"results\": [", maxIter);
+    fprintf(output, "\n    {\"arithmetic\": \"double\", \"bits\": 53, \"ns_per_iteration\": %.2f, \"vs_double\": 1.00}",
+            doubleNs);
+
+    double_double center[2] = {{0, 0}, {0, 0}};
+    dd_parse(NUCLEUS, &center[0]);
+    reference_orbit reference;
+    for (int k = 0; k < repeat || k == 0; ++k) {
+        if (k > 0) {
+            reference_orbit_free(&reference);
+        }
+        double start = now();
+        if (!reference_orbit_compute(&reference, center, maxIter)) {
+            printf("No memory for orbits of %d iterations\n", maxIter);
+            return -1;
+        }
+        double time = now() - start;
+        best = k == 0 || time < best ? time : best;
+    }
+    fprintf(output,
+            ",\n    {\"arithmetic\": \"double_double\", \"bits\": 106, \"ns_per_iteration\": %.2f, "
+            "\"vs_double\": %.2f, \"max_difference\": %.3g}",
+            best * 1e9 / maxIter, best * 1e9 / maxIter / doubleNs, maxDifference(plain, reference.z, maxIter));
+
+    for (int b = 0; b < bits.count; ++b) {
+        int limbs = mp_limbs_for_bits(bits.values[b]);
+        mp_number mpCenter[2];
+        mp_parse(NUCLEUS, &mpCenter[0], limbs);
+        mp_from_double(&mpCenter[1], 0, limbs);
+        reference_orbit orbit;
+        for (int k = 0; k < repeat || k == 0; ++k) {
+            if (k > 0) {
+                reference_orbit_free(&orbit);
+            }
+            double start = now();
+            if (!reference_orbit_compute_mp(&orbit, mpCenter, maxIter)) {
+                printf("No memory for orbits of %d iterations\n", maxIter);
+                return -1;
+            }
+            double time = now() - start;
+            best = k == 0 || time < best ? time : best;
+        }
+        double difference = maxDifference(reference.z, orbit.z, maxIter);
+        reference_orbit_free(&orbit);
+
+        // products of the orbit's own numbers, chained so none can be left out
+        mp_number a = mpCenter[0], product;
+        double start = now();
+        for (int i = 0; i < PRODUCTS; ++i) {
+            mp_mul(&product, &a, &mpCenter[0]);
+            a.limb[0] ^= product.limb[0];
+        }
+        double mulNs = (now() - start) * 1e9 / PRODUCTS;
+        start = now();
+        for (int i = 0; i < PRODUCTS; ++i) {
+            mp_square(&product, &a);
+            a.limb[0] ^= product.limb[0];
+        }
+        double squareNs = (now() - start) * 1e9 / PRODUCTS;
+
+        fprintf(output,
+                ",\n    {\"arithmetic\": \"multiprecision\", \"bits\": %d, \"limbs\": %d, \"ns_per_iteration\": %.2f, "
+                "\"vs_double\": %.2f, \"max_difference\": %.3g, \"mul_ns\": %.2f, \"square_ns\": %.2f}",
+                (limbs - 1) * MP_LIMB_BITS, limbs, best * 1e9 / maxIter, best * 1e9 / maxIter / doubleNs,
+                difference, mulNs, squareNs);
+    }
+    fprintf(output, "\n  ]\n}\n");
+
+    reference_orbit_free(&reference);
+    free(plain);
+    if (output != stdout) {
+        fclose(output);
+    }
+    return 0;
+}
@@ -0,0 +1,404 @@
+#include "multiprecision.h"
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+int mp_limbs_for_bits(int bits) {
+    int limbs = 1 + (bits + MP_LIMB_BITS - 1) / MP_LIMB_BITS;
+    return limbs < 2 ? 2 : limbs > MP_MAX_LIMBS ? MP_MAX_LIMBS : limbs;
+}
+
+// Limb arrays of n limbs, least significant first. Additions return the carry, subtractions the borrow.
+
+static uint32_t add_limbs(uint32_t* result, const uint32_t* a, const uint32_t* b, int n) {
+    uint64_t carry = 0;
+    for (int i = 0; i < n; ++i) {
+        carry += (uint64_t)a[i] + b[i];
+        result[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+    return (uint32_t)carry;
+}
+
+static uint32_t sub_limbs(uint32_t* result, const uint32_t* a, const uint32_t* b, int n) {
+    uint64_t borrow = 0;
+    for (int i = 0; i < n; ++i) {
+        uint64_t difference = (uint64_t)a[i] - b[i] - borrow;
+        result[i] = (uint32_t)difference;
+        borrow = difference >> 63;
+    }
+    return (uint32_t)borrow;
+}
+
+static int compare_limbs(const uint32_t* a, const uint32_t* b, int n) {
+    for (int i = n - 1; i >= 0; --i) {
+        if (a[i] != b[i]) {
+            return a[i] < b[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+// |a - b| into result, returns 1 if a < b
+static int difference_limbs(uint32_t* result, const uint32_t* a, const uint32_t* b, int n) {
+    if (compare_limbs(a, b, n) < 0) {
+        sub_limbs(result, b, a, n);
+        return 1;
+    }
+    sub_limbs(result, a, b, n);
+    return 0;
+}
+
+// Adds the limbs into result from offset on, carrying up to its end.
+static void add_at(uint32_t* result, int resultLimbs, int offset, const uint32_t* limbs, int n) {
+    uint64_t carry = 0;
+    for (int i = offset; i < resultLimbs && (i - offset < n || carry); ++i) {
+        carry += (uint64_t)result[i] + (i - offset < n ? limbs[i - offset] : 0);
+        result[i] = (uint32_t)carry;
+        carry >>= 32;
+    }
+}
+
+// Products are summed in columns (product scanning): column k of a b is the sum of a_i b_(k - i). Its low and high
+// halves are summed apart, which can't overflow 64 bits for any MP_MAX_LIMBS, so the carries are only propagated
+// once per column. With b reversed the terms of a column are two contiguous runs of limbs, which suits SIMD.
+
+// Columns shorter than this are summed faster without the vectors' setup and horizontal sums
+#define SIMD_MIN_TERMS 8
+
+// Sums a[t] b[t] for t < n, the limbs widened to 64 bits, into *low and *high.
+static inline void sum_products(const uint64_t* a, const uint64_t* b, int n, uint64_t* low, uint64_t* high) {
+    uint64_t lowSum = 0, highSum = 0;
+    int t = 0;
+#if defined(__AVX2__)
+    if (n >= SIMD_MIN_TERMS) {
+        __m256i lows = _mm256_setzero_si256(), highs = _mm256_setzero_si256();
+        __m256i mask = _mm256_set1_epi64x(0xffffffff);
+        for (; t + 4 <= n; t += 4) {
+            __m256i product = _mm256_mul_epu32(_mm256_loadu_si256((const __m256i*)(a + t)),
+                                               _mm256_loadu_si256((const __m256i*)(b + t)));
+            lows = _mm256_add_epi64(lows, _mm256_and_si256(product, mask));
+            highs = _mm256_add_epi64(highs, _mm256_srli_epi64(product, 32));
+        }
+        uint64_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, lows);
+        _mm256_storeu_si256((__m256i*)(lanes + 4), highs);
+        lowSum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+        highSum = lanes[4] + lanes[5] + lanes[6] + lanes[7];
+    }
+#elif defined(__SSE2__)
+    if (n >= SIMD_MIN_TERMS) {
+        __m128i lows = _mm_setzero_si128(), highs = _mm_setzero_si128(), mask = _mm_set1_epi64x(0xffffffff);
+        for (; t + 2 <= n; t += 2) {
+            __m128i product = _mm_mul_epu32(_mm_loadu_si128((const __m128i*)(a + t)),
+                                            _mm_loadu_si128((const __m128i*)(b + t)));
+            lows = _mm_add_epi64(lows, _mm_and_si128(product, mask));
+            highs = _mm_add_epi64(highs, _mm_srli_epi64(product, 32));
+        }
+        uint64_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, lows);
+        _mm_storeu_si128((__m128i*)(lanes + 2), highs);
+        lowSum = lanes[0] + lanes[1];
+        highSum = lanes[2] + lanes[3];
+    }
+#endif
+    for (; t < n; ++t) {
+        uint64_t product = a[t] * b[t];
+        lowSum += (uint32_t)product;
+        highSum += product >> 32;
+    }
+    *low = lowSum;
+    *high = highSum;
+}
+
+static void widen(uint64_t* wide, const uint32_t* limbs, int n) {
+    for (int i = 0; i < n; ++i) {
+        wide[i] = limbs[i];
+    }
+}
+
+static void widen_reversed(uint64_t* reversed, const uint32_t* limbs, int n) {
+    for (int i = 0; i < n; ++i) {
+        reversed[n - 1 - i] = limbs[i];
+    }
+}
+
+// product[0 .. 2n) = a b
+static void multiply_columns(uint32_t* product, const uint32_t* a, const uint32_t* b, int n) {
+    uint64_t aWide[MP_MAX_LIMBS], bReversed[MP_MAX_LIMBS];
+    widen(aWide, a, n);
+    widen_reversed(bReversed, b, n);
+    uint64_t carry = 0;
+    for (int k = 0; k < 2 * n - 1; ++k) {
+        // i from first to last, b_(k - i) is bReversed[n - 1 - k + i]
+        int first = k < n ? 0 : k - n + 1, last = k < n ? k : n - 1;
+        uint64_t low, high;
+        sum_products(aWide + first, bReversed + n - 1 - k + first, last - first + 1, &low, &high);
+        carry += low;
+        product[k] = (uint32_t)carry;
+        carry = (carry >> 32) + high;
+    }
+    product[2 * n - 1] = (uint32_t)carry;
+}
+
+// product[0 .. 2n) = a^2: the products a_i a_j with i < j once, doubled, and the squares a_i^2
+static void square_columns(uint32_t* product, const uint32_t* a, int n) {
+    uint64_t wide[MP_MAX_LIMBS], reversed[MP_MAX_LIMBS];
+    widen(wide, a, n);
+    widen_reversed(reversed, a, n);
+    uint64_t carry = 0;
+    for (int k = 0; k < 2 * n - 1; ++k) {
+        // i from first while i < k - i
+        int first = k < n ? 0 : k - n + 1, count = (k + 1) / 2 - first;
+        uint64_t low = 0, high = 0;
+        if (count > 0) {
+            sum_products(wide + first, reversed + n - 1 - k + first, count, &low, &high);
+            low *= 2;
+            high *= 2;
+        }
+        if (k % 2 == 0) {
+            uint64_t square = wide[k / 2] * wide[k / 2];
+            low += (uint32_t)square;
+            high += square >> 32;
+        }
+        carry += low;
+        product[k] = (uint32_t)carry;
+        carry = (carry >> 32) + high;
+    }
+    product[2 * n - 1] = (uint32_t)carry;
+}
+
+static void multiply(uint32_t* product, const uint32_t* a, const uint32_t* b, int n);
+static void square(uint32_t* product, const uint32_t* a, int n);
+
+// With a = a1 B^h + a0 and b likewise, a b = a1 b1 B^2h + (a0 b1 + a1 b0) B^h + a0 b0, and the middle term is
+// a0 b0 + a1 b1 - (a0 - a1)(b0 - b1). The differences fit h limbs where sums would need a carry limb.
+// a1 and b1 are zero extended to h limbs.
+static void karatsuba(uint32_t* product, const uint32_t* a, const uint32_t* b, int n) {
+    int h = (n + 1) / 2, rest = n - h;
+    uint32_t a1[MP_MAX_LIMBS], b1[MP_MAX_LIMBS];
+    memcpy(a1, a + h, rest * sizeof(uint32_t));
+    memcpy(b1, b + h, rest * sizeof(uint32_t));
+    a1[h - 1] = rest < h ? 0 : a1[h - 1];
+    b1[h - 1] = rest < h ? 0 : b1[h - 1];
+
+    // a0 b0 and a1 b1 go straight to their places, a1 b1 only has 2 rest limbs
+    uint32_t high[2 * MP_MAX_LIMBS];
+    multiply(product, a, b, h);
+    multiply(high, a1, b1, h);
+    memcpy(product + 2 * h, high, 2 * rest * sizeof(uint32_t));
+
+    uint32_t aDifference[MP_MAX_LIMBS], bDifference[MP_MAX_LIMBS], cross[2 * MP_MAX_LIMBS];
+    int negative = difference_limbs(aDifference, a, a1, h) != difference_limbs(bDifference, b, b1, h);
+    multiply(cross, aDifference, bDifference, h);
+
+    uint32_t middle[2 * MP_MAX_LIMBS + 1];
+    middle[2 * h] = add_limbs(middle, product, high, 2 * h);
+    if (negative) {
+        middle[2 * h] += add_limbs(middle, middle, cross, 2 * h);
+    } else {
+        middle[2 * h] -= sub_limbs(middle, middle, cross, 2 * h);
+    }
+    add_at(product, 2 * n, h, middle, 2 * h + 1);
+}
+
+// Same as karatsuba with a = b, the middle term is a0^2 + a1^2 - (a0 - a1)^2.
+static void karatsuba_square(uint32_t* product, const uint32_t* a, int n) {
+    int h = (n + 1) / 2, rest = n - h;
+    uint32_t a1[MP_MAX_LIMBS];
+    memcpy(a1, a + h, rest * sizeof(uint32_t));
+    a1[h - 1] = rest < h ? 0 : a1[h - 1];
+
+    uint32_t high[2 * MP_MAX_LIMBS];
+    square(product, a, h);
+    square(high, a1, h);
+    memcpy(product + 2 * h, high, 2 * rest * sizeof(uint32_t));
+
+    uint32_t difference[MP_MAX_LIMBS], cross[2 * MP_MAX_LIMBS];
+    difference_limbs(difference, a, a1, h);
+    square(cross, difference, h);
+
+    uint32_t middle[2 * MP_MAX_LIMBS + 1];
+    middle[2 * h] = add_limbs(middle, product, high, 2 * h);
+    middle[2 * h] -= sub_limbs(middle, middle, cross, 2 * h);
+    add_at(product, 2 * n, h, middle, 2 * h + 1);
+}
+
+static void multiply(uint32_t* product, const uint32_t* a, const uint32_t* b, int n) {
+    if (n >= MP_KARATSUBA_THRESHOLD) {
+        karatsuba(product, a, b, n);
+    } else {
+        multiply_columns(product, a, b, n);
+    }
+}
+
+static void square(uint32_t* product, const uint32_t* a, int n) {
+    if (n >= MP_KARATSUBA_SQUARE_THRESHOLD) {
+        karatsuba_square(product, a, n);
+    } else {
+        square_columns(product, a, n);
+    }
+}
+
+// limbs /= divisor, truncating
+static void divide_small(uint32_t* limbs, int n, uint32_t divisor) {
+    uint64_t rest = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        uint64_t current = rest << 32 | limbs[i];
+        limbs[i] = (uint32_t)(current / divisor);
+        rest = current % divisor;
+    }
+}
+
+void mp_from_double(mp_number* result, double value, int limbs) {
+    memset(result, 0, sizeof(*result));
+    result->limbs = limbs;
+    result->negative = value < 0;
+    double rest = fabs(value);
+    // the 53 bits of a double take at most 3 limbs below the integer one, each step is exact
+    for (int i = limbs - 1; i >= 0 && rest > 0; --i) {
+        double whole = floor(rest);
+        result->limb[i] = (uint32_t)whole;
+        rest = ldexp(rest - whole, MP_LIMB_BITS);
+    }
+}
+
+double mp_to_double(const mp_number* a) {
+    // from the first limb in use, so that the differences of deep centers keep their digits
+    int top = a->limbs - 1;
+    while (top > 0 && a->limb[top] == 0) {
+        --top;
+    }
+    double value = 0;
+    for (int i = top; i >= 0 && i > top - 4; --i) {
+        value += ldexp(a->limb[i], -MP_LIMB_BITS * (a->limbs - 1 - i));
+    }
+    return a->negative ? -value : value;
+}
+
+void mp_set_limbs(mp_number* result, const mp_number* a, int limbs) {
+    mp_number copy = *a;
+    memset(result, 0, sizeof(*result));
+    result->limbs = limbs;
+    result->negative = copy.negative;
+    // the integer limbs line up, the fraction is cut off or carried on with zeros
+    for (int i = 0; i < limbs && i < copy.limbs; ++i) {
+        result->limb[limbs - 1 - i] = copy.limb[copy.limbs - 1 - i];
+    }
+}
+
+// k-th digit of the number, 0 outside its digits, which are followed by the point at point (-1 if none)
+static int digit_at(const char* digits, int count, int point, long k) {
+    if (k < 0 || k >= count) {
+        return 0;
+    }
+    return digits[point >= 0 && k >= point ? k + 1 : k] - '0';
+}
+
+int mp_parse(const char* text, mp_number* result, int limbs) {
+    const char* at = text;
+    int negative = *at == '-';
+    if (*at == '-' || *at == '+') {
+        ++at;
+    }
+    const char* digits = at;
+    int count = 0, point = -1;
+    for (; isdigit((unsigned char)*at) || (*at == '.' && point < 0); ++at) {
+        if (*at == '.') {
+            point = count;
+        } else {
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return 0;
+    }
+    long integerDigits = point < 0 ? count : point;
+    if (*at == 'e' || *at == 'E') {
+        int read = 0, exponent = 0;
+        if (sscanf(at + 1, "%d%n", &exponent, &read) == 1) {
+            integerDigits += exponent;
+            at += 1 + read;
+        }
+    }
+
+    uint64_t integer = 0;
+    for (long k = 0; k < integerDigits; ++k) {
+        integer = integer * 10 + digit_at(digits, count, point, k);
+        if (integer > UINT32_MAX) {
+            return 0;
+        }
+    }
+    // Horner's scheme from the last digit: f = (d + f) / 10, the integer limb holds d
+    memset(result, 0, sizeof(*result));
+    result->limbs = limbs;
+    for (long k = count - 1; k >= integerDigits; --k) {
+        result->limb[limbs - 1] = digit_at(digits, count, point, k);
+        divide_small(result->limb, limbs, 10);
+    }
+    result->limb[limbs - 1] = (uint32_t)integer;
+    result->negative = negative;
+    return (int)(at - text);
+}
+
+static void add_signed(mp_number* result, const mp_number* a, const mp_number* b, int bNegative) {
+    int n = a->limbs;
+    result->limbs = n;
+    if (a->negative == bNegative) {
+        result->negative = bNegative;
+        add_limbs(result->limb, a->limb, b->limb, n);
+    } else {
+        // the sign of the larger magnitude
+        int aNegative = a->negative;
+        result->negative = difference_limbs(result->limb, a->limb, b->limb, n) ? bNegative : aNegative;
+    }
+}
+
+void mp_add(mp_number* result, const mp_number* a, const mp_number* b) {
+    add_signed(result, a, b, b->negative);
+}
+
+void mp_sub(mp_number* result, const mp_number* a, const mp_number* b) {
+    add_signed(result, a, b, !b->negative);
+}
+
+// The full product has 2n limbs of which 2 are integer ones, the result keeps the n from the lower integer one down.
+void mp_mul(mp_number* result, const mp_number* a, const mp_number* b) {
+    int n = a->limbs;
+    uint32_t product[2 * MP_MAX_LIMBS];
+    multiply(product, a->limb, b->limb, n);
+    result->limbs = n;
+    result->negative = a->negative != b->negative;
+    memcpy(result->limb, product + n - 1, n * sizeof(uint32_t));
+}
+
+void mp_square(mp_number* result, const mp_number* a) {
+    int n = a->limbs;
+    uint32_t product[2 * MP_MAX_LIMBS];
+    square(product, a->limb, n);
+    result->limbs = n;
+    result->negative = 0;
+    memcpy(result->limb, product + n - 1, n * sizeof(uint32_t));
+}
+
+void mp_shift_left(mp_number* result, const mp_number* a, int shift) {
+    int n = a->limbs;
+    result->limbs = n;
+    result->negative = a->negative;
+    if (shift == 0) {
+        memmove(result->limb, a->limb, n * sizeof(uint32_t));
+        return;
+    }
+    for (int i = n - 1; i > 0; --i) {
+        result->limb[i] = a->limb[i] << shift | a->limb[i - 1] >> (MP_LIMB_BITS - shift);
+    }
+    result->limb[0] = a->limb[0] << shift;
+}
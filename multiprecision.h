@@ -0,0 +1,50 @@
+#ifndef MULTIPRECISION_H
+#define MULTIPRECISION_H
+
+#include <stdint.h>
+
+// Fixed point numbers of a fixed number of 32 bit limbs, for reference orbits deeper than double-double reaches.
+// The limbs are least significant first, the top one is the integer part and the others the fraction, so a number of
+// n limbs has 32 (n - 1) fractional bits. The sign is kept apart from the magnitude.
+//
+// Orbits stay below 2 before they escape, so the integer limb never overflows, which also makes every operation a
+// plain integer one: no exponents to align, no normalization. Results are truncated to the operands' precision, all
+// operands of an operation must have the same number of limbs.
+//
+// Products are where the time goes. Below the Karatsuba thresholds the limb products are summed in columns (with
+// SSE2/AVX2 when the target has them), and squares only compute the products of limbs i < j, once, and double them.
+// Above them Karatsuba splits the operands in halves and needs three half size products instead of four. Squares
+// already save half the products, so theirs is higher. Summing in columns carries once per column rather than once
+// per product, which puts both well above the textbook values.
+
+#define MP_MAX_LIMBS 128
+#define MP_LIMB_BITS 32
+#define MP_KARATSUBA_THRESHOLD 96
+#define MP_KARATSUBA_SQUARE_THRESHOLD 112
+
+typedef struct {
+    int limbs;
+    int negative;
+    uint32_t limb[MP_MAX_LIMBS];
+} mp_number;
+
+// Limbs needed for bits of fraction, at most MP_MAX_LIMBS.
+int mp_limbs_for_bits(int bits);
+
+void mp_from_double(mp_number* result, double value, int limbs);
+double mp_to_double(const mp_number* a);
+// a with another number of limbs, its fraction truncated or extended with zeros. result may be a.
+void mp_set_limbs(mp_number* result, const mp_number* a, int limbs);
+// Parses a decimal number like -1.7499999999999999999999999997e-1 to the full precision. Returns the number of
+// characters read, 0 if text doesn't start with a number or its integer part doesn't fit the integer limb.
+int mp_parse(const char* text, mp_number* result, int limbs);
+
+// The result may be one of the operands.
+void mp_add(mp_number* result, const mp_number* a, const mp_number* b);
+void mp_sub(mp_number* result, const mp_number* a, const mp_number* b);
+void mp_mul(mp_number* result, const mp_number* a, const mp_number* b);
+void mp_square(mp_number* result, const mp_number* a);
+// a 2^shift, for 0 <= shift < 32
+void mp_shift_left(mp_number* result, const mp_number* a, int shift);
+
+#endif
@@ -0,0 +1,247 @@
+#include "nucleus.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// Periods tried before giving up on a nucleus
+#define NUCLEUS_CANDIDATES 16
+#define MISIUREWICZ_CANDIDATES 16
+// relative precision of double-double, Newton's steps can't get any smaller
+#define DD_EPSILON 0x1p-100
+
+// z = z^2 + c
+static inline void step(double_double z[2], const double_double c[2]) {
+    double_double x = dd_add(dd_sub(dd_square(z[0]), dd_square(z[1])), c[0]);
+    z[1] = dd_add(dd_mul_double(dd_mul(z[0], z[1]), 2), c[1]);
+    z[0] = x;
+}
+
+// dz = 2 z dz + 1, the derivative of z by c
+static inline void step_derivative(double dz[2], const double_double z[2]) {
+    double x = dd_to_double(z[0]), y = dd_to_double(z[1]);
+    double dx = 2 * (x * dz[0] - y * dz[1]) + 1;
+    dz[1] = 2 * (x * dz[1] + y * dz[0]);
+    dz[0] = dx;
+}
+
+// c -= z / dz. Returns 0 if the step isn't finite, the size of the step in size.
+static int newton_step(double_double c[2], const double z[2], const double dz[2], double* size) {
+    double norm = dz[0] * dz[0] + dz[1] * dz[1];
+    double x = (z[0] * dz[0] + z[1] * dz[1]) / norm;
+    double y = (z[1] * dz[0] - z[0] * dz[1]) / norm;
+    if (!isfinite(x) || !isfinite(y)) {
+        return 0;
+    }
+    c[0] = dd_add_double(c[0], -x);
+    c[1] = dd_add_double(c[1], -y);
+    *size = hypot(x, y);
+    return 1;
+}
+
+static int converged(const double_double c[2], double size, double tolerance) {
+    return size <= tolerance || size <= hypot(c[0].hi, c[1].hi) * DD_EPSILON;
+}
+
+int nucleus_period(const double_double center[2], double radius, int maxPeriod) {
+    double_double z[2] = {{0, 0}, {0, 0}};
+    double r = 0;
+    for (int n = 1; n <= maxPeriod; ++n) {
+        // |(z + e)^2 - z^2| <= 2 |z| |e| + |e|^2, and c adds up to radius
+        r = r * (2 * hypot(z[0].hi, z[1].hi) + r) + radius;
+        step(z, center);
+        double size = hypot(z[0].hi, z[1].hi);
+        if (size - r > 2) {
+            return 0;
+        }
+        if (size <= r) {
+            return n;
+        }
+    }
+    return 0;
+}
+
+int nucleus_newton(double_double c[2], int period, double tolerance) {
+    for (int i = 0; i < NUCLEUS_NEWTON_STEPS; ++i) {
+        double_double z[2] = {{0, 0}, {0, 0}};
+        double dz[2] = {0, 0};
+        for (int n = 0; n < period; ++n) {
+            step_derivative(dz, z);
+            step(z, c);
+        }
+        double value[2] = {dd_to_double(z[0]), dd_to_double(z[1])};
+        double size;
+        if (!newton_step(c, value, dz, &size)) {
+            return 0;
+        }
+        if (converged(c, size, tolerance)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int misiurewicz_newton(double_double c[2], int preperiod, int period, double tolerance) {
+    for (int i = 0; i < NUCLEUS_NEWTON_STEPS; ++i) {
+        double_double z[2] = {{0, 0}, {0, 0}}, zq[2] = {{0, 0}, {0, 0}};
+        double dz[2] = {0, 0}, dzq[2] = {0, 0};
+        for (int n = 0; n < preperiod + period; ++n) {
+            if (n == preperiod) {
+                zq[0] = z[0];
+                zq[1] = z[1];
+                dzq[0] = dz[0];
+                dzq[1] = dz[1];
+            }
+            step_derivative(dz, z);
+            step(z, c);
+        }
+        // z_{q+p} - z_q and its derivative
+        double value[2] = {dd_to_double(dd_sub(z[0], zq[0])), dd_to_double(dd_sub(z[1], zq[1]))};
+        double derivative[2] = {dz[0] - dzq[0], dz[1] - dzq[1]};
+        double size;
+        if (!newton_step(c, value, derivative, &size)) {
+            return 0;
+        }
+        if (converged(c, size, tolerance)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The estimate of mandelbrot-numerics, from the derivative of the multiplier along the cycle.
+double nucleus_size(const double_double c[2], int period) {
+    double_double z[2] = {{0, 0}, {0, 0}};
+    double l[2] = {1, 0}, b[2] = {1, 0};
+    for (int n = 1; n < period; ++n) {
+        step(z, c);
+        double x = dd_to_double(z[0]), y = dd_to_double(z[1]);
+        double lx = 2 * (x * l[0] - y * l[1]);
+        l[1] = 2 * (x * l[1] + y * l[0]);
+        l[0] = lx;
+        double norm = l[0] * l[0] + l[1] * l[1];
+        b[0] += l[0] / norm;
+        b[1] -= l[1] / norm;
+    }
+    // 1 / (b l^2)
+    double l2[2] = {l[0] * l[0] - l[1] * l[1], 2 * l[0] * l[1]};
+    double denominator[2] = {b[0] * l2[0] - b[1] * l2[1], b[0] * l2[1] + b[1] * l2[0]};
+    return 1 / hypot(denominator[0], denominator[1]);
+}
+
+static int inside(const double_double c[2], const double_double center[2], double width, double height) {
+    return fabs(dd_to_double(dd_sub(c[0], center[0]))) <= width / 2 &&
+           fabs(dd_to_double(dd_sub(c[1], center[1]))) <= height / 2;
+}
+
+// Whether the orbit of c comes back to 0 within iterations, which makes it a nucleus.
+static int periodic(const double_double c[2], int iterations, double tolerance) {
+    double_double z[2] = {{0, 0}, {0, 0}};
+    for (int n = 0; n < iterations; ++n) {
+        step(z, c);
+        if (hypot(dd_to_double(z[0]), dd_to_double(z[1])) <= tolerance) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// The nuclei whose atom domains hold the center have the periods at which its orbit comes closer to 0 than ever
+// before. Their atom domains nest, so the higher the period, the closer the nucleus. Up to capacity of those
+// periods after the given one, returns their count.
+static int partial_periods(const double_double center[2], int after, int maxPeriod, int* periods, int capacity) {
+    double_double z[2] = {{0, 0}, {0, 0}};
+    double closest = INFINITY;
+    int count = 0;
+    for (int n = 1; n <= maxPeriod && count < capacity; ++n) {
+        step(z, center);
+        double size = hypot(z[0].hi, z[1].hi);
+        if (size > 2) {
+            break;
+        }
+        if (size < closest) {
+            closest = size;
+            if (n > after) {
+                periods[count++] = n;
+            }
+        }
+    }
+    return count;
+}
+
+// Newton from the center may lead to a nucleus outside the view, whose atom domain reaches into it. The ball period
+// is tried first, then the periods of the nuclei ever closer to the center.
+static int find_nucleus(const double_double center[2], double width, double height, int maxPeriod,
+                        periodic_point* found) {
+    int periods[NUCLEUS_CANDIDATES];
+    periods[0] = nucleus_period(center, hypot(width, height) / 2, maxPeriod);
+    int count = 1 + partial_periods(center, periods[0], maxPeriod, periods + 1, NUCLEUS_CANDIDATES - 1);
+    double tolerance = fmin(width, height) * 1e-12;
+    for (int i = periods[0] == 0; i < count; ++i) {
+        double_double c[2] = {center[0], center[1]};
+        if (nucleus_newton(c, periods[i], tolerance) && inside(c, center, width, height)) {
+            found->c[0] = c[0];
+            found->c[1] = c[1];
+            found->preperiod = 0;
+            found->period = periods[i];
+            found->size = nucleus_size(c, periods[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Guesses come from the orbit of the center: where z_{q+p} - z_q divided by its derivative, Newton's first step,
+// stays within the view, there is likely a Misiurewicz point of preperiod q and period p. They are tried with the
+// lowest q + p first.
+static int find_misiurewicz(const double_double center[2], double width, double height, int maxPeriod,
+                            periodic_point* found) {
+    int count = maxPeriod < MISIUREWICZ_MAX_ITER ? maxPeriod : MISIUREWICZ_MAX_ITER;
+    double* z = malloc((count + 1) * 4 * sizeof(double));
+    double* dz = z + 2 * (count + 1);
+    double_double orbit[2] = {{0, 0}, {0, 0}};
+    double derivative[2] = {0, 0};
+    int length = 0;
+    for (; length <= count; ++length) {
+        z[2 * length] = dd_to_double(orbit[0]);
+        z[2 * length + 1] = dd_to_double(orbit[1]);
+        dz[2 * length] = derivative[0];
+        dz[2 * length + 1] = derivative[1];
+        if (z[2 * length] * z[2 * length] + z[2 * length + 1] * z[2 * length + 1] > 4) {
+            break;
+        }
+        step_derivative(derivative, orbit);
+        step(orbit, center);
+    }
+
+    double radius = hypot(width, height) / 2;
+    double tolerance = fmin(width, height) * 1e-12;
+    int tries = 0, result = 0;
+    for (int total = 2; total < length && !result && tries < MISIUREWICZ_CANDIDATES; ++total) {
+        for (int q = 1; q < total && !result && tries < MISIUREWICZ_CANDIDATES; ++q) {
+            double x = z[2 * total] - z[2 * q], y = z[2 * total + 1] - z[2 * q + 1];
+            double dx = dz[2 * total] - dz[2 * q], dy = dz[2 * total + 1] - dz[2 * q + 1];
+            if (x * x + y * y > radius * radius * (dx * dx + dy * dy)) {
+                continue;
+            }
+            ++tries;
+            double_double c[2] = {center[0], center[1]};
+            result = misiurewicz_newton(c, q, total - q, tolerance) && inside(c, center, width, height) &&
+                     !periodic(c, total, tolerance);
+            if (result) {
+                found->c[0] = c[0];
+                found->c[1] = c[1];
+                found->preperiod = q;
+                found->period = total - q;
+                found->size = 0;
+            }
+        }
+    }
+    free(z);
+    return result;
+}
+
+int periodic_point_find(const double_double center[2], double width, double height, int maxPeriod,
+                        periodic_point* found) {
+    return find_nucleus(center, width, height, maxPeriod, found) ||
+           find_misiurewicz(center, width, height, maxPeriod, found);
+}
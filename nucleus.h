@@ -0,0 +1,48 @@
+#ifndef NUCLEUS_H
+#define NUCLEUS_H
+
+#include "double_double.h"
+
+// Finds the points of the Mandelbrot set that make the best references and zoom targets: the nucleus of the lowest
+// period in a view, the center of its largest minibrot, or failing that a Misiurewicz point, where the filaments
+// branch. Neither orbit ever escapes, so a reference there serves every pixel for all iterations.
+//
+// The period comes from iterating the whole view as a disk around its center (ball arithmetic): the first n at
+// which the disk of z_n contains 0 is the lowest period of any nucleus in it, give or take the disk overestimating.
+// Newton's method on z_p(c) = 0 then converges to the nucleus from the center of the view. If that one lies outside,
+// the periods at which the center's orbit comes ever closer to 0 lead to nuclei ever closer to the center.
+// Misiurewicz points solve z_{q+p}(c) = z_q(c) instead, the preperiod q and period p are guessed from where the
+// center's orbit comes closest to repeating itself.
+//
+// Everything is iterated in double-double, so the points are exact to the pixel down to the deepest views it tells
+// pixels apart in (see deep_view_limbs).
+
+#define NUCLEUS_NEWTON_STEPS 64
+#define MISIUREWICZ_MAX_ITER 256
+
+typedef struct {
+    double_double c[2];
+    // 0 for a nucleus
+    int preperiod;
+    int period;
+    // radius of the minibrot for a nucleus, 0 for a Misiurewicz point
+    double size;
+} periodic_point;
+
+// First n up to maxPeriod at which the disk of the given radius around center may hold a nucleus of period n.
+// Returns 0 if there is none, or if the whole disk escapes before.
+int nucleus_period(const double_double center[2], double radius, int maxPeriod);
+
+// Newton's method from c, until a step is below tolerance. Returns 0 if it doesn't converge.
+int nucleus_newton(double_double c[2], int period, double tolerance);
+int misiurewicz_newton(double_double c[2], int preperiod, int period, double tolerance);
+
+// Estimated radius of the minibrot at a nucleus of the period.
+double nucleus_size(const double_double c[2], int period);
+
+// The nucleus of the lowest period up to maxPeriod in the rectangle of width x height around center, or failing that
+// the Misiurewicz point of the lowest preperiod and period in it. Returns 0 if there is neither.
+int periodic_point_find(const double_double center[2], double width, double height, int maxPeriod,
+                        periodic_point* found);
+
+#endif
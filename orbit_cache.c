@@ -0,0 +1,306 @@
+#include "orbit_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    orbit_key key;
+    // the mapping, header first
+    orbit_file_header* header;
+    size_t size;
+} orbit_entry;
+
+typedef struct {
+    void* address;
+    size_t size;
+} mapping;
+
+struct orbit_cache {
+    char* directory;
+    pthread_mutex_t lock;
+    orbit_entry* entries;
+    int count;
+    int capacity;
+    // mappings replaced by bigger ones, the orbits handed out may still point into them
+    mapping* retired;
+    int retiredCount;
+    int retiredCapacity;
+    orbit_cache_stats stats;
+};
+
+static uint64_t key_hash(const orbit_key* key) {
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = (const unsigned char*)key;
+    for (size_t i = 0; i < sizeof(*key); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static size_t file_size(int length) {
+    return sizeof(orbit_file_header) + ((size_t)length + 1) * 2 * sizeof(double);
+}
+
+// Orbits with at least length iterations fit the mapping.
+static int mapped_length(const orbit_entry* entry) {
+    int length = __atomic_load_n(&entry->header->length, __ATOMIC_ACQUIRE);
+    int fits = (int)((entry->size - sizeof(orbit_file_header)) / (2 * sizeof(double))) - 1;
+    return length < fits ? length : fits;
+}
+
+static int covers(const orbit_entry* entry, int maxIter) {
+    // escaped is published after the length it goes with, so it is read first
+    int escaped = __atomic_load_n(&entry->header->escaped, __ATOMIC_ACQUIRE);
+    int length = mapped_length(entry);
+    return length >= maxIter || (escaped && length == __atomic_load_n(&entry->header->length, __ATOMIC_ACQUIRE));
+}
+
+// mkdir -p
+static int make_directories(const char* path) {
+    char* partial = strdup(path);
+    int result = 1;
+    for (char* slash = partial + 1;; ++slash) {
+        char end = *slash;
+        if (end != '/' && end != '\0') {
+            continue;
+        }
+        *slash = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST) {
+            result = 0;
+            break;
+        }
+        *slash = end;
+        if (end == '\0') {
+            break;
+        }
+    }
+    free(partial);
+    return result;
+}
+
+orbit_cache* orbit_cache_open(const char* directory) {
+    if (directory && !make_directories(directory)) {
+        fprintf(stderr, "Couldn't create %s\n", directory);
+        return NULL;
+    }
+    orbit_cache* cache = calloc(1, sizeof(orbit_cache));
+    cache->directory = directory ? strdup(directory) : NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void orbit_cache_close(orbit_cache* cache) {
+    for (int i = 0; i < cache->count; ++i) {
+        munmap(cache->entries[i].header, cache->entries[i].size);
+    }
+    for (int i = 0; i < cache->retiredCount; ++i) {
+        munmap(cache->retired[i].address, cache->retired[i].size);
+    }
+    free(cache->entries);
+    free(cache->retired);
+    free(cache->directory);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+// Carries the orbit in the mapping on up to maxIter. The state is only written back, and the length updated, once
+// the iterations are written, and escaped is only set after the length.
+static void extend(orbit_file_header* header, int maxIter) {
+    double* z = (double*)(header + 1);
+    orbit_point state = header->state;
+    int length;
+    if (header->key.limbs == 0) {
+        length = reference_orbit_continue(z, state.dd, header->key.center.dd, header->length, maxIter);
+    } else {
+        length = reference_orbit_continue_mp(z, state.mp, header->key.center.mp, header->length, maxIter);
+    }
+    header->state = state;
+    int escaped = length < maxIter || z[2 * length] * z[2 * length] + z[2 * length + 1] * z[2 * length + 1] >= 4;
+    __atomic_store_n(&header->length, length, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->escaped, escaped, __ATOMIC_RELEASE);
+}
+
+static void init_header(orbit_file_header* header, const orbit_key* key) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, ORBIT_FILE_MAGIC, sizeof(header->magic));
+    header->version = ORBIT_FILE_VERSION;
+    header->key = *key;
+    if (key->limbs > 0) {
+        // Z_0 = 0 to the center's precision
+        mp_from_double(&header->state.mp[0], 0, key->limbs);
+        header->state.mp[1] = header->state.mp[0];
+    }
+    ((double*)(header + 1))[0] = 0;
+    ((double*)(header + 1))[1] = 0;
+}
+
+// Maps the orbit's file, carrying it on under the lock if it is too short. Returns NULL (after printing why) if the
+// file can't be used.
+static orbit_file_header* map_file(orbit_cache* cache, const orbit_key* key, int maxIter, size_t* size) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%016llx.orbit", cache->directory, (unsigned long long)key_hash(key));
+    int file = open(path, O_RDWR | O_CREAT, 0644);
+    if (file < 0) {
+        fprintf(stderr, "Couldn't open %s\n", path);
+        return NULL;
+    }
+    // the lock goes with the descriptor, closing it unlocks
+    struct stat status;
+    if (flock(file, LOCK_EX) != 0 || fstat(file, &status) != 0) {
+        fprintf(stderr, "Couldn't lock %s\n", path);
+        close(file);
+        return NULL;
+    }
+
+    orbit_file_header header;
+    int fresh = status.st_size < (off_t)sizeof(header);
+    if (!fresh && (pread(file, &header, sizeof(header), 0) != sizeof(header) ||
+                   memcmp(header.magic, ORBIT_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+                   header.version != ORBIT_FILE_VERSION || memcmp(&header.key, key, sizeof(*key)) != 0 ||
+                   status.st_size < (off_t)file_size(header.length))) {
+        fprintf(stderr, "%s isn't the orbit it should be\n", path);
+        close(file);
+        return NULL;
+    }
+    int length = fresh ? 0 : header.length;
+    int extended = !fresh && !header.escaped && length < maxIter;
+    int needed = fresh || extended ? maxIter : length;
+    *size = file_size(needed);
+    if ((off_t)*size > status.st_size && ftruncate(file, *size) != 0) {
+        fprintf(stderr, "Couldn't extend %s\n", path);
+        close(file);
+        return NULL;
+    }
+    orbit_file_header* mapped = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (mapped == MAP_FAILED) {
+        fprintf(stderr, "Couldn't map %s\n", path);
+        close(file);
+        return NULL;
+    }
+    if (fresh) {
+        init_header(mapped, key);
+    }
+    if (fresh || extended) {
+        extend(mapped, maxIter);
+    }
+    // room for maxIter was only a guess, an orbit that escaped earlier gives the rest back (the mapping stays, but
+    // nothing reads past the length)
+    if (mapped->escaped && file_size(mapped->length) < *size && ftruncate(file, file_size(mapped->length)) != 0) {
+        fprintf(stderr, "Couldn't shrink %s\n", path);
+    }
+    close(file);
+    // another process may have computed it already
+    cache->stats.hits += !fresh && !extended;
+    cache->stats.extended += extended;
+    cache->stats.computed += fresh;
+    return mapped;
+}
+
+// Memory only: copies what the old mapping has and carries on from there.
+static orbit_file_header* map_memory(orbit_cache* cache, const orbit_key* key, const orbit_file_header* old,
+                                     int maxIter, size_t* size) {
+    *size = file_size(maxIter);
+    orbit_file_header* mapped = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+    if (old) {
+        memcpy(mapped, old, file_size(old->length));
+    } else {
+        init_header(mapped, key);
+    }
+    extend(mapped, maxIter);
+    cache->stats.extended += old != NULL;
+    cache->stats.computed += old == NULL;
+    return mapped;
+}
+
+static int get(orbit_cache* cache, reference_orbit* orbit, const orbit_key* key, int maxIter) {
+    pthread_mutex_lock(&cache->lock);
+    orbit_entry* entry = NULL;
+    for (int i = 0; i < cache->count && !entry; ++i) {
+        entry = memcmp(&cache->entries[i].key, key, sizeof(*key)) == 0 ? &cache->entries[i] : NULL;
+    }
+
+    if (entry && covers(entry, maxIter)) {
+        ++cache->stats.hits;
+    } else {
+        size_t size = 0;
+        orbit_file_header* mapped = cache->directory ? map_file(cache, key, maxIter, &size) : NULL;
+        if (!mapped) {
+            // carrying on needs the state of the last iteration mapped
+            int whole = entry && mapped_length(entry) == entry->header->length;
+            mapped = map_memory(cache, key, whole ? entry->header : NULL, maxIter, &size);
+        }
+        if (!mapped) {
+            pthread_mutex_unlock(&cache->lock);
+            fprintf(stderr, "No memory for a reference orbit of %d iterations\n", maxIter);
+            return 0;
+        }
+
+        if (!entry) {
+            if (cache->count == cache->capacity) {
+                cache->capacity = cache->capacity ? cache->capacity * 2 : 16;
+                cache->entries = realloc(cache->entries, cache->capacity * sizeof(orbit_entry));
+            }
+            entry = &cache->entries[cache->count++];
+            entry->key = *key;
+        } else {
+            if (cache->retiredCount == cache->retiredCapacity) {
+                cache->retiredCapacity = cache->retiredCapacity ? cache->retiredCapacity * 2 : 16;
+                cache->retired = realloc(cache->retired, cache->retiredCapacity * sizeof(mapping));
+            }
+            cache->retired[cache->retiredCount++] = (mapping){entry->header, entry->size};
+        }
+        entry->header = mapped;
+        entry->size = size;
+    }
+
+    int length = mapped_length(entry);
+    orbit->max_iter = maxIter;
+    orbit->length = length < maxIter ? length : maxIter;
+    orbit->z = (double*)(entry->header + 1);
+    orbit->cached = 1;
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+int orbit_cache_get(orbit_cache* cache, reference_orbit* orbit, const double_double center[2], int maxIter) {
+    orbit_key key;
+    memset(&key, 0, sizeof(key));
+    key.center.dd[0] = center[0];
+    key.center.dd[1] = center[1];
+    orbit->center[0] = center[0];
+    orbit->center[1] = center[1];
+    return get(cache, orbit, &key, maxIter);
+}
+
+int orbit_cache_get_mp(orbit_cache* cache, reference_orbit* orbit, const mp_number center[2], int maxIter) {
+    // only the limbs in use, so equal centers give equal keys
+    orbit_key key;
+    memset(&key, 0, sizeof(key));
+    key.limbs = center[0].limbs;
+    for (int i = 0; i < 2; ++i) {
+        key.center.mp[i].limbs = center[i].limbs;
+        key.center.mp[i].negative = center[i].negative;
+        memcpy(key.center.mp[i].limb, center[i].limb, center[i].limbs * sizeof(uint32_t));
+    }
+    orbit->center[0] = mp_to_double_double(&center[0]);
+    orbit->center[1] = mp_to_double_double(&center[1]);
+    return get(cache, orbit, &key, maxIter);
+}
+
+orbit_cache_stats orbit_cache_get_stats(orbit_cache* cache) {
+    pthread_mutex_lock(&cache->lock);
+    orbit_cache_stats stats = cache->stats;
+    pthread_mutex_unlock(&cache->lock);
+    return stats;
+}
@@ -0,0 +1,69 @@
+#ifndef ORBIT_CACHE_H
+#define ORBIT_CACHE_H
+
+#include <stdint.h>
+
+#include "deep_engine.h"
+#include "double_double.h"
+#include "multiprecision.h"
+
+// Cache of reference orbits, so zooming, panning and the frames of a video compute each orbit only once.
+//
+// An orbit is keyed by its center to the precision it is iterated with. It doesn't depend on the iteration limit:
+// asking for more iterations than are cached carries on from the last one, and any fewer are a prefix. Every orbit
+// is a memory mapped file in the directory, which other processes and later runs map as well. A file is only
+// extended under an exclusive lock, its length is updated after the iterations it covers and escaped after the
+// length, so readers never see iterations that aren't there yet. Orbits handed out stay valid until the cache is closed, extending one maps it
+// anew and keeps the old mapping. The cache can be shared between threads.
+
+#define ORBIT_FILE_MAGIC "FRACORBT"
+#define ORBIT_FILE_VERSION 1
+
+typedef union {
+    double_double dd[2];
+    mp_number mp[2];
+} orbit_point;
+
+typedef struct {
+    // 0 for double-double, the limbs of the mp_numbers otherwise
+    int32_t limbs;
+    int32_t reserved;
+    orbit_point center;
+} orbit_key;
+
+// Header of an orbit file, followed by Z_0 .. Z_length as pairs of doubles.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    // Z_length escaped, so the orbit is complete for any iteration limit
+    int32_t escaped;
+    int32_t length;
+    int32_t reserved;
+    orbit_key key;
+    // Z_length to the full precision, to carry on from
+    orbit_point state;
+} orbit_file_header;
+
+typedef struct {
+    // orbits that had all the iterations asked for
+    long hits;
+    // orbits that had to be carried on, and those computed from the start
+    long extended;
+    long computed;
+} orbit_cache_stats;
+
+typedef struct orbit_cache orbit_cache;
+
+// directory may be NULL for a memory only cache, it is created if missing. Returns NULL (after printing why) if the
+// directory can't be used.
+orbit_cache* orbit_cache_open(const char* directory);
+void orbit_cache_close(orbit_cache* cache);
+
+// Like reference_orbit_compute(_mp). The orbit's z belongs to the cache, reference_orbit_free leaves it alone.
+// Returns 0 if out of memory. A file that can't be used is only reported, the orbit is kept in memory then.
+int orbit_cache_get(orbit_cache* cache, reference_orbit* orbit, const double_double center[2], int maxIter);
+int orbit_cache_get_mp(orbit_cache* cache, reference_orbit* orbit, const mp_number center[2], int maxIter);
+
+orbit_cache_stats orbit_cache_get_stats(orbit_cache* cache);
+
+#endif
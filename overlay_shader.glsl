@@ -0,0 +1,21 @@
+#version 330 core
+
+#define LIGHT_COEFF vec4(0.3, 0.3, 0.3, 0.0)
+
+in vec2 coords;
+out vec4 color;
+
+uniform float zoom_rectangle_left_x;
+uniform float zoom_rectangle_up_y;
+uniform float zoom_rectangle_right_x;
+uniform float zoom_rectangle_down_y;
+
+// Drawn with additive blending over the colored fractal while the user drags a zoom rectangle.
+void main() {
+    if (zoom_rectangle_left_x <= coords[0] && coords[0] <= zoom_rectangle_right_x && \
+        zoom_rectangle_down_y <= coords[1] && coords[1] <= zoom_rectangle_up_y) {
+        color = LIGHT_COEFF;
+    } else {
+        discard;
+    }
+}
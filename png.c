@@ -0,0 +1,97 @@
+#include "png.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// deflate stored blocks hold at most this many bytes
+#define STORED_BLOCK_BYTES 65535
+
+// filled once, encoders on several threads (the tile server's connections) share it
+static uint32_t crc_table[256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+static void init_crc_table(void) {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        crc_table[n] = c;
+    }
+}
+
+static uint32_t crc(const unsigned char* bytes, size_t size) {
+    uint32_t c = 0xffffffffu;
+    for (size_t i = 0; i < size; ++i) {
+        c = crc_table[(c ^ bytes[i]) & 0xff] ^ (c >> 8);
+    }
+    return c ^ 0xffffffffu;
+}
+
+static unsigned char* put_u32(unsigned char* out, uint32_t value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+    return out + 4;
+}
+
+// Writes a chunk whose data is already at out + 8, returns the end of the chunk.
+static unsigned char* finish_chunk(unsigned char* out, const char* type, size_t size) {
+    put_u32(out, size);
+    memcpy(out + 4, type, 4);
+    return put_u32(out + 8 + size, crc(out + 4, size + 4));
+}
+
+unsigned char* png_encode_rgb(const unsigned char* rgb, int width, int height, size_t* size) {
+    pthread_once(&crc_table_once, init_crc_table);
+    size_t rowBytes = (size_t)width * 3 + 1;
+    size_t raw = rowBytes * height;
+    size_t blocks = raw / STORED_BLOCK_BYTES + 1;
+    size_t idat = 2 + raw + blocks * 5 + 4;
+    unsigned char* png = malloc(8 + (12 + 13) + (12 + idat) + 12);
+
+    unsigned char* out = png;
+    memcpy(out, "\x89PNG\r\n\x1a\n", 8);
+    out += 8;
+
+    unsigned char* data = out + 8;
+    data = put_u32(data, width);
+    data = put_u32(data, height);
+    // 8 bit RGB, deflate, no interlacing
+    memcpy(data, "\x08\x02\x00\x00\x00", 5);
+    out = finish_chunk(out, "IHDR", 13);
+
+    data = out + 8;
+    *data++ = 0x78;
+    *data++ = 0x01;
+    uint32_t a = 1, b = 0;
+    size_t left = raw, blockLeft = 0;
+    for (int y = 0; y < height; ++y) {
+        // filter byte 0 (none) followed by the row
+        for (size_t i = 0; i < rowBytes; ++i) {
+            if (blockLeft == 0) {
+                blockLeft = left < STORED_BLOCK_BYTES ? left : STORED_BLOCK_BYTES;
+                *data++ = left == blockLeft;
+                *data++ = blockLeft & 0xff;
+                *data++ = blockLeft >> 8;
+                *data++ = ~blockLeft & 0xff;
+                *data++ = (~blockLeft >> 8) & 0xff;
+            }
+            unsigned char byte = i == 0 ? 0 : rgb[(size_t)y * width * 3 + i - 1];
+            *data++ = byte;
+            a = (a + byte) % 65521;
+            b = (b + a) % 65521;
+            --blockLeft;
+            --left;
+        }
+    }
+    data = put_u32(data, b << 16 | a);
+    out = finish_chunk(out, "IDAT", data - (out + 8));
+
+    out = finish_chunk(out, "IEND", 0);
+    *size = out - png;
+    return png;
+}
@@ -0,0 +1,12 @@
+#ifndef PNG_H
+#define PNG_H
+
+#include <stddef.h>
+
+// Minimal PNG encoder for 8 bit RGB images. The image data is stored without compression, which keeps this free of
+// dependencies and fast to write; tiles and previews are small enough for that not to matter.
+
+// rgb holds the rows from the top, 3 bytes per pixel. Returns a malloc'ed buffer with the whole file and its size.
+unsigned char* png_encode_rgb(const unsigned char* rgb, int width, int height, size_t* size);
+
+#endif
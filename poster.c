@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+#include "tiled_image.h"
+
+// Renders images far bigger than any framebuffer into a tiled_image file, one tile at a time. Memory use only
+// depends on the tile size. Running the same command again after a crash continues with the missing tiles.
+
+#define DEFAULT_TILE_SIZE 1024
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT [options]\n"
+           "  --size WIDTH HEIGHT     image size in pixels (default 8192 8192)\n"
+           "  --view X Y WIDTH        bottom left corner and width of the image in the plane\n"
+           "  --formula NAME          mandelbrot, multibrot, burning_ship, tricorn or newton\n"
+           "  --power N               power of multibrot and newton\n"
+           "  --max-iter N            iteration limit (default 1000)\n"
+           "  --coloring NAME         iterations, trap_point, trap_line, trap_cross, stripe, triangle or\n"
+           "                          interior_distance\n"
+           "  --tile N                tile size in pixels (default %d)\n"
+           "  --engine cpu|gpu        (default gpu)\n"
+           "  --threads N             cpu engine threads (default: all cores)\n",
+           program, DEFAULT_TILE_SIZE);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    int width = 8192, height = 8192;
+    int tileSize = DEFAULT_TILE_SIZE;
+    int useGpu = 1;
+    int threads = cpu_thread_count();
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+    fractal_view view = {{CAMERA_CORNER_X, CAMERA_CORNER_Y}, CAMERA_WIDTH};
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--view") == 0 && rest >= 3) {
+            view.corner[0] = atof(argv[++i]);
+            view.corner[1] = atof(argv[++i]);
+            view.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--formula") == 0 && rest >= 1) {
+            formula_id formula = formula_by_name(argv[++i]);
+            if (formula == FORMULA_COUNT) {
+                printf("Unknown formula %s\n", argv[i]);
+                return -1;
+            }
+            int maxIter = params.max_iter;
+            coloring_id coloring = params.coloring;
+            fractal_params_default(&params, formula);
+            params.max_iter = maxIter;
+            params.coloring = coloring;
+        } else if (strcmp(argv[i], "--power") == 0 && rest >= 1) {
+            params.power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--coloring") == 0 && rest >= 1) {
+            params.coloring = coloring_by_name(argv[++i]);
+            if (params.coloring == COLORING_COUNT) {
+                printf("Unknown coloring %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--tile") == 0 && rest >= 1) {
+            tileSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            useGpu = strcmp(argv[++i], "gpu") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    if (width <= 0 || height <= 0 || tileSize <= 0 || params.power < MIN_POWER || params.power > MAX_POWER) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    tiled_image* image = tiled_image_open(outputPath, width, height, tileSize, &params, &view);
+    if (!image) {
+        return -1;
+    }
+    int tilesX = tiled_image_tiles_x(image);
+    int tilesY = tiled_image_tiles_y(image);
+    int tiles = tilesX * tilesY;
+    if (tiled_image_tiles_done(image)) {
+        printf("Resuming %s, %d of %d tiles already done\n", outputPath, tiled_image_tiles_done(image), tiles);
+    }
+
+    gpu_engine engine;
+    if (useGpu && (!gl_context_create_offscreen() || !gpu_engine_init(&engine, &params, tileSize))) {
+        tiled_image_close(image);
+        return -1;
+    }
+
+    int* iterations = malloc((size_t)tileSize * tileSize * sizeof(int));
+    float* statistics = malloc((size_t)tileSize * tileSize * sizeof(float));
+    unsigned char* rendered = malloc((size_t)tileSize * tileSize * 3);
+    unsigned char* tile = malloc((size_t)tileSize * tileSize * 3);
+    double pixel = view.width / width;
+    int result = 0;
+
+    // row order, so a partial file is also a usable top part of the image
+    for (int ty = 0; ty < tilesY && result == 0; ++ty) {
+        for (int tx = 0; tx < tilesX; ++tx) {
+            if (tiled_image_has_tile(image, tx, ty)) {
+                continue;
+            }
+            int tileWidth, tileHeight;
+            tiled_image_tile_size(image, tx, ty, &tileWidth, &tileHeight);
+            // tile rows count from the top, the engines' rows from the bottom
+            int bottom = height - ty * tileSize - tileHeight;
+            fractal_view tileView = {{view.corner[0] + (double)tx * tileSize * pixel, view.corner[1] + bottom * pixel},
+                                     tileWidth * pixel};
+
+            if (useGpu) {
+                gpu_engine_render_rgb(&engine, &tileView, tileWidth, tileHeight, rendered);
+            } else if (params.coloring != COLORING_ITERATIONS) {
+                // the same density as the GPU's STATISTIC_DENSITY, so both engines give the same poster
+                cpu_render_statistics_parallel(&params, &tileView, tileWidth, tileHeight, iterations, statistics,
+                                               threads);
+                colorize_statistics(params.coloring, iterations, statistics, tileWidth * tileHeight, 1.0, rendered);
+            } else {
+                cpu_render_iterations_parallel(&params, &tileView, tileWidth, tileHeight, iterations, threads,
+                                               1);
+                colorize_iterations(iterations, tileWidth * tileHeight, rendered);
+            }
+            for (int j = 0; j < tileHeight; ++j) {
+                memcpy(tile + (size_t)j * tileWidth * 3, rendered + (size_t)(tileHeight - 1 - j) * tileWidth * 3,
+                       (size_t)tileWidth * 3);
+            }
+
+            if (!tiled_image_write_tile(image, tx, ty, tile)) {
+                printf("Failed to write tile %d %d to %s\n", tx, ty, outputPath);
+                result = -1;
+                break;
+            }
+            printf("tile %d/%d\n", tiled_image_tiles_done(image), tiles);
+        }
+    }
+
+    free(tile);
+    free(rendered);
+    free(statistics);
+    free(iterations);
+    if (useGpu) {
+        gpu_engine_destroy(&engine);
+        gl_context_destroy();
+    }
+    tiled_image_close(image);
+    return result;
+}
@@ -0,0 +1,143 @@
+#include "raw_dump.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct raw_dump {
+    unsigned char* mapping;
+    size_t size;
+    int writable;
+    int tilesX;
+    int tilesY;
+};
+
+static size_t header_bytes(void) {
+    return (sizeof(raw_dump_header) + RAW_DUMP_ALIGNMENT - 1) / RAW_DUMP_ALIGNMENT * RAW_DUMP_ALIGNMENT;
+}
+
+static size_t dump_size(int tilesX, int tilesY) {
+    return header_bytes() + (size_t)tilesX * tilesY * RAW_DUMP_TILE_BYTES;
+}
+
+static int tiles_for(int pixels) {
+    return (pixels + RAW_DUMP_TILE - 1) / RAW_DUMP_TILE;
+}
+
+static raw_dump* map_dump(const char* path, int file, size_t size, int writable) {
+    void* mapping = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Couldn't map %s\n", path);
+        return NULL;
+    }
+    const raw_dump_header* header = mapping;
+    raw_dump* dump = malloc(sizeof(raw_dump));
+    dump->mapping = mapping;
+    dump->size = size;
+    dump->writable = writable;
+    dump->tilesX = tiles_for(header->width);
+    dump->tilesY = tiles_for(header->height);
+    return dump;
+}
+
+raw_dump* raw_dump_create(const char* path, int width, int height, const fractal_params* params,
+                          const char* const center[2], double viewWidth, uint32_t fields, const char* engine) {
+    if (strlen(center[0]) >= RAW_DUMP_CENTER_CHARS || strlen(center[1]) >= RAW_DUMP_CENTER_CHARS) {
+        fprintf(stderr, "The center of %s has more than %d digits\n", path, RAW_DUMP_CENTER_CHARS - 1);
+        return NULL;
+    }
+    int file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0) {
+        fprintf(stderr, "Couldn't create %s\n", path);
+        return NULL;
+    }
+    size_t size = dump_size(tiles_for(width), tiles_for(height));
+    if (ftruncate(file, size) != 0) {
+        fprintf(stderr, "Couldn't make %s %zu bytes long\n", path, size);
+        close(file);
+        return NULL;
+    }
+    // the tiles read as zero until the engine renders them
+    raw_dump_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RAW_DUMP_MAGIC, sizeof(header.magic));
+    header.version = RAW_DUMP_VERSION;
+    header.width = width;
+    header.height = height;
+    header.tile_size = RAW_DUMP_TILE;
+    header.fields = fields;
+    header.formula = params->formula;
+    header.power = params->power;
+    header.max_iter = params->max_iter;
+    strcpy(header.center[0], center[0]);
+    strcpy(header.center[1], center[1]);
+    header.view_width = viewWidth;
+    snprintf(header.engine, sizeof(header.engine), "%s", engine);
+    if (pwrite(file, &header, sizeof(header), 0) != sizeof(header)) {
+        fprintf(stderr, "Couldn't write %s\n", path);
+        close(file);
+        return NULL;
+    }
+    return map_dump(path, file, size, 1);
+}
+
+raw_dump* raw_dump_open(const char* path) {
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        fprintf(stderr, "Couldn't open %s\n", path);
+        return NULL;
+    }
+    raw_dump_header header;
+    struct stat status;
+    if (fstat(file, &status) != 0 || pread(file, &header, sizeof(header), 0) != sizeof(header) ||
+        memcmp(header.magic, RAW_DUMP_MAGIC, sizeof(header.magic)) != 0 || header.version != RAW_DUMP_VERSION ||
+        header.tile_size != RAW_DUMP_TILE || header.formula < 0 || header.formula >= FORMULA_COUNT ||
+        memchr(header.center[0], '\0', RAW_DUMP_CENTER_CHARS) == NULL ||
+        memchr(header.center[1], '\0', RAW_DUMP_CENTER_CHARS) == NULL ||
+        status.st_size < (off_t)dump_size(tiles_for(header.width), tiles_for(header.height))) {
+        fprintf(stderr, "%s isn't a raw dump\n", path);
+        close(file);
+        return NULL;
+    }
+    return map_dump(path, file, dump_size(tiles_for(header.width), tiles_for(header.height)), 0);
+}
+
+void raw_dump_close(raw_dump* dump) {
+    if (dump->writable && msync(dump->mapping, dump->size, MS_SYNC) != 0) {
+        fprintf(stderr, "Couldn't sync a raw dump\n");
+    }
+    munmap(dump->mapping, dump->size);
+    free(dump);
+}
+
+const raw_dump_header* raw_dump_get_header(const raw_dump* dump) {
+    return (const raw_dump_header*)dump->mapping;
+}
+
+int raw_dump_tiles_x(const raw_dump* dump) {
+    return dump->tilesX;
+}
+
+int raw_dump_tiles_y(const raw_dump* dump) {
+    return dump->tilesY;
+}
+
+raw_tile raw_dump_get_tile(const raw_dump* dump, int tx, int ty) {
+    unsigned char* tile = dump->mapping + header_bytes() + ((size_t)ty * dump->tilesX + tx) * RAW_DUMP_TILE_BYTES;
+    raw_tile result = {(int32_t*)tile, (float*)(tile + RAW_DUMP_PLANE_BYTES),
+                       (float*)(tile + 2 * RAW_DUMP_PLANE_BYTES), (float*)(tile + 3 * RAW_DUMP_PLANE_BYTES)};
+    return result;
+}
+
+void raw_dump_tile_view(const raw_dump* dump, int tx, int ty, fractal_view* view) {
+    const raw_dump_header* header = raw_dump_get_header(dump);
+    double pixel = header->view_width / header->width;
+    view->corner[0] = atof(header->center[0]) + (tx * RAW_DUMP_TILE - header->width / 2.0) * pixel;
+    view->corner[1] = atof(header->center[1]) + (ty * RAW_DUMP_TILE - header->height / 2.0) * pixel;
+    view->width = RAW_DUMP_TILE * pixel;
+}
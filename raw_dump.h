@@ -0,0 +1,90 @@
+#ifndef RAW_DUMP_H
+#define RAW_DUMP_H
+
+#include <stdint.h>
+
+#include "fractal.h"
+
+// Raw per pixel results of a render, kept so that recoloring, statistics and thumbnails of huge renders never
+// render anything again. The file is memory mapped, readers get pointers straight into the page cache and writers
+// render into the mapping.
+//
+// Layout (native byte order):
+//   raw_dump_header, padded to RAW_DUMP_ALIGNMENT
+//   tiles in row order from the bottom row of tiles, each RAW_DUMP_TILE_BYTES:
+//     int32_t escape[T][T]     formula_iterate's result: the iteration the orbit escaped (or converged) at, -1 inside
+//     float smooth[T][T]       the fraction of the smooth iteration count, escape + smooth is continuous across bands
+//     float distance[T][T]     exterior distance estimate in the plane
+//     float z[T][T][2]         z at the last iteration, x and y interleaved
+// T is RAW_DUMP_TILE. Rows within a tile go from the bottom, like cpu_render_iterations. Every array starts on an
+// RAW_DUMP_ALIGNMENT boundary, so a tile's planes can be read (or mapped) on their own. Tiles on the right and top
+// edges are rendered past the image as well; only the pixels within width and height belong to it.
+//
+// Not every engine computes every plane, fields says which ones hold data, the others are zero. Within them, NaN
+// marks pixels for which the value isn't defined: the smooth fraction and the distance of pixels that didn't
+// escape, or of formulas that converge or have no complex derivative.
+
+#define RAW_DUMP_MAGIC "FRACDUMP"
+#define RAW_DUMP_VERSION 2
+#define RAW_DUMP_TILE 64
+#define RAW_DUMP_ALIGNMENT 4096
+#define RAW_DUMP_PLANE_BYTES (RAW_DUMP_TILE * RAW_DUMP_TILE * 4)
+#define RAW_DUMP_TILE_BYTES (5 * RAW_DUMP_PLANE_BYTES)
+// decimal digits of the center, enough for any view the deep engine renders
+#define RAW_DUMP_CENTER_CHARS 384
+
+typedef enum {
+    RAW_FIELD_ESCAPE = 1,
+    RAW_FIELD_SMOOTH = 2,
+    RAW_FIELD_DISTANCE = 4,
+    RAW_FIELD_Z = 8,
+    RAW_FIELD_ALL = 15,
+} raw_field;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    // raw_field bits
+    uint32_t fields;
+    int32_t formula;
+    int32_t power;
+    int32_t max_iter;
+    // center of the image to the precision it was rendered with, NUL terminated decimal
+    char center[2][RAW_DUMP_CENTER_CHARS];
+    // extent of the image's width in the plane, pixels are square
+    double view_width;
+    // name of the engine that wrote it
+    char engine[16];
+} raw_dump_header;
+
+// Pointers into the mapping for one tile, RAW_DUMP_TILE * RAW_DUMP_TILE pixels each.
+typedef struct {
+    int32_t* escape;
+    float* smooth;
+    float* distance;
+    float* z;
+} raw_tile;
+
+typedef struct raw_dump raw_dump;
+
+// Creates (or overwrites) the file at full size, zeroed, for the engine to render into tile by tile.
+// Returns NULL (after printing why) if the file can't be created.
+raw_dump* raw_dump_create(const char* path, int width, int height, const fractal_params* params,
+                          const char* const center[2], double viewWidth, uint32_t fields, const char* engine);
+// Maps an existing dump read only. Returns NULL (after printing why) if it isn't one.
+raw_dump* raw_dump_open(const char* path);
+// Syncs a created dump to the file before unmapping it.
+void raw_dump_close(raw_dump* dump);
+
+const raw_dump_header* raw_dump_get_header(const raw_dump* dump);
+int raw_dump_tiles_x(const raw_dump* dump);
+int raw_dump_tiles_y(const raw_dump* dump);
+// The tile's planes. Only created dumps may be written through them.
+raw_tile raw_dump_get_tile(const raw_dump* dump, int tx, int ty);
+// The tile in the plane, from the center rounded to double, for the engines that work in double.
+void raw_dump_tile_view(const raw_dump* dump, int tx, int ty, fractal_view* view);
+
+#endif
@@ -0,0 +1,186 @@
+#include "readback.h"
+
+#include <glad/glad.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    GLuint buffer;
+    size_t capacity;
+    GLsync fence;
+    readback_frame frame;
+    readback_writer writer;
+    void* context;
+} readback_slot;
+
+typedef struct {
+    readback_frame frame;
+    readback_writer writer;
+    void* context;
+} readback_job;
+
+struct readback {
+    // in flight on the GPU, oldest at first, in capture order
+    readback_slot slots[READBACK_SLOTS];
+    int first;
+    int inFlight;
+    long captures;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    readback_job queue[READBACK_QUEUE];
+    int queueFirst;
+    int queued;
+    int stopping;
+    long dropped;
+};
+
+static void* write_frames(void* argument) {
+    readback* readback = argument;
+    pthread_mutex_lock(&readback->lock);
+    for (;;) {
+        while (readback->queued == 0 && !readback->stopping) {
+            pthread_cond_wait(&readback->changed, &readback->lock);
+        }
+        if (readback->queued == 0) {
+            break;
+        }
+        readback_job job = readback->queue[readback->queueFirst];
+        readback->queueFirst = (readback->queueFirst + 1) % READBACK_QUEUE;
+        --readback->queued;
+        pthread_cond_broadcast(&readback->changed);
+        pthread_mutex_unlock(&readback->lock);
+
+        job.writer(&job.frame, job.context);
+        free(job.frame.rgb);
+
+        pthread_mutex_lock(&readback->lock);
+    }
+    pthread_mutex_unlock(&readback->lock);
+    return NULL;
+}
+
+readback* readback_create(void) {
+    readback* readback = calloc(1, sizeof(struct readback));
+    pthread_mutex_init(&readback->lock, NULL);
+    pthread_cond_init(&readback->changed, NULL);
+    for (int i = 0; i < READBACK_SLOTS; ++i) {
+        glGenBuffers(1, &readback->slots[i].buffer);
+    }
+    if (pthread_create(&readback->thread, NULL, write_frames, readback) != 0) {
+        fprintf(stderr, "Couldn't start the readback writer\n");
+        for (int i = 0; i < READBACK_SLOTS; ++i) {
+            glDeleteBuffers(1, &readback->slots[i].buffer);
+        }
+        free(readback);
+        return NULL;
+    }
+    return readback;
+}
+
+// Copies the oldest capture out of its buffer and queues it. Without waitGpu it returns 0 if the capture isn't done
+// yet, without waitQueue it drops the capture if the queue is full.
+static int finish_oldest(readback* readback, int waitGpu, int waitQueue) {
+    readback_slot* slot = &readback->slots[readback->first];
+    GLenum status = glClientWaitSync(slot->fence, waitGpu ? GL_SYNC_FLUSH_COMMANDS_BIT : 0,
+                                     waitGpu ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        return 0;
+    }
+    glDeleteSync(slot->fence);
+    slot->fence = 0;
+    readback->first = (readback->first + 1) % READBACK_SLOTS;
+    --readback->inFlight;
+
+    pthread_mutex_lock(&readback->lock);
+    while (waitQueue && readback->queued == READBACK_QUEUE) {
+        pthread_cond_wait(&readback->changed, &readback->lock);
+    }
+    int full = readback->queued == READBACK_QUEUE;
+    readback->dropped += full;
+    pthread_mutex_unlock(&readback->lock);
+    if (full) {
+        return 1;
+    }
+
+    readback_job job = {slot->frame, slot->writer, slot->context};
+    size_t size = (size_t)slot->frame.width * slot->frame.height * 3;
+    job.frame.rgb = malloc(size);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+        memcpy(job.frame.rgb, pixels, size);
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels) {
+        free(job.frame.rgb);
+        return 1;
+    }
+
+    // only the writer thread takes jobs off the queue, so there is still room
+    pthread_mutex_lock(&readback->lock);
+    readback->queue[(readback->queueFirst + readback->queued) % READBACK_QUEUE] = job;
+    ++readback->queued;
+    pthread_cond_broadcast(&readback->changed);
+    pthread_mutex_unlock(&readback->lock);
+    return 1;
+}
+
+void readback_capture(readback* readback, int x, int y, int width, int height, readback_writer writer,
+                      void* context) {
+    if (readback->inFlight == READBACK_SLOTS) {
+        finish_oldest(readback, 1, 0);
+    }
+    readback_slot* slot = &readback->slots[(readback->first + readback->inFlight) % READBACK_SLOTS];
+    size_t size = (size_t)width * height * 3;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot->buffer);
+    if (size > slot->capacity) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot->capacity = size;
+    }
+    // RGB rows aren't 4 byte aligned
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(x, y, width, height, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot->frame = (readback_frame){NULL, x, y, width, height, readback->captures++};
+    slot->writer = writer;
+    slot->context = context;
+    ++readback->inFlight;
+}
+
+void readback_poll(readback* readback) {
+    while (readback->inFlight > 0 && finish_oldest(readback, 0, 0)) {
+    }
+}
+
+void readback_destroy(readback* readback) {
+    while (readback->inFlight > 0) {
+        finish_oldest(readback, 1, 1);
+    }
+    pthread_mutex_lock(&readback->lock);
+    readback->stopping = 1;
+    pthread_cond_broadcast(&readback->changed);
+    pthread_mutex_unlock(&readback->lock);
+    pthread_join(readback->thread, NULL);
+
+    for (int i = 0; i < READBACK_SLOTS; ++i) {
+        glDeleteBuffers(1, &readback->slots[i].buffer);
+    }
+    pthread_mutex_destroy(&readback->lock);
+    pthread_cond_destroy(&readback->changed);
+    free(readback);
+}
+
+long readback_dropped(readback* readback) {
+    pthread_mutex_lock(&readback->lock);
+    long dropped = readback->dropped;
+    pthread_mutex_unlock(&readback->lock);
+    return dropped;
+}
@@ -0,0 +1,48 @@
+#ifndef READBACK_H
+#define READBACK_H
+
+// Asynchronous readback of rendered pixels, for screenshots, recording and anything else that needs them on the CPU.
+//
+// A capture reads a rectangle of the bound read framebuffer into one of READBACK_SLOTS pixel buffers and fences it,
+// which returns right away. readback_poll, once per frame, copies out the captures whose fence has passed (usually
+// the previous frame's) and queues them for a writer thread, which hands each one to the writer given with the
+// capture. So the render loop never waits for the GPU to catch up nor for the writers (PNG encoding, disk, network).
+// When the writer thread falls more than READBACK_QUEUE captures behind, new ones are dropped instead.
+
+#define READBACK_SLOTS 3
+#define READBACK_QUEUE 8
+
+typedef struct {
+    // rows from the bottom like glReadPixels, 3 bytes per pixel
+    unsigned char* rgb;
+    // rectangle of the framebuffer it came from
+    int x;
+    int y;
+    int width;
+    int height;
+    // counts the captures of a readback from 0
+    long sequence;
+} readback_frame;
+
+// Runs on the writer thread, frame is only valid during the call.
+typedef void (*readback_writer)(const readback_frame* frame, void* context);
+
+typedef struct readback readback;
+
+// Needs a current GL context, like every other call but readback_dropped. Returns NULL if the writer thread can't
+// be started.
+readback* readback_create(void);
+// Finishes every capture, waiting for the GPU and the writers.
+void readback_destroy(readback* readback);
+
+// Starts reading the rectangle. Only waits when all slots are still in flight, that is when capturing more than
+// READBACK_SLOTS times a frame.
+void readback_capture(readback* readback, int x, int y, int width, int height, readback_writer writer,
+                      void* context);
+// Queues the finished captures for the writers.
+void readback_poll(readback* readback);
+
+// Captures lost because the writers didn't keep up.
+long readback_dropped(readback* readback);
+
+#endif
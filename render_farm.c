@@ -0,0 +1,494 @@
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpu_engine.h"
+#include "farm.h"
+#include "fractal.h"
+#include "tiled_image.h"
+#include "video.h"
+
+// Renders a tiled_image like poster, but hands the tiles to farm_worker processes over sockets (see farm.h), so any
+// number of machines can work on one image. Workers may come and go while the image renders:
+//   - every worker has up to FARM_WINDOW tiles queued, new tiles go to whoever has room,
+//   - once no tile is left to hand out, an idle worker steals the last queued tile of the busiest one,
+//   - the tiles of a worker that disconnects or makes no progress for --timeout seconds are handed out again.
+// Finished tiles go straight into the file in whatever order they arrive, so a crashed coordinator resumes like
+// poster does. --local-workers starts workers on this machine too, which is also how to try it on one box.
+//
+// With --zoom-to it renders a zoom video like zoom_video instead, from --view to the given view: the tiles are chunks
+// of frames, and chunks arriving ahead of the next one to write wait in memory. The Y4M stream can't be resumed.
+
+#define DEFAULT_TILE_SIZE 1024
+#define DEFAULT_ADDRESS "127.0.0.1:7460"
+#define DEFAULT_TIMEOUT_SECONDS 120
+#define MAX_WORKERS 256
+
+typedef enum { TILE_PENDING, TILE_ASSIGNED, TILE_DONE } tile_state;
+
+typedef struct {
+    // -1 for a free slot
+    int socket;
+    // sent FARM_HELLO and got the job
+    int ready;
+    // queued on the worker, oldest first; each assigned tile is queued on exactly one worker
+    int tiles[FARM_WINDOW];
+    int count;
+    double lastProgress;
+} worker;
+
+static worker workers[MAX_WORKERS];
+static tile_state* states;
+static int tilesX;
+// no pending tile before this one
+static int firstPending;
+
+// video jobs only: the zoom, chunks that arrived before an earlier one, and the next chunk to write
+static farm_video_header videoJob;
+static unsigned char** chunks;
+static int nextChunk;
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT [options]\n"
+           "  --size WIDTH HEIGHT     image size in pixels (default 8192 8192, 1280 720 for videos)\n"
+           "  --view X Y WIDTH        bottom left corner and width of the image in the plane\n"
+           "  --zoom-to X Y WIDTH     render a Y4M zoom video from --view to this view instead\n"
+           "  --fps N                 frames per second of the video (default 30)\n"
+           "  --duration SECONDS      length of the video (default 10)\n"
+           "  --formula NAME          mandelbrot, multibrot, burning_ship, tricorn or newton\n"
+           "  --power N               power of multibrot and newton\n"
+           "  --max-iter N            iteration limit (default 1000)\n"
+           "  --coloring NAME         iterations, trap_point, trap_line, trap_cross, stripe, triangle or\n"
+           "                          interior_distance\n"
+           "  --tile N                tile size in pixels (default %d)\n"
+           "  --listen ADDRESS        HOST:PORT or unix:PATH for the workers (default %s)\n"
+           "  --timeout SECONDS       drop workers that finish no tile for that long (default %d)\n"
+           "  --local-workers N       also start N workers on this machine\n"
+           "  --engine cpu|gpu        engine of the local workers (default gpu)\n"
+           "  --threads N             cpu engine threads of each local worker (default: cores / workers)\n",
+           program, DEFAULT_TILE_SIZE, DEFAULT_ADDRESS, DEFAULT_TIMEOUT_SECONDS);
+}
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+int takePendingTile(int tiles) {
+    while (firstPending < tiles && states[firstPending] != TILE_PENDING) {
+        ++firstPending;
+    }
+    return firstPending < tiles ? firstPending : -1;
+}
+
+void requeueTile(int tile) {
+    states[tile] = TILE_PENDING;
+    firstPending = tile < firstPending ? tile : firstPending;
+}
+
+int assignTile(worker* w, int tile) {
+    if (w->count == 0) {
+        w->lastProgress = now();
+    }
+    w->tiles[w->count++] = tile;
+    states[tile] = TILE_ASSIGNED;
+    return farm_send(w->socket, FARM_TILE, tile % tilesX, tile / tilesX, NULL, 0);
+}
+
+// Removes tile from the queue of w, returns whether it was there.
+int unqueueTile(worker* w, int tile) {
+    for (int i = 0; i < w->count; ++i) {
+        if (w->tiles[i] == tile) {
+            memmove(&w->tiles[i], &w->tiles[i + 1], (w->count - i - 1) * sizeof(int));
+            --w->count;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void dropWorker(worker* w, const char* reason) {
+    printf("worker %d %s, handing out its %d tiles again\n", (int)(w - workers), reason, w->count);
+    for (int i = 0; i < w->count; ++i) {
+        requeueTile(w->tiles[i]);
+    }
+    close(w->socket);
+    w->socket = -1;
+    w->count = 0;
+}
+
+// Fills the queue of w with pending tiles, or failing that with a tile stolen from the busiest worker.
+void feedWorker(worker* w, int tiles) {
+    while (w->socket >= 0 && w->ready && w->count < FARM_WINDOW) {
+        int tile = takePendingTile(tiles);
+        if (tile < 0) {
+            worker* victim = NULL;
+            for (int i = 0; i < MAX_WORKERS; ++i) {
+                // the first queued tile may be rendering already, leave it
+                if (workers[i].socket >= 0 && &workers[i] != w && workers[i].count > 1 &&
+                    (!victim || workers[i].count > victim->count)) {
+                    victim = &workers[i];
+                }
+            }
+            // only steal for an idle worker, otherwise tiles would just hop between busy ones
+            if (!victim || w->count > 0) {
+                return;
+            }
+            tile = victim->tiles[--victim->count];
+            if (!farm_send(victim->socket, FARM_CANCEL, tile % tilesX, tile / tilesX, NULL, 0)) {
+                dropWorker(victim, "disconnected");
+            }
+        }
+        if (!assignTile(w, tile)) {
+            dropWorker(w, "disconnected");
+        }
+    }
+}
+
+// Stores a finished chunk of the video, then writes every chunk that is now next in line. Returns 0 on a write error.
+int storeChunk(FILE* output, int chunk, const unsigned char* frames, size_t bytes, unsigned char* planes) {
+    chunks[chunk] = malloc(bytes);
+    memcpy(chunks[chunk], frames, bytes);
+    size_t frameBytes = (size_t)videoJob.width * videoJob.height * 3;
+    int ok = 1;
+    for (; chunks[nextChunk]; ++nextChunk) {
+        int first;
+        int count = farm_video_chunk(&videoJob, nextChunk, &first);
+        for (int f = 0; f < count; ++f) {
+            video_write_y4m_frame(output, chunks[nextChunk] + f * frameBytes, videoJob.width, videoJob.height,
+                                  planes);
+        }
+        ok = ok && !ferror(output);
+        free(chunks[nextChunk]);
+        chunks[nextChunk] = NULL;
+    }
+    return ok;
+}
+
+// Starts a worker process connected to address. Returns its pid, or -1.
+pid_t startLocalWorker(const char* address, int useGpu, int threads) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(farm_worker_run(address, useGpu, threads) ? 0 : 1);
+    }
+    return pid;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    int width = 0, height = 0;
+    int tileSize = DEFAULT_TILE_SIZE;
+    const char* address = DEFAULT_ADDRESS;
+    int timeout = DEFAULT_TIMEOUT_SECONDS;
+    int localWorkers = 0;
+    int useGpu = 1;
+    int threads = 0;
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+    fractal_view view = {{CAMERA_CORNER_X, CAMERA_CORNER_Y}, CAMERA_WIDTH};
+    fractal_view zoomTo = {{0, 0}, 0};
+    int fps = 30;
+    double duration = 10;
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--view") == 0 && rest >= 3) {
+            view.corner[0] = atof(argv[++i]);
+            view.corner[1] = atof(argv[++i]);
+            view.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--zoom-to") == 0 && rest >= 3) {
+            zoomTo.corner[0] = atof(argv[++i]);
+            zoomTo.corner[1] = atof(argv[++i]);
+            zoomTo.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && rest >= 1) {
+            fps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && rest >= 1) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--formula") == 0 && rest >= 1) {
+            formula_id formula = formula_by_name(argv[++i]);
+            if (formula == FORMULA_COUNT) {
+                printf("Unknown formula %s\n", argv[i]);
+                return -1;
+            }
+            int maxIter = params.max_iter;
+            coloring_id coloring = params.coloring;
+            fractal_params_default(&params, formula);
+            params.max_iter = maxIter;
+            params.coloring = coloring;
+        } else if (strcmp(argv[i], "--power") == 0 && rest >= 1) {
+            params.power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--coloring") == 0 && rest >= 1) {
+            params.coloring = coloring_by_name(argv[++i]);
+            if (params.coloring == COLORING_COUNT) {
+                printf("Unknown coloring %s\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(argv[i], "--tile") == 0 && rest >= 1) {
+            tileSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--listen") == 0 && rest >= 1) {
+            address = argv[++i];
+        } else if (strcmp(argv[i], "--timeout") == 0 && rest >= 1) {
+            timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--local-workers") == 0 && rest >= 1) {
+            localWorkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            useGpu = strcmp(argv[++i], "gpu") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    int video = zoomTo.width != 0;
+    if (width == 0 && height == 0) {
+        width = video ? 1280 : 8192;
+        height = video ? 720 : 8192;
+    }
+    int frames = (int)(fps * duration + 0.5);
+    if (width <= 0 || height <= 0 || tileSize <= 0 || timeout <= 0 || localWorkers < 0 ||
+        params.power < MIN_POWER || params.power > MAX_POWER ||
+        (video && (zoomTo.width < 0 || zoomTo.width == view.width || frames < 2))) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    if (video && params.coloring != COLORING_ITERATIONS) {
+        printf("Videos are only colored by iterations\n");
+        return -1;
+    }
+    if (threads <= 0) {
+        threads = localWorkers ? cpu_thread_count() / localWorkers : 1;
+        threads = threads > 0 ? threads : 1;
+    }
+
+    tiled_image* image = NULL;
+    FILE* output = NULL;
+    unsigned char* planes = NULL;
+    int tiles;
+    int done = 0;
+    if (video) {
+        output = fopen(outputPath, "wb");
+        if (!output) {
+            printf("Couldn't open %s\n", outputPath);
+            return -1;
+        }
+        videoJob = (farm_video_header){.formula = params.formula,
+                                       .power = params.power,
+                                       .max_iter = params.max_iter,
+                                       .width = width,
+                                       .height = height,
+                                       .frames = frames,
+                                       .from = {view.corner[0], view.corner[1], view.width},
+                                       .to = {zoomTo.corner[0], zoomTo.corner[1], zoomTo.width}};
+        video_write_y4m_header(output, width, height, fps);
+        planes = malloc((size_t)width * height * 3);
+        // the row of chunks, with one more that never arrives to stop the writing
+        tilesX = (frames + FARM_VIDEO_CHUNK - 1) / FARM_VIDEO_CHUNK;
+        tiles = tilesX;
+        chunks = calloc(tiles + 1, sizeof(unsigned char*));
+        states = malloc(tiles * sizeof(tile_state));
+        for (int i = 0; i < tiles; ++i) {
+            states[i] = TILE_PENDING;
+        }
+    } else {
+        image = tiled_image_open(outputPath, width, height, tileSize, &params, &view);
+        if (!image) {
+            return -1;
+        }
+        tilesX = tiled_image_tiles_x(image);
+        tiles = tilesX * tiled_image_tiles_y(image);
+        states = malloc(tiles * sizeof(tile_state));
+        for (int i = 0; i < tiles; ++i) {
+            states[i] = tiled_image_has_tile(image, i % tilesX, i / tilesX) ? TILE_DONE : TILE_PENDING;
+        }
+        done = tiled_image_tiles_done(image);
+        if (done) {
+            printf("Resuming %s, %d of %d tiles already done\n", outputPath, done, tiles);
+        }
+    }
+
+    // a worker vanishing mid-message shows up as a failed send, not a signal
+    signal(SIGPIPE, SIG_IGN);
+    int listener = farm_listen(address);
+    if (listener < 0) {
+        if (image) {
+            tiled_image_close(image);
+        } else {
+            fclose(output);
+        }
+        return -1;
+    }
+    for (int i = 0; i < MAX_WORKERS; ++i) {
+        workers[i].socket = -1;
+    }
+    pid_t* children = calloc(localWorkers + 1, sizeof(pid_t));
+    for (int i = 0; i < localWorkers; ++i) {
+        children[i] = startLocalWorker(address, useGpu, threads);
+    }
+    printf("Waiting for workers on %s\n", address);
+
+    unsigned char* payload = NULL;
+    size_t capacity = 0;
+    struct pollfd pollers[MAX_WORKERS + 1];
+    int result = 0;
+    while (done < tiles && result == 0) {
+        int count = 0;
+        pollers[count++] = (struct pollfd){listener, POLLIN, 0};
+        for (int i = 0; i < MAX_WORKERS; ++i) {
+            if (workers[i].socket >= 0) {
+                pollers[count++] = (struct pollfd){workers[i].socket, POLLIN, 0};
+            }
+        }
+        poll(pollers, count, 1000);
+
+        if (pollers[0].revents & POLLIN) {
+            int client = accept(listener, NULL, NULL);
+            int slot = 0;
+            while (slot < MAX_WORKERS && workers[slot].socket >= 0) {
+                ++slot;
+            }
+            if (client >= 0 && slot == MAX_WORKERS) {
+                close(client);
+            } else if (client >= 0) {
+                // a worker stalling halfway through a message can't hold up the others for longer than this
+                struct timeval limit = {timeout, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+                setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit));
+                workers[slot] = (worker){client, 0, {0}, 0, now()};
+            }
+        }
+
+        for (int p = 1; p < count; ++p) {
+            if (!(pollers[p].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            // the worker may have been dropped while handling an earlier one
+            worker* w = workers;
+            while (w < workers + MAX_WORKERS && w->socket != pollers[p].fd) {
+                ++w;
+            }
+            if (w == workers + MAX_WORKERS) {
+                continue;
+            }
+            farm_message message;
+            if (!farm_receive(w->socket, &message, &payload, &capacity)) {
+                dropWorker(w, "disconnected");
+                continue;
+            }
+            if (message.type == FARM_HELLO && !w->ready) {
+                int sent = video ? farm_send(w->socket, FARM_VIDEO_JOB, 0, 0, &videoJob, sizeof(videoJob))
+                                 : farm_send(w->socket, FARM_JOB, 0, 0, tiled_image_get_header(image),
+                                             sizeof(tiled_image_header));
+                if (message.tx != FARM_VERSION || !sent) {
+                    dropWorker(w, "speaks another protocol");
+                    continue;
+                }
+                w->ready = 1;
+                printf("worker %d joined\n", (int)(w - workers));
+                continue;
+            }
+            int tile = message.ty * tilesX + message.tx;
+            if (message.type != FARM_RESULT || message.tx < 0 || message.tx >= tilesX || message.ty < 0 ||
+                tile >= tiles) {
+                dropWorker(w, "sent garbage");
+                continue;
+            }
+            uint32_t expected;
+            if (video) {
+                int first;
+                expected = (uint32_t)farm_video_chunk(&videoJob, tile, &first) * width * height * 3;
+            } else {
+                int tileWidth, tileHeight;
+                tiled_image_tile_size(image, message.tx, message.ty, &tileWidth, &tileHeight);
+                expected = (uint32_t)tileWidth * tileHeight * 3;
+            }
+            if (message.bytes != expected) {
+                dropWorker(w, "sent garbage");
+                continue;
+            }
+            w->lastProgress = now();
+            unqueueTile(w, tile);
+            // the tile may have been stolen from this worker after it started on it, take back the copy
+            for (int i = 0; i < MAX_WORKERS; ++i) {
+                if (workers[i].socket >= 0 && &workers[i] != w && unqueueTile(&workers[i], tile) &&
+                    !farm_send(workers[i].socket, FARM_CANCEL, message.tx, message.ty, NULL, 0)) {
+                    dropWorker(&workers[i], "disconnected");
+                }
+            }
+            if (states[tile] == TILE_DONE) {
+                continue;
+            }
+            if (video ? !storeChunk(output, tile, payload, message.bytes, planes)
+                      : !tiled_image_write_tile(image, message.tx, message.ty, payload)) {
+                printf("Failed to write %s %d %d to %s\n", video ? "chunk" : "tile", message.tx, message.ty,
+                       outputPath);
+                result = -1;
+                break;
+            }
+            states[tile] = TILE_DONE;
+            ++done;
+            printf("%s %d/%d from worker %d\n", video ? "chunk" : "tile", done, tiles, (int)(w - workers));
+        }
+
+        double time = now();
+        for (int i = 0; i < MAX_WORKERS; ++i) {
+            if (workers[i].socket >= 0 && workers[i].count > 0 && time - workers[i].lastProgress > timeout) {
+                dropWorker(&workers[i], "timed out");
+            }
+        }
+        for (int i = 0; i < MAX_WORKERS; ++i) {
+            feedWorker(&workers[i], tiles);
+        }
+    }
+
+    for (int i = 0; i < MAX_WORKERS; ++i) {
+        if (workers[i].socket >= 0) {
+            farm_send(workers[i].socket, FARM_DONE, 0, 0, NULL, 0);
+            close(workers[i].socket);
+        }
+    }
+    close(listener);
+    if (strncmp(address, "unix:", 5) == 0) {
+        unlink(address + 5);
+    }
+    for (int i = 0; i < localWorkers; ++i) {
+        if (children[i] > 0) {
+            waitpid(children[i], NULL, 0);
+        }
+    }
+    free(children);
+    free(payload);
+    free(states);
+    if (video) {
+        for (int i = 0; i < tiles; ++i) {
+            free(chunks[i]);
+        }
+        free(chunks);
+        free(planes);
+        if (fclose(output) != 0) {
+            printf("Failed to write %s\n", outputPath);
+            result = -1;
+        }
+    } else {
+        tiled_image_close(image);
+    }
+    return result;
+}
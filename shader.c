@@ -0,0 +1,121 @@
+#include "shader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const unsigned int SHADER_MAX_SOURCE_SIZE = 1024 * 1024;
+const unsigned int SHADER_MAX_LINE_SIZE = 180;
+const unsigned int SHADER_MAX_DEFINES_SIZE = 1024;
+
+const char* vertexShaderSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 position;\n"
+    "out vec2 coords;\n"
+    "void main()\n"
+    "{\n"
+    "   coords = position;\n"
+    "   gl_Position = vec4(position, 0.0f, 1.0f);\n"
+    "}\0";
+
+char* load_shader_from_file(const char* path) {
+    FILE* file;
+    file = fopen(path, "r");
+    if (!file) {
+        return NULL;
+    }
+
+    char buf[SHADER_MAX_LINE_SIZE];
+    char* res = malloc(SHADER_MAX_SOURCE_SIZE);
+    res[0] = '\0';
+
+    while (fgets(buf, SHADER_MAX_LINE_SIZE, file)) {
+        strcat(res, buf);
+    }
+
+    fclose(file);
+
+    return res;
+}
+
+char* build_fragment_shader_source(const char* path, const fractal_params* params, const char* extraDefines) {
+    char* fragment = load_shader_from_file(path);
+    if (!fragment) {
+        fprintf(stderr, "Couln't load %s\n", path);
+        return NULL;
+    }
+    char* kernel = load_shader_from_file(FRACTAL_KERNEL_PATH);
+    if (!kernel) {
+        fprintf(stderr, "Couln't load %s\n", FRACTAL_KERNEL_PATH);
+        free(fragment);
+        return NULL;
+    }
+    char defines[SHADER_MAX_DEFINES_SIZE];
+    fractal_shader_defines(params, defines, sizeof(defines));
+    if (!extraDefines) {
+        extraDefines = "";
+    }
+
+    // #version has to stay the first line
+    char* body = strchr(fragment, '\n');
+    body = body ? body + 1 : fragment + strlen(fragment);
+    size_t versionLength = body - fragment;
+
+    char* res = malloc(versionLength + strlen(defines) + strlen(extraDefines) + strlen(kernel) + strlen(body) + 1);
+    memcpy(res, fragment, versionLength);
+    res[versionLength] = '\0';
+    strcat(res, defines);
+    strcat(res, extraDefines);
+    strcat(res, kernel);
+    strcat(res, body);
+
+    free(kernel);
+    free(fragment);
+    return res;
+}
+
+GLuint create_shader_program(const char* vertexSource, const char* fragmentSource) {
+    GLint success;
+    char infoLog[512];
+
+    // vertex shader
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexSource, NULL);
+    glCompileShader(vertexShader);
+    // check for shader compile errors
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
+        fprintf(stderr, "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n%s\n", infoLog);
+    }
+
+    // fragment shader
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+    glCompileShader(fragmentShader);
+    // check for shader compile errors
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
+        fprintf(stderr, "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n%s\n", infoLog);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        return 0;
+    }
+    // link shaders
+    GLuint shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    // check for linking errors
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+        fprintf(stderr, "ERROR::SHADER::PROGRAM::LINKING_FAILED\n%s\n", infoLog);
+        glDeleteProgram(shaderProgram);
+        return 0;
+    }
+    return shaderProgram;
+}
@@ -0,0 +1,23 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <glad/glad.h>
+
+#include "fractal.h"
+
+#define FRAGMENT_SHADER_PATH "fragment_shader.glsl"
+#define FRACTAL_KERNEL_PATH "fractal_kernel.glsl"
+
+// Full screen quad shared by every program that shades the fractal plane.
+extern const char* vertexShaderSource;
+
+char* load_shader_from_file(const char* path);
+
+// Loads the fragment shader at path and splices the defines for params, extraDefines (may be NULL) and
+// fractal_kernel.glsl right after its #version line. Returns NULL if any of the files couldn't be loaded.
+char* build_fragment_shader_source(const char* path, const fractal_params* params, const char* extraDefines);
+
+// Compiles and links both stages, printing the info log on failure. Returns 0 on failure.
+GLuint create_shader_program(const char* vertexSource, const char* fragmentSource);
+
+#endif
@@ -0,0 +1,65 @@
+#include "spsc_queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the counters on cache lines of their own, so the two threads don't keep taking the line from each other
+#define CACHE_LINE 64
+
+struct spsc_queue {
+    // next slot to write, only written by the producer
+    uint64_t head;
+    char headPadding[CACHE_LINE - sizeof(uint64_t)];
+    // next slot to read, only written by the consumer
+    uint64_t tail;
+    char tailPadding[CACHE_LINE - sizeof(uint64_t)];
+    size_t elementSize;
+    uint64_t mask;
+    unsigned char* slots;
+};
+
+spsc_queue* spsc_queue_create(size_t elementSize, int capacity) {
+    uint64_t size = 1;
+    while (size < (uint64_t)capacity) {
+        size *= 2;
+    }
+    spsc_queue* queue = calloc(1, sizeof(spsc_queue));
+    unsigned char* slots = malloc(size * elementSize);
+    if (!queue || !slots) {
+        free(queue);
+        free(slots);
+        return NULL;
+    }
+    queue->elementSize = elementSize;
+    queue->mask = size - 1;
+    queue->slots = slots;
+    return queue;
+}
+
+void spsc_queue_destroy(spsc_queue* queue) {
+    if (queue) {
+        free(queue->slots);
+        free(queue);
+    }
+}
+
+int spsc_queue_push(spsc_queue* queue, const void* element) {
+    uint64_t head = queue->head;
+    if (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) > queue->mask) {
+        return 0;
+    }
+    memcpy(queue->slots + (head & queue->mask) * queue->elementSize, element, queue->elementSize);
+    __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int spsc_queue_pop(spsc_queue* queue, void* element) {
+    uint64_t tail = queue->tail;
+    if (tail == __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    memcpy(element, queue->slots + (tail & queue->mask) * queue->elementSize, queue->elementSize);
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
@@ -0,0 +1,24 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stddef.h>
+
+// Lock-free queue of fixed size elements between exactly one producer thread and one consumer thread.
+//
+// A ring of capacity slots with two counters, the producer only ever writes head and the consumer only tail. Each
+// publishes its counter with a release store after copying the element, and reads the other's with an acquire load
+// before, so an element is never read before it is completely written, nor overwritten before it was read. Neither
+// side ever waits: pushing to a full queue and popping from an empty one fail right away.
+
+typedef struct spsc_queue spsc_queue;
+
+// capacity is rounded up to a power of two. Returns NULL if out of memory.
+spsc_queue* spsc_queue_create(size_t elementSize, int capacity);
+void spsc_queue_destroy(spsc_queue* queue);
+
+// Producer only. Copies element in, returns 0 if the queue is full.
+int spsc_queue_push(spsc_queue* queue, const void* element);
+// Consumer only. Copies the oldest element out, returns 0 if the queue is empty.
+int spsc_queue_pop(spsc_queue* queue, void* element);
+
+#endif
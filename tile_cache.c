@@ -0,0 +1,256 @@
+#include "tile_cache.h"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TILE_INTS (TILE_PIXELS * TILE_PIXELS)
+
+typedef struct tile_entry {
+    tile_key key;
+    int* iterations;
+    // next entry in the same hash bucket
+    struct tile_entry* next;
+    // neighbours in the LRU list
+    struct tile_entry* newer;
+    struct tile_entry* older;
+} tile_entry;
+
+struct tile_cache {
+    char* directory;
+    pthread_mutex_t lock;
+    tile_entry* entries;
+    int capacity;
+    int count;
+    tile_entry** buckets;
+    int bucketCount;
+    tile_entry* newest;
+    tile_entry* oldest;
+};
+
+void tile_key_init(tile_key* key, const fractal_params* params, int level, int64_t x, int64_t y) {
+    memset(key, 0, sizeof(*key));
+    key->formula = params->formula;
+    key->power = params->power;
+    key->max_iter = params->max_iter;
+    key->level = level;
+    key->x = x;
+    key->y = y;
+}
+
+void tile_key_view(const tile_key* key, fractal_view* view) {
+    view->width = ldexp(TILE_ROOT_WIDTH, -key->level);
+    view->corner[0] = TILE_ROOT_CENTER_X - TILE_ROOT_WIDTH / 2 + key->x * view->width;
+    view->corner[1] = TILE_ROOT_CENTER_Y - TILE_ROOT_WIDTH / 2 + key->y * view->width;
+}
+
+int tile_level_for_pixel(double pixel) {
+    int level = (int)ceil(log2(TILE_ROOT_WIDTH / TILE_PIXELS / pixel));
+    return level < 0 ? 0 : level;
+}
+
+static uint64_t key_hash(const tile_key* key) {
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char* bytes = (const unsigned char*)key;
+    for (size_t i = 0; i < sizeof(*key); ++i) {
+        hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int keys_equal(const tile_key* a, const tile_key* b) {
+    return a->formula == b->formula && a->power == b->power && a->max_iter == b->max_iter && a->level == b->level &&
+           a->x == b->x && a->y == b->y;
+}
+
+// mkdir -p
+static int make_directories(const char* path) {
+    char* partial = strdup(path);
+    int result = 1;
+    for (char* slash = partial + 1;; ++slash) {
+        char end = *slash;
+        if (end != '/' && end != '\0') {
+            continue;
+        }
+        *slash = '\0';
+        if (mkdir(partial, 0755) != 0 && errno != EEXIST) {
+            result = 0;
+            break;
+        }
+        *slash = end;
+        if (end == '\0') {
+            break;
+        }
+    }
+    free(partial);
+    return result;
+}
+
+static void tile_path(const tile_cache* cache, const tile_key* key, char* path, size_t size) {
+    snprintf(path, size, "%s/%s_p%d_i%d/%d/%lld_%lld.tile", cache->directory, formula_get(key->formula)->name,
+             key->power, key->max_iter, key->level, (long long)key->x, (long long)key->y);
+}
+
+static int read_tile(const tile_cache* cache, const tile_key* key, int* iterations) {
+    char path[4096];
+    tile_path(cache, key, path, sizeof(path));
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 0;
+    }
+    tile_file_header header;
+    int result = fread(&header, sizeof(header), 1, file) == 1 &&
+                 memcmp(header.magic, TILE_FILE_MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == TILE_FILE_VERSION && header.tile_pixels == TILE_PIXELS &&
+                 keys_equal(&header.key, key) && fread(iterations, sizeof(int), TILE_INTS, file) == TILE_INTS;
+    fclose(file);
+    return result;
+}
+
+// Written under a temporary name and renamed, so readers never see half a tile.
+static int write_tile(const tile_cache* cache, const tile_key* key, const int* iterations) {
+    static int temporaryCount;
+    char path[4096], temporary[4096 + 32];
+    tile_path(cache, key, path, sizeof(path));
+    snprintf(temporary, sizeof(temporary), "%s.%d.%d.tmp", path, (int)getpid(),
+             __atomic_add_fetch(&temporaryCount, 1, __ATOMIC_RELAXED));
+    *strrchr(path, '/') = '\0';
+    int madeDirectory = make_directories(path);
+    path[strlen(path)] = '/';
+    if (!madeDirectory) {
+        return 0;
+    }
+    FILE* file = fopen(temporary, "wb");
+    if (!file) {
+        return 0;
+    }
+    tile_file_header header = {{0}};
+    memcpy(header.magic, TILE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TILE_FILE_VERSION;
+    header.tile_pixels = TILE_PIXELS;
+    header.key = *key;
+    int result = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(iterations, sizeof(int), TILE_INTS, file) == TILE_INTS;
+    result = fclose(file) == 0 && result;
+    if (!result || rename(temporary, path) != 0) {
+        remove(temporary);
+        return 0;
+    }
+    return 1;
+}
+
+tile_cache* tile_cache_open(const char* directory, int memoryTiles) {
+    if (directory && !make_directories(directory)) {
+        fprintf(stderr, "Couldn't create %s\n", directory);
+        return NULL;
+    }
+    tile_cache* cache = calloc(1, sizeof(tile_cache));
+    cache->directory = directory ? strdup(directory) : NULL;
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->capacity = memoryTiles > 0 ? memoryTiles : 1;
+    cache->entries = calloc(cache->capacity, sizeof(tile_entry));
+    cache->bucketCount = cache->capacity * 2;
+    cache->buckets = calloc(cache->bucketCount, sizeof(tile_entry*));
+    return cache;
+}
+
+void tile_cache_close(tile_cache* cache) {
+    for (int i = 0; i < cache->count; ++i) {
+        free(cache->entries[i].iterations);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    free(cache->directory);
+    pthread_mutex_destroy(&cache->lock);
+    free(cache);
+}
+
+static tile_entry** find_slot(tile_cache* cache, const tile_key* key) {
+    tile_entry** slot = &cache->buckets[key_hash(key) % cache->bucketCount];
+    while (*slot && !keys_equal(&(*slot)->key, key)) {
+        slot = &(*slot)->next;
+    }
+    return slot;
+}
+
+static void unlink_lru(tile_cache* cache, tile_entry* entry) {
+    if (entry->newer) {
+        entry->newer->older = entry->older;
+    } else {
+        cache->newest = entry->older;
+    }
+    if (entry->older) {
+        entry->older->newer = entry->newer;
+    } else {
+        cache->oldest = entry->newer;
+    }
+}
+
+static void push_newest(tile_cache* cache, tile_entry* entry) {
+    entry->newer = NULL;
+    entry->older = cache->newest;
+    if (cache->newest) {
+        cache->newest->newer = entry;
+    } else {
+        cache->oldest = entry;
+    }
+    cache->newest = entry;
+}
+
+// Call with the lock held.
+static void insert(tile_cache* cache, const tile_key* key, const int* iterations) {
+    tile_entry* entry = *find_slot(cache, key);
+    if (entry) {
+        unlink_lru(cache, entry);
+    } else {
+        if (cache->count < cache->capacity) {
+            entry = &cache->entries[cache->count++];
+            entry->iterations = malloc(TILE_INTS * sizeof(int));
+        } else {
+            entry = cache->oldest;
+            unlink_lru(cache, entry);
+            tile_entry** slot = find_slot(cache, &entry->key);
+            *slot = entry->next;
+        }
+        entry->key = *key;
+        tile_entry** slot = &cache->buckets[key_hash(key) % cache->bucketCount];
+        entry->next = *slot;
+        *slot = entry;
+    }
+    memcpy(entry->iterations, iterations, TILE_INTS * sizeof(int));
+    push_newest(cache, entry);
+}
+
+int tile_cache_get(tile_cache* cache, const tile_key* key, int* iterations) {
+    pthread_mutex_lock(&cache->lock);
+    tile_entry* entry = *find_slot(cache, key);
+    if (entry) {
+        unlink_lru(cache, entry);
+        push_newest(cache, entry);
+        memcpy(iterations, entry->iterations, TILE_INTS * sizeof(int));
+    }
+    pthread_mutex_unlock(&cache->lock);
+    if (entry) {
+        return 1;
+    }
+
+    if (!cache->directory || !read_tile(cache, key, iterations)) {
+        return 0;
+    }
+    pthread_mutex_lock(&cache->lock);
+    insert(cache, key, iterations);
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+int tile_cache_put(tile_cache* cache, const tile_key* key, const int* iterations) {
+    pthread_mutex_lock(&cache->lock);
+    insert(cache, key, iterations);
+    pthread_mutex_unlock(&cache->lock);
+    return !cache->directory || write_tile(cache, key, iterations);
+}
@@ -0,0 +1,64 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <stdint.h>
+
+#include "fractal.h"
+
+// Cache of iteration tiles on a quadtree over the plane.
+//
+// Level 0 is a single tile covering TILE_ROOT_WIDTH around TILE_ROOT_CENTER, every level splits each tile into four.
+// Tile (x, y) of a level counts from the bottom left. A tile holds TILE_PIXELS x TILE_PIXELS iterations laid out like
+// cpu_render_iterations: rows from the bottom, -1 for pixels that never escaped.
+//
+// Recently used tiles are kept in memory, evicting the least recently used one when full. With a directory every tile
+// is also stored there, one file per tile, so later runs start warm. The cache can be shared between threads.
+
+#define TILE_PIXELS 256
+#define TILE_ROOT_CENTER_X 0.0
+#define TILE_ROOT_CENTER_Y 0.0
+#define TILE_ROOT_WIDTH 8.0
+// beyond this double precision can't tell the pixels of a tile near the edge of the root apart anyway
+#define TILE_MAX_LEVEL 40
+// the same for single precision, tiles of deeper levels need an engine that works in double
+#define TILE_MAX_FLOAT_LEVEL 13
+
+#define TILE_FILE_MAGIC "FRACTITR"
+#define TILE_FILE_VERSION 1
+
+typedef struct {
+    int32_t formula;
+    int32_t power;
+    int32_t max_iter;
+    int32_t level;
+    int64_t x;
+    int64_t y;
+} tile_key;
+
+// Header of a tile file, followed by TILE_PIXELS * TILE_PIXELS int32 iterations.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tile_pixels;
+    tile_key key;
+} tile_file_header;
+
+typedef struct tile_cache tile_cache;
+
+// directory may be NULL for a memory only cache, it is created if missing. memoryTiles is the number of tiles kept
+// in memory (TILE_PIXELS^2 * 4 bytes each). Returns NULL (after printing why) if the directory can't be used.
+tile_cache* tile_cache_open(const char* directory, int memoryTiles);
+void tile_cache_close(tile_cache* cache);
+
+// Copies the tile into iterations and returns 1, or returns 0 if it isn't cached.
+int tile_cache_get(tile_cache* cache, const tile_key* key, int* iterations);
+// Returns 0 if the tile couldn't be written to disk, it is still cached in memory then.
+int tile_cache_put(tile_cache* cache, const tile_key* key, const int* iterations);
+
+void tile_key_init(tile_key* key, const fractal_params* params, int level, int64_t x, int64_t y);
+// Part of the plane the tile covers.
+void tile_key_view(const tile_key* key, fractal_view* view);
+// Coarsest level whose pixels are no bigger than pixel, so its tiles can be drawn without magnifying them.
+int tile_level_for_pixel(double pixel);
+
+#endif
@@ -0,0 +1,508 @@
+#include <math.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "gpu_engine.h"
+#include "png.h"
+#include "tile_cache.h"
+
+// Serves tiles of the quadtree in tile_cache.h to any number of local clients, slippy map style:
+//   GET /{formula}/{z}/{x}/{y}.png[?power=N&max_iter=N]   y counts from the top like in web maps
+//   GET /stats                                             counters as JSON
+//
+// Every connection gets a thread that answers from the tile cache. Missing tiles are queued for the main thread,
+// which owns the engine (and the GL context) and renders everything that queued up meanwhile as one batch. A request
+// for a tile that is already queued or rendering waits for that render instead of queueing the tile again.
+
+#define DEFAULT_PORT 8080
+#define DEFAULT_MEMORY_TILES 1024
+#define MAX_BATCH 64
+// compiled gpu engines kept around, one per formula, power and iteration limit
+#define MAX_ENGINES 8
+#define REQUEST_BYTES 8192
+// latency histogram, bucket i counts requests that took less than 2^i microseconds
+#define LATENCY_BUCKETS 32
+
+typedef struct tile_job {
+    tile_key key;
+    fractal_params params;
+    int* iterations;
+    char done;
+    // requests waiting for the tile, the last one to leave frees the job
+    int waiters;
+    struct tile_job* nextQueued;
+    struct tile_job* nextInFlight;
+} tile_job;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    pthread_cond_t rendered;
+    tile_job* queueHead;
+    tile_job* queueTail;
+    tile_job* inFlight;
+    tile_cache* cache;
+
+    int useGpu;
+    int threads;
+
+    // counters, under lock
+    double startTime;
+    uint64_t requests;
+    uint64_t tilesServed;
+    uint64_t cacheHits;
+    uint64_t tilesRendered;
+    uint64_t deduplicated;
+    uint64_t batches;
+    uint64_t errors;
+    uint64_t latencyBuckets[LATENCY_BUCKETS];
+    double latencyTotal;
+    double latencyMax;
+} tile_server;
+
+static tile_server server = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+void printUsage(const char* program) {
+    printf("usage: %s [options]\n"
+           "  --port N                listen on 127.0.0.1:N (default %d)\n"
+           "  --socket PATH           listen on a unix socket instead\n"
+           "  --cache DIR             keep rendered tiles there across runs\n"
+           "  --memory-tiles N        tiles kept in memory (default %d, %d KiB each)\n"
+           "  --engine cpu|gpu        (default gpu)\n"
+           "  --threads N             cpu engine threads (default: all cores)\n",
+           program, DEFAULT_PORT, DEFAULT_MEMORY_TILES, TILE_PIXELS * TILE_PIXELS * (int)sizeof(int) / 1024);
+}
+
+double now(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+// Orders a batch so tiles with the same parameters are rendered back to back.
+int compareJobs(const void* a, const void* b) {
+    const fractal_params* x = &(*(tile_job* const*)a)->params;
+    const fractal_params* y = &(*(tile_job* const*)b)->params;
+    if (x->formula != y->formula) {
+        return x->formula - y->formula;
+    }
+    if (x->power != y->power) {
+        return x->power - y->power;
+    }
+    return x->max_iter - y->max_iter;
+}
+
+typedef struct {
+    gpu_engine engines[MAX_ENGINES];
+    fractal_params params[MAX_ENGINES];
+    int count;
+    // replaced next when all are taken
+    int next;
+} engine_set;
+
+gpu_engine* engineFor(engine_set* set, const fractal_params* params) {
+    for (int i = 0; i < set->count; ++i) {
+        if (memcmp(&set->params[i], params, sizeof(*params)) == 0) {
+            return &set->engines[i];
+        }
+    }
+    int slot;
+    if (set->count < MAX_ENGINES) {
+        slot = set->count++;
+    } else {
+        slot = set->next;
+        set->next = (set->next + 1) % MAX_ENGINES;
+        gpu_engine_destroy(&set->engines[slot]);
+    }
+    if (!gpu_engine_init(&set->engines[slot], params, TILE_PIXELS)) {
+        // the slot isn't looked at again once the gpu is out of the picture
+        server.useGpu = 0;
+        fprintf(stderr, "Falling back to the cpu engine\n");
+        return NULL;
+    }
+    set->params[slot] = *params;
+    return &set->engines[slot];
+}
+
+// Runs on the main thread for good, since that thread owns the GL context.
+void renderQueuedTiles(void) {
+    engine_set engines = {0};
+    tile_job* batch[MAX_BATCH];
+    for (;;) {
+        pthread_mutex_lock(&server.lock);
+        while (!server.queueHead) {
+            pthread_cond_wait(&server.queued, &server.lock);
+        }
+        int count = 0;
+        while (server.queueHead && count < MAX_BATCH) {
+            batch[count++] = server.queueHead;
+            server.queueHead = server.queueHead->nextQueued;
+        }
+        if (!server.queueHead) {
+            server.queueTail = NULL;
+        }
+        pthread_mutex_unlock(&server.lock);
+
+        qsort(batch, count, sizeof(batch[0]), compareJobs);
+        for (int i = 0; i < count; ++i) {
+            tile_job* job = batch[i];
+            fractal_view view;
+            tile_key_view(&job->key, &view);
+            gpu_engine* engine = server.useGpu && job->key.level <= TILE_MAX_FLOAT_LEVEL
+                                     ? engineFor(&engines, &job->params)
+                                     : NULL;
+            if (engine) {
+                gpu_engine_render_iterations(engine, &view, TILE_PIXELS, TILE_PIXELS, job->iterations);
+            } else {
+                cpu_render_iterations_parallel(&job->params, &view, TILE_PIXELS, TILE_PIXELS, job->iterations,
+                                               server.threads, 1);
+            }
+            tile_cache_put(server.cache, &job->key, job->iterations);
+        }
+
+        pthread_mutex_lock(&server.lock);
+        for (int i = 0; i < count; ++i) {
+            batch[i]->done = 1;
+            for (tile_job** entry = &server.inFlight; *entry; entry = &(*entry)->nextInFlight) {
+                if (*entry == batch[i]) {
+                    *entry = batch[i]->nextInFlight;
+                    break;
+                }
+            }
+        }
+        server.tilesRendered += count;
+        ++server.batches;
+        pthread_cond_broadcast(&server.rendered);
+        pthread_mutex_unlock(&server.lock);
+    }
+}
+
+// Fills iterations from the cache, or from the render thread after waiting for it.
+void fetchTile(const tile_key* key, const fractal_params* params, int* iterations) {
+    if (tile_cache_get(server.cache, key, iterations)) {
+        pthread_mutex_lock(&server.lock);
+        ++server.cacheHits;
+        pthread_mutex_unlock(&server.lock);
+        return;
+    }
+
+    pthread_mutex_lock(&server.lock);
+    tile_job* job = server.inFlight;
+    while (job && memcmp(&job->key, key, sizeof(*key)) != 0) {
+        job = job->nextInFlight;
+    }
+    if (job) {
+        ++server.deduplicated;
+    } else {
+        job = calloc(1, sizeof(tile_job));
+        job->key = *key;
+        job->params = *params;
+        job->iterations = malloc(TILE_PIXELS * TILE_PIXELS * sizeof(int));
+        job->nextInFlight = server.inFlight;
+        server.inFlight = job;
+        if (server.queueTail) {
+            server.queueTail->nextQueued = job;
+        } else {
+            server.queueHead = job;
+        }
+        server.queueTail = job;
+        pthread_cond_signal(&server.queued);
+    }
+    ++job->waiters;
+    while (!job->done) {
+        pthread_cond_wait(&server.rendered, &server.lock);
+    }
+    memcpy(iterations, job->iterations, TILE_PIXELS * TILE_PIXELS * sizeof(int));
+    if (--job->waiters == 0) {
+        free(job->iterations);
+        free(job);
+    }
+    pthread_mutex_unlock(&server.lock);
+}
+
+int sendAll(int client, const void* data, size_t size) {
+    const char* bytes = data;
+    while (size > 0) {
+        ssize_t sent = send(client, bytes, size, 0);
+        if (sent <= 0) {
+            return 0;
+        }
+        bytes += sent;
+        size -= sent;
+    }
+    return 1;
+}
+
+int sendResponse(int client, const char* status, const char* contentType, const void* body, size_t size,
+                 int keepAlive) {
+    char header[512];
+    int length = snprintf(header, sizeof(header),
+                          "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n"
+                          "Access-Control-Allow-Origin: *\r\n\r\n",
+                          status, contentType, size, keepAlive ? "keep-alive" : "close");
+    return sendAll(client, header, length) && sendAll(client, body, size);
+}
+
+int sendError(int client, const char* status, int keepAlive) {
+    pthread_mutex_lock(&server.lock);
+    ++server.errors;
+    pthread_mutex_unlock(&server.lock);
+    return sendResponse(client, status, "text/plain", status, strlen(status), keepAlive);
+}
+
+// Upper bound of the latency below which the given fraction of the requests finished, in milliseconds.
+double latencyPercentile(double fraction) {
+    uint64_t total = 0, seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        total += server.latencyBuckets[i];
+    }
+    for (int i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += server.latencyBuckets[i];
+        if (total && seen >= fraction * total) {
+            double bound = ldexp(1.0, i) / 1e3;
+            return bound < server.latencyMax * 1e3 ? bound : server.latencyMax * 1e3;
+        }
+    }
+    return 0;
+}
+
+int sendStats(int client, int keepAlive) {
+    char body[1024];
+    pthread_mutex_lock(&server.lock);
+    double uptime = now() - server.startTime;
+    int length = snprintf(
+        body, sizeof(body),
+        "{\"uptime_s\": %.3f, \"requests\": %llu, \"tiles_served\": %llu, \"cache_hits\": %llu, "
+        "\"tiles_rendered\": %llu, \"deduplicated\": %llu, \"batches\": %llu, \"errors\": %llu, "
+        "\"tiles_per_s\": %.3f, \"latency_ms\": {\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"max\": %.3f}}\n",
+        uptime, (unsigned long long)server.requests, (unsigned long long)server.tilesServed,
+        (unsigned long long)server.cacheHits, (unsigned long long)server.tilesRendered,
+        (unsigned long long)server.deduplicated, (unsigned long long)server.batches,
+        (unsigned long long)server.errors, server.tilesServed / uptime,
+        server.tilesServed ? server.latencyTotal / server.tilesServed * 1e3 : 0, latencyPercentile(0.5),
+        latencyPercentile(0.99), server.latencyMax * 1e3);
+    pthread_mutex_unlock(&server.lock);
+    return sendResponse(client, "200 OK", "application/json", body, length, keepAlive);
+}
+
+int sendTile(int client, const char* target, int keepAlive) {
+    double start = now();
+    char name[32];
+    int level;
+    long long x, y;
+    int consumed = 0;
+    if (sscanf(target, "/%31[^/]/%d/%lld/%lld.png%n", name, &level, &x, &y, &consumed) != 4 || consumed == 0) {
+        return sendError(client, "404 Not Found", keepAlive);
+    }
+    formula_id formula = formula_by_name(name);
+    if (formula == FORMULA_COUNT || level < 0 || level > TILE_MAX_LEVEL || x < 0 || y < 0 || x >= (1LL << level) ||
+        y >= (1LL << level)) {
+        return sendError(client, "404 Not Found", keepAlive);
+    }
+    fractal_params params;
+    fractal_params_default(&params, formula);
+    const char* query = target + consumed;
+    if (*query == '?') {
+        for (const char* option = query + 1; option; option = strchr(option, '&') ? strchr(option, '&') + 1 : NULL) {
+            sscanf(option, "power=%d", &params.power);
+            sscanf(option, "max_iter=%d", &params.max_iter);
+        }
+    } else if (*query) {
+        return sendError(client, "404 Not Found", keepAlive);
+    }
+    if (params.power < MIN_POWER || params.power > MAX_POWER || params.max_iter <= 0) {
+        return sendError(client, "400 Bad Request", keepAlive);
+    }
+
+    // web maps count tile rows from the top, the quadtree from the bottom
+    tile_key key;
+    tile_key_init(&key, &params, level, x, (1LL << level) - 1 - y);
+    static __thread int iterations[TILE_PIXELS * TILE_PIXELS];
+    static __thread unsigned char rgb[TILE_PIXELS * TILE_PIXELS * 3];
+    static __thread unsigned char flipped[TILE_PIXELS * TILE_PIXELS * 3];
+    fetchTile(&key, &params, iterations);
+    colorize_iterations(iterations, TILE_PIXELS * TILE_PIXELS, rgb);
+    for (int row = 0; row < TILE_PIXELS; ++row) {
+        memcpy(flipped + row * TILE_PIXELS * 3, rgb + (TILE_PIXELS - 1 - row) * TILE_PIXELS * 3, TILE_PIXELS * 3);
+    }
+    size_t size;
+    unsigned char* png = png_encode_rgb(flipped, TILE_PIXELS, TILE_PIXELS, &size);
+    int result = sendResponse(client, "200 OK", "image/png", png, size, keepAlive);
+    free(png);
+
+    double latency = now() - start;
+    int bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && latency * 1e6 >= ldexp(1.0, bucket)) {
+        ++bucket;
+    }
+    pthread_mutex_lock(&server.lock);
+    ++server.tilesServed;
+    ++server.latencyBuckets[bucket];
+    server.latencyTotal += latency;
+    server.latencyMax = latency > server.latencyMax ? latency : server.latencyMax;
+    pthread_mutex_unlock(&server.lock);
+    return result;
+}
+
+// Answers the requests of one connection until the client closes it or asks to.
+void* serveConnection(void* argument) {
+    int client = (int)(intptr_t)argument;
+    char request[REQUEST_BYTES + 1];
+    size_t filled = 0;
+    for (;;) {
+        request[filled] = '\0';
+        char* end = strstr(request, "\r\n\r\n");
+        if (!end) {
+            ssize_t received = filled < REQUEST_BYTES ? recv(client, request + filled, REQUEST_BYTES - filled, 0) : 0;
+            if (received <= 0) {
+                break;
+            }
+            filled += received;
+            continue;
+        }
+        *end = '\0';
+        pthread_mutex_lock(&server.lock);
+        ++server.requests;
+        pthread_mutex_unlock(&server.lock);
+
+        char method[8], target[1024], version[16];
+        int parsed = sscanf(request, "%7s %1023s %15s", method, target, version) == 3;
+        int keepAlive = parsed && strcmp(version, "HTTP/1.1") == 0;
+        for (char* line = strstr(request, "\r\n"); line; line = strstr(line + 2, "\r\n")) {
+            if (strncasecmp(line + 2, "connection:", 11) == 0 && strstr(line + 13, "close")) {
+                keepAlive = 0;
+            }
+        }
+        int sent;
+        if (!parsed || strcmp(method, "GET") != 0) {
+            keepAlive = 0;
+            sent = sendError(client, "400 Bad Request", keepAlive);
+        } else if (strcmp(target, "/stats") == 0) {
+            sent = sendStats(client, keepAlive);
+        } else {
+            sent = sendTile(client, target, keepAlive);
+        }
+        if (!sent || !keepAlive) {
+            break;
+        }
+        // keep whatever the client already sent of its next request
+        size_t used = end + 4 - request;
+        memmove(request, request + used, filled - used);
+        filled -= used;
+    }
+    close(client);
+    return NULL;
+}
+
+void* acceptConnections(void* argument) {
+    int listener = (int)(intptr_t)argument;
+    for (;;) {
+        int client = accept(listener, NULL, NULL);
+        if (client < 0) {
+            continue;
+        }
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, serveConnection, (void*)(intptr_t)client) != 0) {
+            close(client);
+            continue;
+        }
+        pthread_detach(thread);
+    }
+    return NULL;
+}
+
+int listenOn(int port, const char* socketPath) {
+    int listener;
+    if (socketPath) {
+        struct sockaddr_un address = {0};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+        unlink(socketPath);
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            return -1;
+        }
+    } else {
+        struct sockaddr_in address = {0};
+        address.sin_family = AF_INET;
+        // local clients only
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        listener = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listener < 0 || setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+            bind(listener, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            return -1;
+        }
+    }
+    return listen(listener, SOMAXCONN) == 0 ? listener : -1;
+}
+
+int main(int argc, char** argv) {
+    int port = DEFAULT_PORT;
+    const char* socketPath = NULL;
+    const char* cachePath = NULL;
+    int memoryTiles = DEFAULT_MEMORY_TILES;
+    server.useGpu = 1;
+    server.threads = cpu_thread_count();
+
+    for (int i = 1; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--port") == 0 && rest >= 1) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--socket") == 0 && rest >= 1) {
+            socketPath = argv[++i];
+        } else if (strcmp(argv[i], "--cache") == 0 && rest >= 1) {
+            cachePath = argv[++i];
+        } else if (strcmp(argv[i], "--memory-tiles") == 0 && rest >= 1) {
+            memoryTiles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            server.useGpu = strcmp(argv[++i], "gpu") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            server.threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+
+    server.cache = tile_cache_open(cachePath, memoryTiles);
+    if (!server.cache) {
+        return -1;
+    }
+    if (server.useGpu && !gl_context_create_offscreen()) {
+        return -1;
+    }
+    // a client hanging up mid-response shouldn't kill the server
+    signal(SIGPIPE, SIG_IGN);
+    int listener = listenOn(port, socketPath);
+    if (listener < 0) {
+        perror("Couldn't listen");
+        return -1;
+    }
+    if (socketPath) {
+        printf("Serving tiles on %s\n", socketPath);
+    } else {
+        printf("Serving tiles on http://127.0.0.1:%d/mandelbrot/0/0/0.png\n", port);
+    }
+    fflush(stdout);
+
+    server.startTime = now();
+    pthread_t acceptor;
+    pthread_create(&acceptor, NULL, acceptConnections, (void*)(intptr_t)listener);
+    renderQueuedTiles();
+    return 0;
+}
@@ -0,0 +1,25 @@
+#version 330 core
+
+// Draws one cached tile of iterations (see tile_cache.h) into the fractal target, in the same format as the
+// OUTPUT_ITERATIONS variant of fragment_shader.glsl. Drawn once per tile with the scissor around it.
+// The formula defines are spliced in after the #version line for MAX_ITER.
+
+in vec2 coords;
+out vec4 color;
+
+// of the fractal target, as in fragment_shader.glsl
+uniform vec2 camera_corner;
+uniform float camera_pixel;
+
+uniform sampler2D tile;
+uniform vec2 tile_corner;
+uniform float tile_width;
+
+void main() {
+    vec2 position = (camera_corner + gl_FragCoord.xy * camera_pixel - tile_corner) / tile_width;
+    if (position.x < 0 || position.y < 0 || position.x >= 1 || position.y >= 1) {
+        discard;
+    }
+    int iter = int(texture(tile, position).r);
+    color = vec4(iter, iter >= 0 ? iter + 1 : MAX_ITER, 0, 1);
+}
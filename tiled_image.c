@@ -0,0 +1,162 @@
+#include "tiled_image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct tiled_image {
+    FILE* file;
+    tiled_image_header header;
+    int tilesX;
+    int tilesY;
+    int tilesDone;
+    uint64_t* index;
+    // where the next tile goes
+    uint64_t end;
+};
+
+static uint64_t index_offset(int tile) {
+    return sizeof(tiled_image_header) + (uint64_t)tile * sizeof(uint64_t);
+}
+
+static int sync_file(FILE* file) {
+    return fflush(file) == 0 && fsync(fileno(file)) == 0;
+}
+
+static int headers_match(const tiled_image_header* a, const tiled_image_header* b) {
+    return memcmp(a->magic, b->magic, sizeof(a->magic)) == 0 && a->version == b->version && a->width == b->width &&
+           a->height == b->height && a->tile_size == b->tile_size && a->formula == b->formula &&
+           a->power == b->power && a->max_iter == b->max_iter && a->coloring == b->coloring &&
+           a->corner[0] == b->corner[0] && a->corner[1] == b->corner[1] && a->view_width == b->view_width;
+}
+
+void tiled_image_tile_size(const tiled_image* image, int tx, int ty, int* width, int* height) {
+    int tileSize = image->header.tile_size;
+    int restX = image->header.width - tx * tileSize;
+    int restY = image->header.height - ty * tileSize;
+    *width = restX < tileSize ? restX : tileSize;
+    *height = restY < tileSize ? restY : tileSize;
+}
+
+static uint64_t tile_bytes(const tiled_image* image, int tile) {
+    int width, height;
+    tiled_image_tile_size(image, tile % image->tilesX, tile / image->tilesX, &width, &height);
+    return (uint64_t)width * height * 3;
+}
+
+static int resume(tiled_image* image) {
+    int tiles = image->tilesX * image->tilesY;
+    if (fread(image->index, sizeof(uint64_t), tiles, image->file) != (size_t)tiles) {
+        return 0;
+    }
+    image->end = index_offset(tiles);
+    for (int i = 0; i < tiles; ++i) {
+        if (image->index[i]) {
+            ++image->tilesDone;
+            uint64_t end = image->index[i] + tile_bytes(image, i);
+            if (end > image->end) {
+                image->end = end;
+            }
+        }
+    }
+    // drop whatever the crashed run wrote after its last indexed tile
+    return ftruncate(fileno(image->file), image->end) == 0;
+}
+
+static int create(tiled_image* image) {
+    int tiles = image->tilesX * image->tilesY;
+    image->end = index_offset(tiles);
+    return fwrite(&image->header, sizeof(image->header), 1, image->file) == 1 &&
+           fwrite(image->index, sizeof(uint64_t), tiles, image->file) == (size_t)tiles && sync_file(image->file);
+}
+
+tiled_image* tiled_image_open(const char* path, uint32_t width, uint32_t height, uint32_t tileSize,
+                              const fractal_params* params, const fractal_view* view) {
+    tiled_image* image = calloc(1, sizeof(tiled_image));
+    memcpy(image->header.magic, TILED_IMAGE_MAGIC, sizeof(image->header.magic));
+    image->header.version = TILED_IMAGE_VERSION;
+    image->header.width = width;
+    image->header.height = height;
+    image->header.tile_size = tileSize;
+    image->header.formula = params->formula;
+    image->header.power = params->power;
+    image->header.max_iter = params->max_iter;
+    image->header.coloring = params->coloring;
+    image->header.corner[0] = view->corner[0];
+    image->header.corner[1] = view->corner[1];
+    image->header.view_width = view->width;
+    image->tilesX = (width + tileSize - 1) / tileSize;
+    image->tilesY = (height + tileSize - 1) / tileSize;
+    image->index = calloc(image->tilesX * image->tilesY, sizeof(uint64_t));
+
+    image->file = fopen(path, "r+b");
+    if (image->file) {
+        tiled_image_header existing;
+        if (fread(&existing, sizeof(existing), 1, image->file) != 1 || !headers_match(&existing, &image->header)) {
+            printf("%s already exists and holds a different image\n", path);
+            tiled_image_close(image);
+            return NULL;
+        }
+        if (!resume(image)) {
+            printf("Couldn't read the tile index of %s\n", path);
+            tiled_image_close(image);
+            return NULL;
+        }
+        return image;
+    }
+
+    image->file = fopen(path, "w+b");
+    if (!image->file || !create(image)) {
+        printf("Couldn't create %s\n", path);
+        tiled_image_close(image);
+        return NULL;
+    }
+    return image;
+}
+
+void tiled_image_close(tiled_image* image) {
+    if (image->file) {
+        fclose(image->file);
+    }
+    free(image->index);
+    free(image);
+}
+
+const tiled_image_header* tiled_image_get_header(const tiled_image* image) {
+    return &image->header;
+}
+
+int tiled_image_tiles_x(const tiled_image* image) {
+    return image->tilesX;
+}
+
+int tiled_image_tiles_y(const tiled_image* image) {
+    return image->tilesY;
+}
+
+int tiled_image_tiles_done(const tiled_image* image) {
+    return image->tilesDone;
+}
+
+int tiled_image_has_tile(const tiled_image* image, int tx, int ty) {
+    return image->index[ty * image->tilesX + tx] != 0;
+}
+
+int tiled_image_write_tile(tiled_image* image, int tx, int ty, const unsigned char* rgb) {
+    int tile = ty * image->tilesX + tx;
+    uint64_t offset = image->end;
+    uint64_t bytes = tile_bytes(image, tile);
+    if (fseeko(image->file, offset, SEEK_SET) != 0 || fwrite(rgb, 1, bytes, image->file) != bytes ||
+        !sync_file(image->file)) {
+        return 0;
+    }
+    if (fseeko(image->file, index_offset(tile), SEEK_SET) != 0 ||
+        fwrite(&offset, sizeof(offset), 1, image->file) != 1 || !sync_file(image->file)) {
+        return 0;
+    }
+    image->index[tile] = offset;
+    image->end = offset + bytes;
+    ++image->tilesDone;
+    return 1;
+}
@@ -0,0 +1,57 @@
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include <stdint.h>
+
+#include "fractal.h"
+
+// Tiled RGB image that is written tile by tile and can be resumed after a crash.
+//
+// Layout (native byte order):
+//   tiled_image_header
+//   uint64_t index[tilesX * tilesY]  file offset of every tile in row order, 0 while the tile is missing
+//   tile data                        tiles in the order they were finished, rows top to bottom, 3 bytes per pixel
+//
+// Tiles on the right and bottom edges are cropped to the image. A tile's index entry is only written after its data
+// has been synced, so after a crash every indexed tile is complete and anything past the last one is discarded.
+
+#define TILED_IMAGE_MAGIC "FRACTILE"
+#define TILED_IMAGE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    int32_t formula;
+    int32_t power;
+    int32_t max_iter;
+    // reserved before colorings, so older files hold COLORING_ITERATIONS
+    int32_t coloring;
+    // view of the whole image, corner is its bottom left
+    double corner[2];
+    double view_width;
+} tiled_image_header;
+
+typedef struct tiled_image tiled_image;
+
+// Creates the file, or reopens it if it already holds a partial render of the same image.
+// Returns NULL (after printing why) if the file can't be used.
+tiled_image* tiled_image_open(const char* path, uint32_t width, uint32_t height, uint32_t tileSize,
+                              const fractal_params* params, const fractal_view* view);
+void tiled_image_close(tiled_image* image);
+
+const tiled_image_header* tiled_image_get_header(const tiled_image* image);
+int tiled_image_tiles_x(const tiled_image* image);
+int tiled_image_tiles_y(const tiled_image* image);
+int tiled_image_tiles_done(const tiled_image* image);
+
+// Size in pixels of tile (tx, ty) after cropping to the image.
+void tiled_image_tile_size(const tiled_image* image, int tx, int ty, int* width, int* height);
+int tiled_image_has_tile(const tiled_image* image, int tx, int ty);
+
+// Appends the tile, rgb holds its rows top to bottom. Returns 0 on I/O errors.
+int tiled_image_write_tile(tiled_image* image, int tx, int ty, const unsigned char* rgb);
+
+#endif
@@ -0,0 +1,167 @@
+#include "trace.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// how long the writer thread sleeps between draining the ring
+#define TRACE_DRAIN_MILLISECONDS 10
+
+// One event in the ring. Slots are handed between producers and the writer with a sequence number (Vyukov's bounded
+// queue): the slot for position p is free to write while sequence == p and holds a finished event once
+// sequence == p + 1; the writer then hands it to position p + TRACE_RING_SIZE.
+typedef struct {
+    uint64_t sequence;
+    const char* name;
+    const char* argNames;
+    char phase;
+    int thread;
+    double microseconds;
+    double args[TRACE_MAX_ARGS];
+} trace_slot;
+
+static trace_slot ring[TRACE_RING_SIZE];
+static uint64_t head;  // next position to write, shared by every producer
+static uint64_t tail;  // next position to read, only used by the writer
+static uint64_t dropped;
+static int recording;
+static int stopping;
+static int nextThread;
+static __thread int threadId;
+
+static struct timespec start;
+static FILE* output;
+static int firstEvent;
+static pthread_t writer;
+
+static double microseconds_since_start(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1e6 + (now.tv_nsec - start.tv_nsec) * 1e-3;
+}
+
+void trace_event(const char* name, char phase, const char* argNames, double a, double b, double c) {
+    if (!__atomic_load_n(&recording, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+    uint64_t position = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    trace_slot* slot;
+    for (;;) {
+        slot = &ring[position % TRACE_RING_SIZE];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == position) {
+            // on failure position is updated to the current head
+            if (__atomic_compare_exchange_n(&head, &position, position + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (sequence < position) {
+            // the writer hasn't drained this slot since the last lap
+            __atomic_add_fetch(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            position = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        }
+    }
+
+    if (!threadId) {
+        threadId = __atomic_add_fetch(&nextThread, 1, __ATOMIC_RELAXED);
+    }
+    slot->name = name;
+    slot->argNames = argNames;
+    slot->phase = phase;
+    slot->thread = threadId;
+    slot->microseconds = microseconds_since_start();
+    slot->args[0] = a;
+    slot->args[1] = b;
+    slot->args[2] = c;
+    __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+}
+
+static void write_event(const trace_slot* slot) {
+    fprintf(output, "%s\n{\"name\": \"%s\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d", firstEvent ? "" : ",",
+            slot->name, slot->phase, slot->microseconds, slot->thread);
+    firstEvent = 0;
+    if (slot->phase == 'i') {
+        fprintf(output, ", \"s\": \"t\"");
+    }
+    if (slot->argNames) {
+        fprintf(output, ", \"args\": {");
+        const char* argName = slot->argNames;
+        for (int i = 0; i < TRACE_MAX_ARGS && *argName; ++i) {
+            int length = strcspn(argName, ",");
+            fprintf(output, "%s\"%.*s\": %.17g", i ? ", " : "", length, argName, slot->args[i]);
+            argName += argName[length] ? length + 1 : length;
+        }
+        fprintf(output, "}");
+    }
+    fprintf(output, "}");
+}
+
+static void drain(void) {
+    for (;;) {
+        trace_slot* slot = &ring[tail % TRACE_RING_SIZE];
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != tail + 1) {
+            return;
+        }
+        write_event(slot);
+        __atomic_store_n(&slot->sequence, tail + TRACE_RING_SIZE, __ATOMIC_RELEASE);
+        ++tail;
+    }
+}
+
+static void* write_events(void* unused) {
+    struct timespec pause = {0, TRACE_DRAIN_MILLISECONDS * 1000000L};
+    while (!__atomic_load_n(&stopping, __ATOMIC_ACQUIRE)) {
+        drain();
+        nanosleep(&pause, NULL);
+    }
+    drain();
+    return NULL;
+}
+
+int trace_start(const char* path) {
+    output = fopen(path, "w");
+    if (!output) {
+        fprintf(stderr, "Couldn't create %s\n", path);
+        return 0;
+    }
+    // the ring is empty between traces, so it only needs its sequence numbers once
+    if (head == 0) {
+        for (int i = 0; i < TRACE_RING_SIZE; ++i) {
+            ring[i].sequence = i;
+        }
+    }
+    fprintf(output, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+    firstEvent = 1;
+    dropped = 0;
+    stopping = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (pthread_create(&writer, NULL, write_events, NULL) != 0) {
+        fprintf(stderr, "Couldn't start the trace writer\n");
+        fclose(output);
+        return 0;
+    }
+    __atomic_store_n(&recording, 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void trace_stop(void) {
+    if (!output) {
+        return;
+    }
+    __atomic_store_n(&recording, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&stopping, 1, __ATOMIC_RELEASE);
+    pthread_join(writer, NULL);
+
+    uint64_t lost = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+    if (lost) {
+        fprintf(output, "%s\n{\"name\": \"dropped events\", \"ph\": \"i\", \"s\": \"g\", \"ts\": %.3f, \"pid\": 1, "
+                        "\"tid\": 0, \"args\": {\"count\": %llu}}",
+                firstEvent ? "" : ",", microseconds_since_start(), (unsigned long long)lost);
+    }
+    fprintf(output, "\n]}\n");
+    fclose(output);
+    output = NULL;
+}
@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Structured trace events (input, camera changes, render passes) for chrome://tracing or Perfetto.
+//
+// Recording an event only writes it into a fixed size lock-free ring, so it never blocks and never touches stdio.
+// A background thread started by trace_start drains the ring into a Chrome trace JSON file. Events recorded while
+// the ring is full are dropped and counted. Building with TRACE_DISABLED defined compiles every TRACE_* macro away.
+
+#define TRACE_RING_SIZE 4096
+#define TRACE_MAX_ARGS 3
+
+// Starts writing events to path. Returns 0 (after printing why) if the file can't be created.
+int trace_start(const char* path);
+// Writes the remaining events and closes the file.
+void trace_stop(void);
+
+// name and argNames must outlive the trace, in practice string literals. argNames lists the names of the used
+// arguments separated by commas, e.g. "x,y", or is NULL.
+void trace_event(const char* name, char phase, const char* argNames, double a, double b, double c);
+
+#ifdef TRACE_DISABLED
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_INSTANT(name, argNames, a, b, c) ((void)0)
+#else
+#define TRACE_BEGIN(name) trace_event(name, 'B', NULL, 0, 0, 0)
+#define TRACE_END(name) trace_event(name, 'E', NULL, 0, 0, 0)
+#define TRACE_INSTANT(name, argNames, a, b, c) trace_event(name, 'i', argNames, a, b, c)
+#endif
+
+#endif
@@ -0,0 +1,154 @@
+#include "video.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+
+static double keyframe_width(const video_zoom* zoom, int index) {
+    return ldexp(zoom->widestWidth, -index);
+}
+
+// Every view of the zoom is determined by its width alone.
+static fractal_view view_of_width(const video_zoom* zoom, double width) {
+    double height = width * zoom->height / zoom->width;
+    fractal_view view = {{zoom->fixedPoint[0] - zoom->relative[0] * width,
+                          zoom->fixedPoint[1] - zoom->relative[1] * height},
+                         width};
+    return view;
+}
+
+static const video_keyframe* get_keyframe(video_zoom* zoom, int index) {
+    video_keyframe* slot = &zoom->keyframes[0];
+    for (int i = 0; i < VIDEO_KEYFRAME_CACHE_SIZE; ++i) {
+        if (zoom->keyframes[i].index == index) {
+            return &zoom->keyframes[i];
+        }
+        // frames walk through the keyframes monotonically, so the farthest one is the one not needed again
+        if (abs(zoom->keyframes[i].index - index) > abs(slot->index - index)) {
+            slot = &zoom->keyframes[i];
+        }
+    }
+
+    fractal_view view = view_of_width(zoom, keyframe_width(zoom, index));
+    int width = 2 * zoom->width, height = 2 * zoom->height;
+    if (zoom->useGpu) {
+        gpu_engine_render_rgb(&zoom->gpu, &view, width, height, slot->rgb);
+    } else {
+        cpu_render_iterations_parallel(&zoom->params, &view, width, height, zoom->iterations, zoom->threads, 1);
+        colorize_iterations(zoom->iterations, width * height, slot->rgb);
+    }
+    slot->index = index;
+    ++zoom->keyframesRendered;
+    return slot;
+}
+
+// Bilinear sample of keyframe at keyframe pixel coordinates (x, y).
+static void sample_keyframe(const video_zoom* zoom, const video_keyframe* key, double x, double y,
+                            unsigned char* out) {
+    int width = 2 * zoom->width, height = 2 * zoom->height;
+    x = fmin(fmax(x, 0), width - 1);
+    y = fmin(fmax(y, 0), height - 1);
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = x0 + 1 < width ? x0 + 1 : x0;
+    int y1 = y0 + 1 < height ? y0 + 1 : y0;
+    double fx = x - x0, fy = y - y0;
+    for (int c = 0; c < 3; ++c) {
+        double bottom = key->rgb[(y0 * width + x0) * 3 + c] * (1 - fx) + key->rgb[(y0 * width + x1) * 3 + c] * fx;
+        double top = key->rgb[(y1 * width + x0) * 3 + c] * (1 - fx) + key->rgb[(y1 * width + x1) * 3 + c] * fx;
+        out[c] = (unsigned char)(bottom * (1 - fy) + top * fy + 0.5);
+    }
+}
+
+int video_zoom_init(video_zoom* zoom, const fractal_params* params, const fractal_view* from, const fractal_view* to,
+                    int width, int height, int frames, int useGpu, int threads) {
+    memset(zoom, 0, sizeof(*zoom));
+    zoom->params = *params;
+    zoom->width = width;
+    zoom->height = height;
+    zoom->frames = frames;
+    zoom->fromWidth = from->width;
+    zoom->toWidth = to->width;
+    zoom->useGpu = useGpu;
+    zoom->threads = threads;
+
+    // the point that stays in place: from.corner + relative * from.size == to.corner + relative * to.size
+    double aspect = (double)height / width;
+    zoom->relative[0] = (to->corner[0] - from->corner[0]) / (from->width - to->width);
+    zoom->relative[1] = (to->corner[1] - from->corner[1]) / ((from->width - to->width) * aspect);
+    zoom->fixedPoint[0] = from->corner[0] + zoom->relative[0] * from->width;
+    zoom->fixedPoint[1] = from->corner[1] + zoom->relative[1] * from->width * aspect;
+    zoom->widestWidth = fmax(from->width, to->width);
+    zoom->lastKeyframe = (int)floor(log2(zoom->widestWidth / fmin(from->width, to->width))) + 1;
+
+    int keyframeSize = 2 * (width > height ? width : height);
+    if (useGpu && !gpu_engine_init(&zoom->gpu, params, keyframeSize)) {
+        return 0;
+    }
+    size_t keyframePixels = (size_t)4 * width * height;
+    zoom->iterations = useGpu ? NULL : malloc(keyframePixels * sizeof(int));
+    for (int i = 0; i < VIDEO_KEYFRAME_CACHE_SIZE; ++i) {
+        zoom->keyframes[i].index = -VIDEO_KEYFRAME_CACHE_SIZE - i;
+        zoom->keyframes[i].rgb = malloc(keyframePixels * 3);
+    }
+    return 1;
+}
+
+void video_zoom_destroy(video_zoom* zoom) {
+    for (int i = 0; i < VIDEO_KEYFRAME_CACHE_SIZE; ++i) {
+        free(zoom->keyframes[i].rgb);
+    }
+    free(zoom->iterations);
+    if (zoom->useGpu) {
+        gpu_engine_destroy(&zoom->gpu);
+    }
+}
+
+int video_zoom_nested(const video_zoom* zoom) {
+    return zoom->relative[0] >= 0 && zoom->relative[0] <= 1 && zoom->relative[1] >= 0 && zoom->relative[1] <= 1;
+}
+
+void video_zoom_render_frame(video_zoom* zoom, int f, unsigned char* frame) {
+    double progress = zoom->frames > 1 ? (double)f / (zoom->frames - 1) : 0;
+    double width = zoom->fromWidth * pow(zoom->toWidth / zoom->fromWidth, progress);
+    int index = (int)floor(log2(zoom->widestWidth / width));
+    index = index < 0 ? 0 : index > zoom->lastKeyframe ? zoom->lastKeyframe : index;
+    const video_keyframe* outer = get_keyframe(zoom, index);
+    const video_keyframe* inner = index < zoom->lastKeyframe ? get_keyframe(zoom, index + 1) : NULL;
+    double outerScale = width / keyframe_width(zoom, index);
+
+    for (int j = 0; j < zoom->height; ++j) {
+        for (int i = 0; i < zoom->width; ++i) {
+            // position relative to the fixed point in frame sizes, the same in every view
+            double u = (i + 0.5) / zoom->width - zoom->relative[0];
+            double v = (j + 0.5) / zoom->height - zoom->relative[1];
+            double innerU = 2 * u * outerScale + zoom->relative[0];
+            double innerV = 2 * v * outerScale + zoom->relative[1];
+            unsigned char* out = frame + ((size_t)(zoom->height - 1 - j) * zoom->width + i) * 3;
+            if (inner && innerU >= 0 && innerU < 1 && innerV >= 0 && innerV < 1) {
+                sample_keyframe(zoom, inner, innerU * 2 * zoom->width - 0.5, innerV * 2 * zoom->height - 0.5, out);
+            } else {
+                double outerU = u * outerScale + zoom->relative[0];
+                double outerV = v * outerScale + zoom->relative[1];
+                sample_keyframe(zoom, outer, outerU * 2 * zoom->width - 0.5, outerV * 2 * zoom->height - 0.5, out);
+            }
+        }
+    }
+}
+
+void video_write_y4m_header(FILE* output, int width, int height, int fps) {
+    fprintf(output, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+}
+
+void video_write_y4m_frame(FILE* output, const unsigned char* rgb, int width, int height, unsigned char* planes) {
+    int pixels = width * height;
+    for (int i = 0; i < pixels; ++i) {
+        double r = rgb[3 * i], g = rgb[3 * i + 1], b = rgb[3 * i + 2];
+        planes[i] = (unsigned char)(16 + 0.257 * r + 0.504 * g + 0.098 * b + 0.5);
+        planes[pixels + i] = (unsigned char)(128 - 0.148 * r - 0.291 * g + 0.439 * b + 0.5);
+        planes[2 * pixels + i] = (unsigned char)(128 + 0.439 * r - 0.368 * g - 0.071 * b + 0.5);
+    }
+    fputs("FRAME\n", output);
+    fwrite(planes, 1, (size_t)pixels * 3, output);
+}
@@ -0,0 +1,63 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdio.h>
+
+#include "fractal.h"
+#include "gpu_engine.h"
+
+// Exponential zoom between two views, frame by frame.
+//
+// Instead of rendering every frame, only keyframes are rendered: keyframe k covers the widest view divided by 2^k
+// at twice the output resolution. Every frame lies between two consecutive keyframes and is resampled from them,
+// taking each pixel from the innermost keyframe that contains it. All views share the zoom's fixed point, so
+// keyframe k + 1 is exactly the middle of keyframe k scaled by 2 around that point. Frames are only a function of
+// their number, so any range of them can be rendered on its own, which is how render_farm hands videos out.
+
+#define VIDEO_KEYFRAME_CACHE_SIZE 3
+
+typedef struct {
+    int index;
+    // 2 * width x 2 * height, rows from the bottom
+    unsigned char* rgb;
+} video_keyframe;
+
+typedef struct {
+    fractal_params params;
+    int width;
+    int height;
+    int frames;
+    double fromWidth;
+    double toWidth;
+    int useGpu;
+    gpu_engine gpu;
+    int threads;
+    int* iterations;
+
+    // fixed point of the zoom and its position relative to every view, in view widths and heights
+    double fixedPoint[2];
+    double relative[2];
+    double widestWidth;
+    int lastKeyframe;
+    video_keyframe keyframes[VIDEO_KEYFRAME_CACHE_SIZE];
+    long keyframesRendered;
+} video_zoom;
+
+// Zooms from one view to the other over frames frames of width x height. With useGpu the GL context must be current.
+// Returns 0 if the GPU engine can't be set up.
+int video_zoom_init(video_zoom* zoom, const fractal_params* params, const fractal_view* from, const fractal_view* to,
+                    int width, int height, int frames, int useGpu, int threads);
+void video_zoom_destroy(video_zoom* zoom);
+
+// Whether the smaller view lies within the bigger one; frames are clamped at the edges if it doesn't.
+int video_zoom_nested(const video_zoom* zoom);
+
+// Fills frame (rows from the top, 3 bytes per pixel) with frame number f.
+void video_zoom_render_frame(video_zoom* zoom, int f, unsigned char* frame);
+
+// Y4M stream of 4:4:4 frames, BT.601 limited range.
+void video_write_y4m_header(FILE* output, int width, int height, int fps);
+// planes is scratch space of width * height * 3 bytes.
+void video_write_y4m_frame(FILE* output, const unsigned char* rgb, int width, int height, unsigned char* planes);
+
+#endif
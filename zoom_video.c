@@ -0,0 +1,137 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu_engine.h"
+#include "fractal.h"
+#include "gl_context.h"
+#include "video.h"
+
+// Renders an exponential zoom between two views (see video.h) as a raw RGB or Y4M stream.
+
+typedef enum { OUTPUT_Y4M, OUTPUT_RAW } output_format;
+
+void printUsage(const char* program) {
+    printf("usage: %s OUTPUT|- --to X Y WIDTH [options]\n"
+           "  --from X Y WIDTH        bottom left corner and width of the first frame (default: home view)\n"
+           "  --to X Y WIDTH          bottom left corner and width of the last frame\n"
+           "  --size WIDTH HEIGHT     frame size in pixels (default 1280 720)\n"
+           "  --fps N                 (default 30)\n"
+           "  --duration SECONDS      (default 10)\n"
+           "  --format y4m|raw        raw writes rgb24 frames (default y4m)\n"
+           "  --formula NAME          mandelbrot, multibrot, burning_ship, tricorn or newton\n"
+           "  --power N               power of multibrot and newton\n"
+           "  --max-iter N            iteration limit (default 1000)\n"
+           "  --engine cpu|gpu        (default gpu)\n"
+           "  --threads N             cpu engine threads (default: all cores)\n",
+           program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage(argv[0]);
+        return -1;
+    }
+    const char* outputPath = argv[1];
+    int width = 1280, height = 720;
+    int useGpu = 1;
+    int threads = cpu_thread_count();
+    fractal_params params;
+    fractal_params_default(&params, FORMULA_MANDELBROT);
+    fractal_view from = {{CAMERA_CORNER_X, CAMERA_CORNER_Y}, CAMERA_WIDTH};
+    fractal_view to = {{0, 0}, 0};
+    int fps = 30;
+    double duration = 10;
+    output_format format = OUTPUT_Y4M;
+
+    for (int i = 2; i < argc; ++i) {
+        int rest = argc - i - 1;
+        if (strcmp(argv[i], "--from") == 0 && rest >= 3) {
+            from.corner[0] = atof(argv[++i]);
+            from.corner[1] = atof(argv[++i]);
+            from.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--to") == 0 && rest >= 3) {
+            to.corner[0] = atof(argv[++i]);
+            to.corner[1] = atof(argv[++i]);
+            to.width = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--size") == 0 && rest >= 2) {
+            width = atoi(argv[++i]);
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--fps") == 0 && rest >= 1) {
+            fps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--duration") == 0 && rest >= 1) {
+            duration = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--format") == 0 && rest >= 1) {
+            format = strcmp(argv[++i], "raw") == 0 ? OUTPUT_RAW : OUTPUT_Y4M;
+        } else if (strcmp(argv[i], "--formula") == 0 && rest >= 1) {
+            formula_id formula = formula_by_name(argv[++i]);
+            if (formula == FORMULA_COUNT) {
+                printf("Unknown formula %s\n", argv[i]);
+                return -1;
+            }
+            int maxIter = params.max_iter;
+            fractal_params_default(&params, formula);
+            params.max_iter = maxIter;
+        } else if (strcmp(argv[i], "--power") == 0 && rest >= 1) {
+            params.power = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--max-iter") == 0 && rest >= 1) {
+            params.max_iter = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--engine") == 0 && rest >= 1) {
+            useGpu = strcmp(argv[++i], "gpu") == 0;
+        } else if (strcmp(argv[i], "--threads") == 0 && rest >= 1) {
+            threads = atoi(argv[++i]);
+        } else {
+            printUsage(argv[0]);
+            return -1;
+        }
+    }
+    int frames = (int)(fps * duration + 0.5);
+    if (to.width <= 0 || from.width <= 0 || to.width == from.width || width <= 0 || height <= 0 || frames < 2 ||
+        params.power < MIN_POWER || params.power > MAX_POWER) {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    FILE* output = strcmp(outputPath, "-") == 0 ? stdout : fopen(outputPath, "wb");
+    if (!output) {
+        fprintf(stderr, "Couldn't open %s\n", outputPath);
+        return -1;
+    }
+    video_zoom zoom;
+    if (useGpu && !gl_context_create_offscreen()) {
+        return -1;
+    }
+    if (!video_zoom_init(&zoom, &params, &from, &to, width, height, frames, useGpu, threads)) {
+        return -1;
+    }
+    if (!video_zoom_nested(&zoom)) {
+        fprintf(stderr, "The smaller view is not inside the bigger one, frames will be clamped at the edges\n");
+    }
+    unsigned char* frame = malloc((size_t)width * height * 3);
+    unsigned char* planes = malloc((size_t)width * height * 3);
+
+    if (format == OUTPUT_Y4M) {
+        video_write_y4m_header(output, width, height, fps);
+    }
+    for (int f = 0; f < frames; ++f) {
+        video_zoom_render_frame(&zoom, f, frame);
+        if (format == OUTPUT_Y4M) {
+            video_write_y4m_frame(output, frame, width, height, planes);
+        } else {
+            fwrite(frame, 1, (size_t)width * height * 3, output);
+        }
+        // stdout may carry the video, so progress goes to stderr
+        fprintf(stderr, "frame %d/%d, %ld keyframes rendered\n", f + 1, frames, zoom.keyframesRendered);
+    }
+
+    if (output != stdout) {
+        fclose(output);
+    }
+    free(planes);
+    free(frame);
+    video_zoom_destroy(&zoom);
+    if (useGpu) {
+        gl_context_destroy();
+    }
+    return 0;
+}